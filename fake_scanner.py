@@ -1,4 +1,5 @@
 from flask import Flask, jsonify, request
+from werkzeug.serving import WSGIRequestHandler
 import random
 import datetime
 
@@ -16,9 +17,19 @@ def get_plate():
     timestamp = datetime.datetime.now().isoformat()
     return f"{plate},{timestamp}", 200
 
+@app.route('/get_plates', methods=['GET'])
+def get_plates():
+    # Simulerer at flere biler står i kø: én "plade,tidsstempel" pr. linje, højst max
+    count = int(request.args.get('max', 8))
+    timestamp = datetime.datetime.now().isoformat()
+    lines = [f"{random.choice(plates)},{timestamp}\n" for _ in range(count)]
+    return "".join(lines), 200
+
 @app.route('/')
 def index():
     return "Se /get_plate"
 
 if __name__ == '__main__':
+    # HTTP/1.1, så ESP32'en kan genbruge forbindelsen (keep-alive)
+    WSGIRequestHandler.protocol_version = "HTTP/1.1"
     app.run(host='0.0.0.0', port=5000, debug=True)
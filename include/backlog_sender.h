@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mqtt_connection.h"
+#include "mqtt_outbox.h"
+#include "offline_log.h"
+
+// Grænser for hvor længe publiceringsopgaven kan blive holdt op af MQTT
+#define MQTT_CONNECT_TIMEOUT_S 2 // Timeout for TCP-forbindelse og CONNACK i sekunder
+#define MQTT_BACKOFF_MIN_MS 1000 // Første ventetid efter et mislykket forsøg
+#define MQTT_BACKOFF_MAX_MS 60000 // Længste ventetid mellem forsøg
+#define DRAIN_BUDGET_MS 200 // Maks. tid pr. gennemløb til at sende gemt data
+#define MQTT_KEEPALIVE_S 15 // PINGREQ når forbindelsen har været stille så længe
+
+// Alt sendes med QoS 1 fra offline-loggen (se MqttOutbox): en post slettes først når
+// brokeren har kvitteret, og ukvitterede poster sendes igen efter genopkobling
+#define MQTT_WINDOW 8 // Beskeder der må vente på PUBACK samtidig
+#define MQTT_ACK_TIMEOUT_MS 5000 // Uden PUBACK så længe lukkes forbindelsen og alt sendes igen
+
+// Poster sendes med flere pr. MQTT-besked (se PayloadBatch i payload_codec.h).
+// MQTT_BATCH_RECORDS 1 sender én post pr. besked som før
+#define MQTT_BATCH_RECORDS 16 // Maks. poster pr. besked
+#define MQTT_BATCH_BYTES 1024 // Maks. størrelse af en samlet besked
+#define MQTT_BATCH_FLUSH_MS 500 // Så længe venter en ufuld samling på flere poster mens andre er undervejs
+#define MQTT_BUFFER_SIZE (MQTT_BATCH_BYTES + 64) // PubSubClient-buffer: besked, header og emne
+
+// Afsendelse af offline-loggen til brokeren, delt af firmwaren og flådesimulatoren.
+//
+// Poster sendes i samlinger gennem MqttOutbox og bliver i loggen, indtil service() ser
+// kvitteringen. En fuld samling sendes med det samme, og det samme gør en ufuld når
+// intet venter på kvittering; ellers venter den op til MQTT_BATCH_FLUSH_MS på flere.
+// Skriver andre opgaver i loggen imens, sættes deres mutex med setMutex(); den holdes
+// kun mens poster læses og slettes, ikke under selve afsendelsen.
+class BacklogSender {
+public:
+    BacklogSender(PubSubClient &client, MqttConnection &connection, MqttOutbox &outbox, OfflineLog &log,
+                  const char *topic, uint8_t *buffer, size_t size)
+        : client(client), connection(connection), outbox(outbox), log(log), topic(topic), buffer(buffer),
+          bufferSize(size) {}
+
+    // Timeouts, keepalive, vindue og backoff fra konstanterne ovenfor. False hvis
+    // PubSubClients buffer ikke kunne forstørres (samlingerne bliver da mindre)
+    bool configure(uint8_t window, uint32_t ackTimeoutMs);
+    void setMutex(SemaphoreHandle_t mutex) { logMutex = mutex; }
+    // send() stopper når condition() er true, fx når nye plader venter og skal først
+    void stopWhen(bool (*condition)()) { stopCondition = condition; }
+
+    // Hold forbindelsen og udbakken ved lige: læs kvitteringer og slet de kvitterede poster.
+    // Efter en tabt forbindelse sendes alt ukvitteret igen fra den ældste post.
+    // False hvis forbindelsen ikke er oppe
+    bool service();
+    // Er der usendte poster, og må de sendes nu?
+    bool ready();
+    // Send samlinger så længe vinduet har plads og højst budgetMs. Returnerer antal poster
+    uint32_t send(uint32_t budgetMs);
+
+    uint32_t messages() const { return sentMessages; } // Samlinger sendt i alt
+
+private:
+    uint32_t firstUnsent() const;
+    void lock();
+    void unlock();
+
+    PubSubClient &client;
+    MqttConnection &connection;
+    MqttOutbox &outbox;
+    OfflineLog &log;
+    const char *topic;
+    uint8_t *buffer;
+    size_t bufferSize;
+    SemaphoreHandle_t logMutex = nullptr;
+    bool (*stopCondition)() = nullptr;
+
+    unsigned long partialBatchSince = 0; // Hvornår en ufuld samling begyndte at vente (0 = ingen)
+    uint32_t sentMessages = 0;
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3). Kan kædes: crc32(b, n, crc32(a, m))
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "rtc_sealed.h"
+
+// Enhedens indstillinger i én binær post på LittleFS (/config.bin), læst med én læsning.
+//
+// Posten har magic, version og CRC, så en halvt skrevet eller ældre fil afvises i stedet
+// for at give forkerte indstillinger; da bruges standardværdierne fra main.cpp. Filen
+// skrives til en midlertidig fil og omdøbes, så et strømsvigt efterlader den gamle eller
+// den nye post. En kopi i RTC-hukommelsen (RTC_DATA_ATTR) gør at en opvågning fra deep
+// sleep slet ikke behøver filsystemet.
+struct DeviceConfig : RtcSealed<DeviceConfig> {
+    static const uint32_t MAGIC = 0x47464350; // "PCFG"
+    static const uint16_t VERSION = 1;
+    static const uint8_t MAX_LANES = 4;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; // sizeof(DeviceConfig) da posten blev skrevet
+
+    // WiFi (tomt SSID = start AP-mode)
+    char ssid[33];
+    char pass[65];
+
+    // Tjenester
+    char scannerHost[64];
+    uint16_t scannerPort;
+    char mqttBroker[64];
+    uint16_t mqttPort;
+
+    // Tuning
+    uint32_t debounceMs[MAX_LANES]; // Debounce-vindue pr. bane
+    uint32_t inactivityMs; // Inaktivitetstid før trafikken er kendt (se IdleTimeout)
+    uint32_t inactivityMinMs;
+    uint32_t inactivityMaxMs;
+    uint16_t mqttWindow; // Beskeder der må vente på PUBACK samtidig
+    uint32_t mqttAckTimeoutMs;
+    uint32_t recentPlateTtlS; // Se RecentPlates
+    uint32_t crc;
+
+    bool valid() const; // Også magic, version og størrelse
+    void reset(); // Nulstillet (men gyldig) post; standardværdierne sættes af kalderen
+
+    // Læs posten fra path. False hvis filen mangler eller posten er ødelagt eller af en
+    // anden version; indholdet er da udefineret
+    bool load(fs::FS &fs, const char *path);
+    // Skriv posten atomisk til path (via path + ".tmp")
+    bool save(fs::FS &fs, const char *path) const;
+};
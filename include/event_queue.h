@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Bevægelse registreret af en interrupt-handler
+struct MotionEvent {
+    int64_t captureUs; // esp_timer_get_time() da sensoren trigger
+    uint8_t lane; // Banen hvis sensor trigger
+    uint8_t bufferedSlot; // 0 = ny bevægelse, ellers 1 + pladsen blandt de gemte hos scanneren
+};
+
+// Hvordan det gik med en bevægelse hos scanneren
+enum ScanOutcome : uint8_t {
+    SCAN_PLATE, // Pladen er fundet (og afleveret, når scanneropgaven melder tilbage)
+    SCAN_NO_PLATE, // Scanneren svarede, men havde ingen plade til bevægelsen
+    SCAN_FAILED, // Scanneren kunne ikke nås, eller pladen kunne ikke gemmes
+};
+
+// Plade fra scanneren, klar til publicering
+struct PlateReading {
+    char plate[16];
+    char timestamp[32];
+    int64_t captureUs; // Vægur-tid i mikrosekunder siden epoch da sensoren trigger (0 = ukendt)
+    uint8_t lane;
+};
+
+// Lock-fri ringbuffer med præcis én producent (ISR) og én forbruger (opsamlingsopgaven).
+//
+// Producenten skriver kun head og forbrugeren kun tail, så der er ingen låse og
+// intet der kan blokere i ISR'en. Kapaciteten skal være en potens af 2, så indeks
+// kan maskeres. Funktionerne tvinges inline, så de havner i den IRAM-placerede ISR.
+template <typename T, uint32_t N>
+class SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Kapaciteten skal være en potens af 2");
+
+public:
+    // Kaldes fra ISR. Returnerer false og tæller overløb hvis køen er fuld
+    inline __attribute__((always_inline)) bool push(const T &item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) {
+            overflowCount.store(overflowCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Kaldes fra forbrugeren. Henter op til max elementer på én gang
+    uint32_t popBatch(T *out, uint32_t max) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t available = head.load(std::memory_order_acquire) - t;
+        uint32_t count = available < max ? available : max;
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = items[(t + i) & (N - 1)];
+        }
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    uint32_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    static constexpr uint32_t capacity() { return N; }
+    uint32_t overflows() const { return overflowCount.load(std::memory_order_relaxed); }
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> overflowCount{0};
+};
+
+// Debounce af én interrupt-kilde; vinduet kan ændres mens systemet kører
+struct EdgeDebouncer {
+    volatile uint32_t windowUs;
+    volatile int64_t lastUs;
+    volatile uint32_t suppressed; // Flanker ignoreret inden for vinduet
+
+    explicit EdgeDebouncer(uint32_t windowMs = 0) : windowUs(windowMs * 1000UL), lastUs(INT64_MIN / 2), suppressed(0) {}
+
+    inline __attribute__((always_inline)) bool accept(int64_t nowUs) {
+        if (nowUs - lastUs < (int64_t)windowUs) {
+            suppressed = suppressed + 1;
+            return false;
+        }
+        lastUs = nowUs;
+        return true;
+    }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "rtc_sealed.h"
+
+// Hvor længe enheden bliver vågen efter sidste bevægelse før deep sleep, tilpasset trafikken
+// (RTC_DATA_ATTR, så mønsteret huskes gennem søvnen).
+//
+// Tiden mellem bevægelser følges som et glidende gennemsnit (EWMA med vægt 1/4). Kommer
+// bilerne tæt, holdes enheden vågen GAP_FACTOR gange det typiske mellemrum, så WiFi og MQTT
+// ikke skal op igen for hver bil, dog højst maxMs. Bliver mellemrummet længere end det, falder
+// tiden igen i takt med at det bliver mindre sandsynligt at den næste bil når frem, ned til
+// minMs. Kurven er sammenhængende, så en lille ændring i mellemrummet kun flytter lidt.
+struct IdleTimeout : RtcSealed<IdleTimeout> {
+    static const uint8_t GAP_FACTOR = 2;
+
+    int64_t lastMotionUs; // Vægur-tid for sidste bevægelse (0 = ingen endnu)
+    uint32_t gapMs; // Gennemsnitligt mellemrum (0 = ukendt)
+    uint32_t crc;
+
+    // Registrer en bevægelse ved nowUs (vægur-tid)
+    void motion(int64_t nowUs);
+
+    // Inaktivitetstid i millisekunder; defaultMs indtil mellemrummet er kendt
+    uint32_t timeoutMs(uint32_t defaultMs, uint32_t minMs, uint32_t maxMs) const;
+};
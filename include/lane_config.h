@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Baner: én bevægelsessensor pr. bane, så én enhed kan dække flere baner.
+// Sættes ved bygning, fx -DLANE_COUNT=4
+#ifndef LANE_COUNT
+#define LANE_COUNT 1
+#endif
+
+// Sensorpin og debounce-vindue pr. bane; de første LANE_COUNT bruges. Alle pins skal være
+// RTC-GPIO'er (0, 2, 4, 12-15, 25-27, 32-39), så enhver bane kan vække enheden via ext1.
+// Tabellen står i main.cpp
+struct LaneConfig {
+    uint8_t pin;
+    uint32_t debounceMs;
+};
+extern const LaneConfig laneConfig[];
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+
+// Ikke-blokerende forbindelsesstyring til MQTT.
+//
+// poll() kaldes fra publiceringsopgaven (publishTask i main.cpp) og laver højst ét
+// forbindelsesforsøg pr. kald. Mislykkede forsøg venter eksponentielt længere (med jitter,
+// så mange enheder ikke rammer brokeren samtidig) i stedet for at blokere opgaven med delay().
+class MqttConnection {
+public:
+    MqttConnection(PubSubClient &client, const char *clientId) : client(client), clientId(clientId) {}
+
+    void setBackoff(uint32_t minMs, uint32_t maxMs) {
+        backoffMinMs = minMs;
+        backoffMaxMs = maxMs;
+    }
+
+    // Returnerer true når forbindelsen er oppe
+    bool poll();
+    bool connected() const { return state == CONNECTED; }
+
+    uint32_t attempts() const { return totalAttempts; }
+    uint32_t failures() const { return consecutiveFailures; }
+    // Millisekunder til næste forsøg (0 hvis forbundet eller klar til forsøg)
+    uint32_t retryInMs() const;
+
+private:
+    enum State { DISCONNECTED, BACKOFF, CONNECTED };
+
+    uint32_t nextBackoffMs();
+
+    PubSubClient &client;
+    const char *clientId;
+    State state = DISCONNECTED;
+    uint32_t backoffMinMs = 1000;
+    uint32_t backoffMaxMs = 60000;
+    uint32_t consecutiveFailures = 0;
+    uint32_t totalAttempts = 0;
+    unsigned long nextAttemptAt = 0;
+};
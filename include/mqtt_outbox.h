@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+
+// QoS 1-publicering med et vindue af ukvitterede beskeder.
+//
+// PubSubClient kan kun sende QoS 0, så PUBLISH med pakke-id skrives her direkte på
+// forbindelsen, og svarene (PUBACK, PINGRESP) læses af poll() i stedet for
+// PubSubClient::loop(). Hver besked dækker et fortløbende stykke af kalderens
+// sekvensnumre (fx poster i offline-loggen); ackedSeq() er grænsen for hvad der er
+// kvitteret uden huller, så kalderen først sletter en post når brokeren har den.
+// Efter en tabt forbindelse kaldes reset(), og alt ukvitteret sendes igen. Et svar der
+// kommer i flere bidder samles over flere kald af poll(), og en PUBLISH eller PINGREQ der
+// kun delvis kunne skrives lukker forbindelsen, da resten af strømmen ellers læses forkert.
+class MqttOutbox {
+public:
+    static const uint8_t MAX_WINDOW = 32;
+
+    explicit MqttOutbox(Client &client) : client(client) {}
+
+    void setWindow(uint8_t size) { window = size == 0 ? 1 : (size > MAX_WINDOW ? MAX_WINDOW : size); }
+    void setAckTimeout(uint32_t ms) { ackTimeoutMs = ms; }
+    void setKeepAlive(uint16_t seconds) { keepAliveMs = seconds * 1000UL; }
+    // Kaldes med sendetid til kvittering i mikrosekunder for hver kvitteret besked
+    void onAck(void (*handler)(uint32_t latencyUs)) { ackHandler = handler; }
+
+    // Send en besked der dækker sekvensnumrene op til (ikke med) endSeq.
+    // False hvis vinduet er fuldt eller skrivningen fejler (så er forbindelsen lukket)
+    bool publish(const char *topic, const uint8_t *payload, size_t length, uint32_t endSeq);
+    // Læs svar fra brokeren og send PINGREQ når forbindelsen er stille. Returnerer false
+    // hvis forbindelsen bør lukkes (ingen kvittering inden for ackTimeoutMs eller protokolfejl)
+    bool poll();
+    // Glem alt ukvitteret efter en tabt forbindelse; resendFrom er hvor der skal sendes fra igen
+    void reset(uint32_t resendFrom);
+
+    bool canSend() const { return count < window; }
+    uint8_t inFlight() const { return count; }
+    // Alle sekvensnumre før denne er kvitteret
+    uint32_t ackedSeq() const { return acked; }
+    // Næste sekvensnummer der ikke er sendt
+    uint32_t sentSeq() const { return sent; }
+    uint32_t resends() const { return resendCount; }
+
+private:
+    struct Pending {
+        uint16_t packetId;
+        bool acked;
+        uint32_t endSeq;
+        int64_t sentUs;
+    };
+
+    // Stadier i læsningen af den næste pakke fra brokeren
+    enum RxStage : uint8_t { RX_HEADER, RX_LENGTH, RX_BODY };
+
+    // Læs det der er kommet af den næste pakke. False ved protokolfejl; complete sættes
+    // når pakken er læst til ende (rxHeader, rxLength og de første bytes i rxBody)
+    bool readPacket(bool &complete);
+    bool write(const uint8_t *data, size_t length);
+    void handleAck(uint16_t packetId);
+
+    Client &client;
+    uint8_t window = 8;
+    uint32_t ackTimeoutMs = 5000;
+    uint32_t keepAliveMs = 15000;
+    void (*ackHandler)(uint32_t latencyUs) = nullptr;
+
+    Pending pending[MAX_WINDOW]; // Ring i afsendelsesrækkefølge
+    uint8_t first = 0;
+    uint8_t count = 0;
+    uint16_t nextPacketId = 1;
+    uint32_t acked = 0;
+    uint32_t sent = 0;
+    uint32_t resendCount = 0;
+    unsigned long lastOutMs = 0;
+
+    // Pakken der er ved at blive læst; vi abonnerer ikke, så kun små pakker gemmes
+    RxStage rxStage = RX_HEADER;
+    uint8_t rxHeader = 0;
+    uint32_t rxRemaining = 0;
+    uint32_t rxMultiplier = 1;
+    uint32_t rxLength = 0;
+    uint8_t rxBody[4];
+};
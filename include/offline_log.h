@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Segmenteret ringlog på LittleFS til beskeder der ikke kunne sendes.
+//
+// Hver post har fast størrelse og et fortløbende sekvensnummer, så post nr. n altid
+// ligger i segment (n / poster pr. segment) % antal segmenter. Tilføjelse er derfor
+// O(1), og tømning flytter kun en læsemarkør der gemmes i to skiftende slots.
+// Et segment nulstilles først når det genbruges, så et strømsvigt midt i en
+// rotation kun kan koste den ældste data, som alligevel var ved at blive overskrevet.
+class OfflineLog {
+public:
+    static const size_t RECORD_SIZE = 128;
+    static const size_t PAYLOAD_SIZE = RECORD_SIZE - 10; // seq + crc + længde
+
+    // Standardgeometri: 8 segmenter á 256 poster = 256 KB på flash
+    static const uint16_t DEFAULT_SEGMENTS = 8;
+    static const uint16_t DEFAULT_SEGMENT_RECORDS = 256;
+
+    bool begin(fs::FS &fs, const char *dir = "/log", uint16_t segments = DEFAULT_SEGMENTS,
+               uint16_t segmentRecords = DEFAULT_SEGMENT_RECORDS);
+    void end();
+
+    // Tilføj en post. Fejler hvis beskeden er længere end PAYLOAD_SIZE
+    bool append(const uint8_t *data, size_t length);
+    bool append(const char *message) { return append((const uint8_t *)message, strlen(message)); }
+
+    // Læs den ældste post uden at fjerne den. Ødelagte poster springes over
+    bool peek(uint8_t *buffer, size_t capacity, size_t &length);
+    // Læs post nr. seq (mellem oldestSeq() og nextSeq()) uden at fjerne noget.
+    // False hvis den ikke findes længere eller er ødelagt
+    bool read(uint32_t seq, uint8_t *buffer, size_t capacity, size_t &length);
+    // Fjern den ældste post; markøren gemmes for hver COMMIT_INTERVAL poster
+    void pop();
+    // Fjern alle poster før seq, fx når brokeren har kvitteret for dem
+    void popUntil(uint32_t seq);
+    // Gem læsemarkøren på flash
+    bool commit();
+
+    bool isOpen() const { return filesystem != nullptr; }
+    uint32_t size() const { return head - tail; }
+    uint32_t oldestSeq() const { return tail; }
+    uint32_t nextSeq() const { return head; }
+    uint32_t capacity() const { return (uint32_t)segmentCount * recordsPerSegment; }
+    // Poster tabt fordi ringen løb fuld eller fordi de var ødelagte
+    uint32_t dropped() const { return droppedRecords; }
+
+private:
+    static const uint8_t COMMIT_INTERVAL = 32;
+
+    struct Record {
+        uint32_t seq;
+        uint32_t crc;
+        uint16_t length;
+        uint8_t payload[PAYLOAD_SIZE];
+    };
+    static_assert(sizeof(Record) == RECORD_SIZE, "Poster skal have fast størrelse");
+
+    uint16_t segmentOf(uint32_t seq) const { return (seq / recordsPerSegment) % segmentCount; }
+    uint32_t offsetOf(uint32_t seq) const { return (seq % recordsPerSegment) * RECORD_SIZE; }
+    void segmentPath(uint16_t segment, char *path, size_t size) const;
+    static uint32_t recordCrc(const Record &record);
+    bool readRecord(File &file, uint32_t seq, Record &record);
+    File *fileFor(uint32_t seq);
+    void recover();
+    void dropUnavailable();
+
+    fs::FS *filesystem = nullptr;
+    char dir[16] = "";
+    uint16_t segmentCount = DEFAULT_SEGMENTS;
+    uint16_t recordsPerSegment = DEFAULT_SEGMENT_RECORDS;
+
+    uint32_t head = 0; // Næste sekvensnummer der skrives
+    uint32_t tail = 0; // Ældste sekvensnummer der ikke er sendt
+    uint32_t committedTail = 0;
+    uint32_t commits = 0;
+    uint32_t droppedRecords = 0;
+
+    // Hovedsegmentet holdes åbent til både skrivning og læsning; ældre segmenter læses via readFile
+    File writeFile;
+    uint16_t writeSegment = 0xFFFF;
+    File readFile;
+    uint16_t readSegment = 0xFFFF;
+};
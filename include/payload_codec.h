@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "event_queue.h"
+
+// Kodning af pladebeskeder til MQTT og offline-loggen, uden heap-allokering.
+//
+// PAYLOAD_JSON er det oprindelige format med banen tilføjet:
+// {"plate":"...","timestamp":"...","lane":0}.
+// PAYLOAD_BINARY er kompakt og versioneret (little endian):
+//
+//   [0]     0xA0 | version (0xA2 for version 2). Kan ikke forveksles med '{'
+//   [1]     flag: bit 0 = tidsstempel som tekst, bit 1 = tidsstempel med brøkdel
+//   [2]     bane (findes ikke i version 1, som læses som bane 0)
+//   tid     int64: mikrosekunder siden 1970-01-01T00:00:00 i samme lokale tid som
+//           JSON-tidsstemplet, eller (bit 0) uint8 længde + tekst
+//   plade   uint8 længde + tegn
+//
+// Flere beskeder kan samles i én MQTT-besked med PayloadBatch (se nedenfor).
+// Modtageren skelner formaterne på første byte; se subscriber_py/payload_codec.py.
+enum PayloadFormat : uint8_t {
+    PAYLOAD_JSON = 0,
+    PAYLOAD_BINARY = 1,
+};
+
+static const uint8_t PAYLOAD_BINARY_VERSION = 2;
+static const uint8_t PAYLOAD_BINARY_MARKER = 0xA0;
+static const uint8_t PAYLOAD_FLAG_TEXT_TIME = 0x01;
+static const uint8_t PAYLOAD_FLAG_FRACTION = 0x02;
+static const uint8_t PAYLOAD_BATCH_VERSION = 1;
+static const uint8_t PAYLOAD_BATCH_MARKER = 0xB0;
+
+// Skriv beskeden i buffer; returnerer antal bytes, eller 0 hvis bufferen er for lille.
+// JSON nul-termineres (terminatoren tælles ikke med)
+size_t encodeJson(const PlateReading &reading, char *buffer, size_t size);
+size_t encodeBinary(const PlateReading &reading, uint8_t *buffer, size_t size);
+size_t encodePayload(PayloadFormat format, const PlateReading &reading, uint8_t *buffer, size_t size);
+// Tilstedeværelse: pladen er set count gange mere siden den blev publiceret. Uden tidsstempel,
+// så beskeden er mindre end en hændelse; den sendes straks, så modtagetiden er tidspunktet
+size_t encodePresenceJson(const PlateReading &reading, uint16_t count, char *buffer, size_t size);
+
+// Læs en binær besked tilbage; false hvis den er ødelagt eller har en ukendt version
+bool decodeBinary(const uint8_t *data, size_t length, PlateReading &reading);
+
+// Samler færdigkodede beskeder til én MQTT-besked i en buffer fra kalderen.
+//
+// JSON-beskeder samles i et array: [{...},{...}]. Binære beskeder pakkes som
+//
+//   [0]     0xB0 | version (0xB1 for version 1)
+//   [1]     antal beskeder
+//   besked  uint8 længde + den binære besked, gentaget
+//
+// De to slags blandes ikke; add() afviser en besked af den anden slags, så
+// kalderen sender det samlede og starter forfra. Består samlingen kun af én
+// besked, sendes den uændret, så modtagere uden batch-understøttelse virker.
+class PayloadBatch {
+public:
+    PayloadBatch(uint8_t *buffer, size_t size, size_t maxRecords) : buffer(buffer), size(size), maxRecords(maxRecords) {}
+
+    // Tilføj en besked; false hvis den ikke kan være der eller er af den anden slags
+    bool add(const uint8_t *record, size_t length);
+    // Afslut samlingen og returner dens længde (kaldes én gang). Bufferen og count()
+    // gælder indtil clear()
+    size_t finish();
+    void clear();
+
+    size_t count() const { return records; }
+    bool full() const { return records >= maxRecords || records >= 0xFF; }
+
+private:
+    uint8_t *buffer;
+    size_t size;
+    size_t maxRecords;
+    size_t records = 0;
+    size_t length = 0;
+    bool json = false;
+    size_t firstLength = 0; // Længden af første besked, til at sende den alene
+};
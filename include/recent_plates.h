@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "rtc_sealed.h"
+
+// Nyligt sete plader (RTC_DATA_ATTR), så en bil i kø ved porten ikke publiceres igen
+// hver gang den udløser sensoren.
+//
+// Pladerne gemmes som 32-bit hash med tidspunktet for sidste observation. En plade der
+// ses igen inden for ttlUs regnes som den samme bil, og tiden forlænges (bilen holder
+// der stadig). Når cachen er fuld, overskrives den der har været væk længst (LRU).
+// Med CAPACITY pladser er opslaget en lineær søgning over hashværdierne, som er
+// hurtigere end en hashtabel ved så få pladser. Sealet sættes før deep sleep, ikke ved
+// hvert opslag.
+struct RecentPlates : RtcSealed<RecentPlates> {
+    static const uint8_t CAPACITY = 32;
+
+    struct Entry {
+        uint32_t hash; // 0 = tom plads
+        uint16_t repeats; // Gentagelser siden pladen blev publiceret
+        int64_t lastSeenUs; // Vægur-tid i mikrosekunder siden epoch
+    };
+
+    Entry entries[CAPACITY];
+    uint32_t crc;
+
+    // Registrer pladen set ved nowUs. Returnerer antal gentagelser hvis den er set inden
+    // for ttlUs (bilen holder der stadig), ellers 0 og pladen skal publiceres
+    uint16_t seen(const char *plate, int64_t nowUs, int64_t ttlUs);
+
+    static uint32_t hash(const char *plate);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "rtc_sealed.h"
+
+// Bevægelser registreret under korte opvågninger uden radio (RTC_DATA_ATTR).
+//
+// I radiofri tilstand gemmer en opvågning fra sensoren kun tidspunktet her og går
+// straks i deep sleep igen. WiFi, scanner og MQTT startes først når uploadDue()
+// siger til, og så hentes pladerne for alle ventende bevægelser på én gang.
+// Når ringen er fuld, gemmes resten på LittleFS (spilled tæller dem), og så længe
+// der ligger noget dér, går nye bevægelser også dertil, så rækkefølgen bevares.
+// Bevægelser fjernes først når deres plade er afleveret; mislykkes en upload, venter
+// næste forsøg retryUs, så en opvågning uden WiFi ikke gentages ved hver bevægelse.
+struct RtcEventBuffer : RtcSealed<RtcEventBuffer> {
+    static const uint8_t CAPACITY = 64;
+
+    int64_t captureUs[CAPACITY]; // Vægur-tid i mikrosekunder siden epoch, ældste først
+    uint8_t lane[CAPACITY]; // Banen der vækkede enheden
+    uint8_t attempts[CAPACITY]; // Scanninger der ikke gav en plade
+    uint8_t head; // Indeks for den ældste
+    uint8_t count;
+    uint32_t spilled; // Bevægelser der venter på LittleFS
+    int64_t oldestUs; // Ældste ventende bevægelse, også på LittleFS (0 = ingen)
+    int64_t lastUploadUs; // Vægur-tid for sidste uploadforsøg (0 = alt er afleveret siden)
+    uint32_t crc;
+
+    bool valid() const; // Også head og count inden for ringen
+
+    // Tilføj en bevægelse; false hvis den skal gemmes på LittleFS i stedet
+    bool push(int64_t us, uint8_t lane, uint8_t attempts = 0);
+    // Læs bevægelse nr. index i ringen (0 = ældste) uden at fjerne den
+    bool peek(uint8_t index, int64_t &us, uint8_t &lane, uint8_t &attempts) const;
+    // Fjern de n ældste i ringen, når de er afleveret
+    void drop(uint8_t n);
+    // En bevægelse er gemt på LittleFS
+    void spill(int64_t us);
+
+    bool full() const { return count >= CAPACITY; }
+    uint32_t pending() const { return count + spilled; }
+
+    // Skal radioen tændes? Ved mindst minCount ventende, når den ældste er maxAgeUs
+    // gammel, eller når ringen er fyldt til fillPercent, men tidligst retryUs efter
+    // et uploadforsøg der ikke fik alt afleveret
+    bool uploadDue(int64_t nowUs, uint32_t minCount, int64_t maxAgeUs, uint8_t fillPercent, int64_t retryUs) const {
+        return pending() > 0 && uploadInUs(nowUs, minCount, maxAgeUs, fillPercent, retryUs) == 0;
+    }
+    // Mikrosekunder til uploadDue() bliver sand uden nye bevægelser (-1 = intet venter)
+    int64_t uploadInUs(int64_t nowUs, uint32_t minCount, int64_t maxAgeUs, uint8_t fillPercent,
+                       int64_t retryUs) const;
+};
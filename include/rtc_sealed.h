@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+#include "checksum.h"
+
+// CRC-segl for strukturer der overlever deep sleep (RTC_DATA_ATTR) eller gemmes binært.
+//
+// T arver RtcSealed<T> og har uint32_t crc som sidste felt; CRC'en dækker alt før det, så
+// en kold start eller ødelagt hukommelse giver en ugyldig struktur, som kalderen nulstiller
+// i stedet for at bruge. Sealet sættes efter ændringer, typisk lige før deep sleep. T kan
+// skjule valid() eller reset() med sin egen, der lægger ekstra tjek eller startværdier på.
+template <typename T> struct RtcSealed {
+    bool valid() const { return crc32(self(), offsetof(T, crc)) == self()->crc; }
+    void seal() { self()->crc = crc32(self(), offsetof(T, crc)); } // Beregn CRC efter ændringer
+    // Nulstillet (men gyldig) struktur
+    void reset() {
+        memset(self(), 0, sizeof(T));
+        seal();
+    }
+
+private:
+    T *self() { return static_cast<T *>(this); }
+    const T *self() const { return static_cast<const T *>(this); }
+};
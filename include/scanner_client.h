@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include "event_queue.h"
+
+// Vedvarende HTTP/1.1-forbindelse til pladescanneren.
+//
+// Forbindelsen genbruges (keep-alive) mellem forespørgsler, og svaret parses byte
+// for byte direkte ind i PlateReading, så en forespørgsel ikke allokerer. Med
+// fetchBatch() hentes alle plader scanneren har i kø med én forespørgsel
+// (GET /get_plates, én "plade,tidsstempel" pr. linje). Med flere baner vælger
+// lane=N kameraet; bane 0 sendes uden parameter, så en scanner med ét kamera
+// virker uændret. Ikke trådsikker: hver opgave skal have sin egen instans.
+class ScannerClient {
+public:
+    ScannerClient(const char *host, uint16_t port) : host(host), port(port) {}
+
+    void setTimeout(uint32_t ms) { timeoutMs = ms; }
+
+    // Hent én plade (GET /get_plate)
+    bool fetch(PlateReading &reading, uint8_t lane = 0);
+    // Hent op til max plader i scannerens rækkefølge; returnerer antallet. Kender
+    // scanneren ikke /get_plates, hentes de én ad gangen fremover
+    size_t fetchBatch(PlateReading *readings, size_t max, uint8_t lane = 0);
+
+    void stop() { client.stop(); }
+    uint32_t connects() const { return connectCount; }
+    bool batchSupported() const { return batchEnabled; }
+    // HTTP-status for sidste forespørgsel; negativ når scanneren ikke svarede
+    int lastStatus() const { return status; }
+
+private:
+    static const size_t LINE_SIZE = 64;
+
+    // Send GET path og parse svaret; returnerer HTTP-status eller negativ ved fejl
+    int request(const char *path, PlateReading *readings, size_t max, size_t &count);
+    int exchange(const char *path, PlateReading *readings, size_t max, size_t &count, bool &responded);
+    bool readByte(uint8_t &c);
+    bool readLine(char *line, size_t size);
+
+    WiFiClient client;
+    const char *host;
+    uint16_t port;
+    uint32_t timeoutMs = 5000;
+    uint32_t connectCount = 0;
+    bool batchEnabled = true;
+    int status = 0;
+
+    uint8_t buffer[128];
+    size_t bufferPos = 0;
+    size_t bufferLen = 0;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "event_queue.h"
+
+// De seneste plader til /status. Publiceringsopgaven skriver og webserveren læser;
+// main.cpp tager telemetryMutex omkring begge dele.
+struct RecentEvents {
+    static const uint8_t CAPACITY = 8;
+
+    PlateReading readings[CAPACITY];
+    uint32_t total = 0; // Antal plader nogensinde lagt i ringen
+
+    void add(const PlateReading &reading);
+    // Kopier op til CAPACITY plader til out, nyeste først; returnerer antallet
+    uint8_t copy(PlateReading *out) const;
+};
+
+// Tallene på statussiden, kopieret på én gang ved forespørgslen så svaret hænger sammen
+struct StatusSnapshot {
+    uint32_t uptimeS;
+    const char *powerState;
+    bool wifiConnected;
+    int8_t rssi;
+    uint32_t ip;
+    bool mqttConnected;
+    uint32_t mqttAttempts;
+    uint8_t mqttInFlight;
+    bool backlogKnown; // false: loggen er ikke åbnet siden deep sleep, og antallet kendes ikke
+    uint32_t backlogRecords;
+    uint32_t backlogDropped;
+    uint32_t eventsInFlight;
+    uint32_t plates;
+    uint32_t repeatedPlates;
+    uint32_t idleTimeoutMs;
+    uint8_t eventCount;
+    PlateReading events[RecentEvents::CAPACITY]; // Nyeste først
+};
+
+// Statussiden som JSON skrevet direkte i webserverens sendebuffer (chunked svar).
+//
+// fill() kaldes hver gang der er plads i TCP-vinduet. Svaret formateres én del ad
+// gangen (en gruppe felter eller én plade) i en lille buffer, og det der ikke kan
+// nå med, fortsætter i næste kald. Der bygges ingen String, og hele svaret ligger
+// aldrig i hukommelsen; ud over øjebliksbilledet fylder strømmen under 200 bytes.
+class StatusStream {
+public:
+    StatusSnapshot snapshot; // Udfyldes af kalderen før første fill()
+
+    // Skriv op til maxLen bytes; 0 når svaret er færdigt
+    size_t fill(uint8_t *buffer, size_t maxLen);
+
+private:
+    // Formater del nr. part; 0 når der ikke er flere
+    size_t writePart(uint32_t part, char *out, size_t size) const;
+
+    char pending[192];
+    size_t pendingLength = 0;
+    size_t pendingOffset = 0;
+    uint32_t part = 0;
+    bool done = false;
+};
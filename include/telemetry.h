@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "rtc_sealed.h"
+
+// Måling af hot path i felten: histogrammer og tællere der overlever deep sleep (RTC_DATA_ATTR).
+//
+// Hvert trin har et histogram med faste log2-spande, så en måling koster et par
+// instruktioner og ingen allokering. Tællerne er summer siden sidste telemetribesked;
+// efter publicering nulstilles det hele, så modtageren kan lægge perioderne sammen.
+// Strukturen er ikke trådsikker; main.cpp tager telemetryMutex omkring den.
+enum TelemetryStage : uint8_t {
+    STAGE_WAKE, // Interrupt til opsamlingsopgaven (efter deep sleep: opstart til pipelinen kører)
+    STAGE_WIFI, // WiFi-forbindelse, hurtig eller fuld
+    STAGE_NTP, // NTP-synkronisering
+    STAGE_SCANNER, // HTTP-forespørgsel til scanneren
+    STAGE_PUBLISH, // Afsendelse af en MQTT-besked til brokerens PUBACK
+    STAGE_DRAIN, // Ét gennemløb af sendSavedData
+    STAGE_BOOT, // Opstart til setup() er færdig
+    STAGE_COUNT
+};
+
+// Strømtilstande der tælles tid i. Aktiv er alt der ikke er en af de andre
+enum PowerState : uint8_t {
+    POWER_ACTIVE, // CPU og radio kører
+    POWER_MODEM_SLEEP, // Venter på hændelser med WiFi forbundet; radioen sover mellem beacons
+    POWER_LIGHT_SLEEP, // esp_light_sleep_start uden WiFi, vækkes af sensor eller timer
+    POWER_DEEP_SLEEP, // Fra goToSleep til næste opstart (kræver sat ur)
+    POWER_STATE_COUNT
+};
+
+struct LatencyHistogram {
+    // Spand i dækker [2^i, 2^(i+1)) mikrosekunder; den sidste tager alt over ca. 8 s
+    static const uint8_t BUCKETS = 24;
+
+    uint16_t buckets[BUCKETS]; // Mætter ved 65535
+    uint32_t count;
+    uint32_t maxUs;
+
+    void record(uint32_t us);
+    // Øvre grænse for spanden med den pct'ende percentil (højst maxUs)
+    uint32_t percentileUs(uint8_t pct) const;
+};
+
+struct Telemetry : RtcSealed<Telemetry> {
+    static const uint8_t DEVICE_ID_MAX = 32; // Længere enheds-id'er afkortes i beskeden
+    // Største besked encodeJson kan skrive: alle tællere ved deres maksimum, alle spande
+    // brugt og et id på DEVICE_ID_MAX tegn (se test/test_telemetry)
+    static const size_t JSON_MAX = 2304;
+
+    LatencyHistogram stages[STAGE_COUNT];
+
+    uint32_t wakes; // Fulde opvågninger med radio
+    uint32_t shortWakes; // Korte opvågninger i radiofri tilstand
+    uint32_t droppedEvents; // Tabt fordi interrupt-køen var fuld
+    uint32_t debouncedEvents; // Flanker ignoreret af debounce
+    uint32_t mqttAttempts; // Forbindelsesforsøg til brokeren
+    uint32_t plates; // Plader fra scanneren
+    uint32_t repeatedPlates; // Heraf set for nylig og kun sendt som tilstedeværelse (se RecentPlates)
+    uint32_t backlogDepth; // Poster i offline-loggen ved sidste måling
+    uint32_t backlogMax;
+    uint32_t backlogDropped; // Poster tabt fra offline-loggen
+    uint32_t idleTimeoutMs; // Inaktivitetstid før deep sleep ved sidste måling (se IdleTimeout)
+    uint64_t powerUs[POWER_STATE_COUNT]; // Tid i hver strømtilstand
+    int64_t sleepStartUs; // Vægur-tid da deep sleep begyndte (0 = vågen)
+    int64_t periodStartUs; // Vægur-tid for periodens start (0 = ikke sat)
+    uint32_t crc;
+
+    void reset(int64_t nowUs); // Ny periode der starter ved nowUs
+
+    void record(TelemetryStage stage, int64_t us);
+    void backlog(uint32_t depth);
+    void power(PowerState state, int64_t us);
+
+    // JSON til telemetri-emnet; returnerer længden eller 0 hvis bufferen er for lille.
+    // En buffer på JSON_MAX bytes er altid stor nok
+    size_t encodeJson(const char *deviceId, int64_t nowUs, uint32_t wakeToPublishMs, char *buffer,
+                      size_t size) const;
+
+    static const char *stageName(TelemetryStage stage);
+    static const char *powerStateName(PowerState state);
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "rtc_sealed.h"
+
+// Netværks- og urtilstand der overlever deep sleep (RTC_DATA_ATTR).
+//
+// Med BSSID og kanal fra sidste forbindelse kan en opvågning forbinde uden scanning,
+// og med et driftkorrigeret ur behøver NTP kun at køre en gang imellem. Adressen
+// hentes stadig med DHCP, da routeren kan have givet den videre siden sidst. En ugyldig
+// cache (se RtcSealed) ender altid i den fulde, langsomme vej. Tomme felter (kanal 0,
+// ntpSyncUs 0) betyder at den del ikke er kendt endnu.
+struct WakeCache : RtcSealed<WakeCache> {
+    static const uint32_t BACKLOG_UNKNOWN = 0xFFFFFFFF;
+
+    // Sidste access point; channel == 0 betyder ingen gemt forbindelse
+    uint8_t bssid[6];
+    int32_t channel;
+
+    // Ur: alle tider er vægur-tid i mikrosekunder siden epoch
+    int64_t ntpSyncUs; // Sidste NTP-synkronisering (0 = aldrig)
+    int64_t correctedUs; // Sidst driftkorrektionen blev lagt på uret
+    int32_t driftPpb; // Hvor meget RTC-uret går for langsomt (milliardtedele)
+
+    uint32_t wakeToPublishMs; // Opvågning til første publicering ved sidste opvågning (0 = ingen)
+    uint32_t backlogRecords; // Poster i offline-loggen ved deep sleep (BACKLOG_UNKNOWN = ikke talt)
+    uint32_t crc;
+
+    void reset(); // Tom (men gyldig) cache; backloggen er ukendt
+
+    bool hasNetwork() const { return channel != 0; }
+    bool clockSynced() const { return ntpSyncUs > 0; }
+    bool ntpDue(int64_t nowUs, int64_t intervalUs) const { return !clockSynced() || nowUs - ntpSyncUs >= intervalUs; }
+
+    // Hvor meget uret skal justeres ved nowUs ud fra den målte drift siden sidste korrektion
+    int64_t driftCorrectionUs(int64_t nowUs) const;
+    // Registrer en NTP-synkronisering: localUs er hvad uret ville have vist, ntpUs den nye tid.
+    // Restfejlen siden sidste synkronisering justerer driften
+    void recordSync(int64_t localUs, int64_t ntpUs);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <FS.h>
+
+// En statisk fil fra LittleFS, gzip-komprimeret ved bygningen (scripts/gzip_assets.py).
+//
+// Ligger kun path + ".gz" i filsystemet, sender webserveren den med Content-Encoding: gzip.
+// ETag er CRC32 over den fil der sendes, beregnet ved første forespørgsel efter opstart,
+// så den passer til filsystemet selv hvis det er lagt op uden ny firmware.
+// Cache-Control: no-cache lader browseren gemme filen men spørge hver gang, og svaret
+// er da 304 uden indhold.
+class WebAsset {
+public:
+    WebAsset(const char *path, const char *contentType) : path(path), contentType(contentType) {}
+
+    void serve(fs::FS &fs, AsyncWebServerRequest *request);
+    // ETag med anførselstegn, eller "" hvis filen ikke findes
+    const char *etag(fs::FS &fs);
+
+private:
+    const char *path;
+    const char *contentType;
+    char tag[11] = "";
+};
@@ -0,0 +1,41 @@
+# Før-script til PlatformIO (extra_scripts): gzip filerne i data/ ind i build-mappen og byg
+# LittleFS-billedet derfra. Webserveren sender path + ".gz" med Content-Encoding: gzip,
+# når den ukomprimerede fil ikke findes (se include/web_asset.h).
+#
+# data/ er stadig kilden; den komprimerede kopi laves forfra ved hver kørsel, så
+# `pio run -t uploadfs` altid lægger den aktuelle udgave op.
+Import("env")
+
+import gzip
+import os
+import shutil
+
+# Tekstfiler komprimeres; alt andet kopieres uændret
+COMPRESS = (".html", ".css", ".js", ".json", ".svg", ".txt")
+
+source_dir = env.subst("$PROJECT_DATA_DIR")
+target_dir = os.path.join(env.subst("$PROJECT_BUILD_DIR"), env.subst("$PIOENV"), "data_gz")
+
+
+def gzip_assets():
+    shutil.rmtree(target_dir, ignore_errors=True)
+    for root, _, files in os.walk(source_dir):
+        for name in files:
+            source = os.path.join(root, name)
+            target = os.path.join(target_dir, os.path.relpath(source, source_dir))
+            os.makedirs(os.path.dirname(target), exist_ok=True)
+            if not name.endswith(COMPRESS):
+                shutil.copy2(source, target)
+                continue
+            with open(source, "rb") as f:
+                data = f.read()
+            # mtime=0: samme indhold giver samme fil og dermed samme ETag på enheden
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            with open(target + ".gz", "wb") as f:
+                f.write(packed)
+            print("gzip %s: %d -> %d bytes" % (os.path.relpath(source, source_dir), len(data), len(packed)))
+
+
+if os.path.isdir(source_dir):
+    gzip_assets()
+    env.Replace(PROJECT_DATA_DIR=target_dir)
@@ -0,0 +1,120 @@
+#include "backlog_sender.h"
+
+#include "payload_codec.h"
+
+bool BacklogSender::configure(uint8_t window, uint32_t ackTimeoutMs) {
+    client.setSocketTimeout(MQTT_CONNECT_TIMEOUT_S);
+    client.setKeepAlive(MQTT_KEEPALIVE_S);
+    outbox.setKeepAlive(MQTT_KEEPALIVE_S);
+    outbox.setWindow(window);
+    outbox.setAckTimeout(ackTimeoutMs);
+    connection.setBackoff(MQTT_BACKOFF_MIN_MS, MQTT_BACKOFF_MAX_MS);
+    return client.setBufferSize(MQTT_BUFFER_SIZE);
+}
+
+void BacklogSender::lock() {
+    if (logMutex) {
+        xSemaphoreTake(logMutex, portMAX_DELAY);
+    }
+}
+
+void BacklogSender::unlock() {
+    if (logMutex) {
+        xSemaphoreGive(logMutex);
+    }
+}
+
+bool BacklogSender::service() {
+    bool active = connection.poll();
+    if (active && !outbox.poll()) {
+        client.disconnect(); // Ingen kvittering: genopkobl og send igen
+        active = false;
+    }
+    lock();
+    if (!active) {
+        outbox.reset(log.oldestSeq());
+    } else if (outbox.ackedSeq() > log.oldestSeq()) {
+        log.popUntil(outbox.ackedSeq());
+    }
+    unlock();
+    return active;
+}
+
+// Første post der ikke er sendt endnu
+uint32_t BacklogSender::firstUnsent() const {
+    uint32_t seq = outbox.sentSeq();
+    return seq > log.oldestSeq() ? seq : log.oldestSeq();
+}
+
+bool BacklogSender::ready() {
+    lock();
+    uint32_t unsent = log.nextSeq() - firstUnsent();
+    unlock();
+    if (unsent == 0 || !outbox.canSend()) {
+        if (unsent == 0) {
+            partialBatchSince = 0;
+        }
+        return false;
+    }
+    if (unsent >= MQTT_BATCH_RECORDS || outbox.inFlight() == 0) {
+        return true;
+    }
+    if (partialBatchSince == 0) {
+        partialBatchSince = millis() | 1;
+    }
+    return millis() - partialBatchSince >= MQTT_BATCH_FLUSH_MS;
+}
+
+uint32_t BacklogSender::send(uint32_t budgetMs) {
+    if (!client.connected()) {
+        return 0;
+    }
+
+    // Plads i PubSubClients buffer efter header (5), emnelængde (2), emne og pakke-id (2)
+    size_t maxBytes = client.getBufferSize() - 9 - strlen(topic);
+    if (maxBytes > bufferSize) {
+        maxBytes = bufferSize;
+    }
+
+    // Poster samles i rækkefølge. Låsen holdes ikke under selve publish, så andre opgaver
+    // kan gemme imens
+    uint8_t record[OfflineLog::PAYLOAD_SIZE];
+    size_t length;
+    uint32_t sent = 0;
+    unsigned long start = millis();
+    PayloadBatch batch(buffer, maxBytes, MQTT_BATCH_RECORDS);
+    while (millis() - start < budgetMs && !(stopCondition && stopCondition()) && ready()) {
+        batch.clear();
+        lock();
+        uint32_t seq = firstUnsent();
+        uint32_t end = log.nextSeq();
+        // Stop ved en post af den anden slags eller når samlingen er fuld. En ødelagt post
+        // springes over, men regnes med i samlingens interval, så den slettes sammen med den
+        for (; seq < end && !batch.full(); seq++) {
+            if (log.read(seq, record, sizeof(record), length) && !batch.add(record, length)) {
+                break;
+            }
+        }
+        if (batch.count() == 0 && outbox.inFlight() == 0) {
+            log.popUntil(seq); // Kun ødelagte poster; intet at vente på
+            outbox.reset(seq);
+        }
+        unlock();
+        if (batch.count() == 0) {
+            break;
+        }
+
+        size_t count = batch.count();
+        size_t batchLength = batch.finish();
+        if (!outbox.publish(topic, buffer, batchLength, seq)) {
+            Serial.printf("Fejl ved at sende %u poster til MQTT. Gemmer til senere.\n", (unsigned)count);
+            break;
+        }
+        sent += count;
+        sentMessages++;
+        if (!batch.full()) {
+            partialBatchSince = 0;
+        }
+    }
+    return sent;
+}
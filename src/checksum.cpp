@@ -0,0 +1,18 @@
+#include "checksum.h"
+
+// Nibble-tabel: 64 bytes i stedet for 1 KB, og stadig hurtig nok til poster på 128 bytes
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    while (length--) {
+        crc ^= *bytes++;
+        crc = crcTable[crc & 0x0F] ^ (crc >> 4);
+        crc = crcTable[crc & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
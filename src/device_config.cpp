@@ -0,0 +1,36 @@
+#include "device_config.h"
+
+bool DeviceConfig::valid() const {
+    return magic == MAGIC && version == VERSION && size == sizeof(DeviceConfig) &&
+           RtcSealed::valid();
+}
+
+void DeviceConfig::reset() {
+    memset(this, 0, sizeof(*this));
+    magic = MAGIC;
+    version = VERSION;
+    size = sizeof(DeviceConfig);
+    seal();
+}
+
+bool DeviceConfig::load(fs::FS &fs, const char *path) {
+    File file = fs.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    size_t length = file.read((uint8_t *)this, sizeof(*this));
+    file.close();
+    return length == sizeof(*this) && valid();
+}
+
+bool DeviceConfig::save(fs::FS &fs, const char *path) const {
+    char tmpPath[40];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    File file = fs.open(tmpPath, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    bool ok = file.write((const uint8_t *)this, sizeof(*this)) == sizeof(*this);
+    file.close();
+    return ok && fs.rename(tmpPath, path);
+}
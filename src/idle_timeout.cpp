@@ -0,0 +1,28 @@
+#include "idle_timeout.h"
+
+void IdleTimeout::motion(int64_t nowUs) {
+    // Et ur der er sat tilbage (fx ved NTP) giver ingen måling
+    if (lastMotionUs != 0 && nowUs > lastMotionUs) {
+        int64_t gap = (nowUs - lastMotionUs) / 1000;
+        uint32_t sample = gap > 0x3FFFFFFF ? 0x3FFFFFFF : (uint32_t)gap;
+        gapMs = gapMs == 0 ? sample : gapMs - gapMs / 4 + sample / 4;
+        if (gapMs == 0) {
+            gapMs = 1; // 0 betyder ukendt
+        }
+    }
+    lastMotionUs = nowUs;
+}
+
+uint32_t IdleTimeout::timeoutMs(uint32_t defaultMs, uint32_t minMs, uint32_t maxMs) const {
+    if (gapMs == 0) {
+        return defaultMs;
+    }
+    // Op til maxMs / GAP_FACTOR vokser tiden med mellemrummet; derefter aftager den omvendt
+    // proportionalt, så de to dele mødes i maxMs
+    uint64_t knee = maxMs / GAP_FACTOR;
+    uint64_t timeout = gapMs <= knee ? (uint64_t)gapMs * GAP_FACTOR : (uint64_t)maxMs * knee / gapMs;
+    if (timeout > maxMs) {
+        timeout = maxMs;
+    }
+    return timeout < minMs ? minMs : (uint32_t)timeout;
+}
@@ -2,166 +2,742 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <WiFiClient.h>
-#include <HTTPClient.h>
 #include <PubSubClient.h>
 #include "driver/rtc_io.h" // For RTC_DATA_ATTR
-
-// Definer pins til bevægelsessensor og LED
-#define SENSOR1_PIN 33 // Pin til bevægelsessensor
+#include "driver/gpio.h" // Sensorerne som vækkekilde i light sleep
+#include "esp_timer.h"
+#include "esp_sntp.h"
+#include <sys/time.h>
+#include <atomic>
+#include <memory>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "backlog_sender.h"
+#include "device_config.h"
+#include "event_queue.h"
+#include "idle_timeout.h"
+#include "lane_config.h"
+#include "offline_log.h"
+#include "payload_codec.h"
+#include "recent_plates.h"
+#include "rtc_event_buffer.h"
+#include "scanner_client.h"
+#include "status_stream.h"
+#include "telemetry.h"
+#include "mqtt_connection.h"
+#include "mqtt_outbox.h"
+#include "wake_cache.h"
+#include "web_asset.h"
+#if defined(CONFIG_PM_ENABLE)
+#include "esp_pm.h"
+#endif
+
+// Definer pins til LED; sensorerne står i laneConfig herunder
 #define LED_PIN 2 // Pin til LED
 
 #define uS_TO_S_FACTOR 1000000ULL // Mikrosekunder til sekunder
 #define SLEEP_DURATION 1 // Deep sleep-varighed i sekunder
 
+// Radiofri tilstand: en opvågning fra sensoren gemmer kun bevægelsen i RTC-hukommelsen
+// og sover videre; WiFi, scanner og MQTT startes først når en af grænserne nås.
+// Slås til med -DRADIO_DUTY_CYCLE=1
+#ifndef RADIO_DUTY_CYCLE
+#define RADIO_DUTY_CYCLE 0
+#endif
+#define UPLOAD_MIN_EVENTS 16 // Upload når så mange bevægelser venter
+#define UPLOAD_MAX_AGE_S 300 // Upload når den ældste bevægelse er så gammel
+#define UPLOAD_FILL_PERCENT 75 // Upload når RTC-ringen er fyldt så meget
+#define UPLOAD_RETRY_S 60 // Mindste tid fra et uploadforsøg der ikke fik alt afleveret til det næste
+#define UPLOAD_SCAN_ATTEMPTS 3 // Scanninger uden plade før en gemt bevægelse opgives
+#define SENSOR_RELEASE_TIMEOUT_MS 5000 // Så længe venter en kort opvågning på at sensoren slipper
+
+// Standardindstillinger; de gældende står i config (se DeviceConfig)
+
+// Pladescanner (Flask-serverens IP)
+const char *scannerHost = "192.168.0.185";
+const uint16_t scannerPort = 5000;
+
 // MQTT-parametre
 const char *mqttBroker = "broker.hivemq.com"; // MQTT-brokeradresse
-const int mqttPort = 1883; // MQTT-port
+const uint16_t mqttPort = 1883; // MQTT-port
 const char* mqttTopic = "plates/detected"; // MQTT-emne
+const char *telemetryTopic = "plates/telemetry"; // Emne for målinger fra enheden
+const char *presenceTopic = "plates/present"; // Emne for plader der stadig holder ved porten
 const char *mqtt_client_id = "ds18b20"; // MQTT-klient-id
-bool mqttNotActive = false; // Indikator for MQTT-status
+
+// Payloadformat til MQTT og offline-loggen: PAYLOAD_JSON (læsbart) eller PAYLOAD_BINARY
+// (kompakt, se payload_codec.h). Kan sættes med -DPAYLOAD_FORMAT=PAYLOAD_BINARY
+#ifndef PAYLOAD_FORMAT
+#define PAYLOAD_FORMAT PAYLOAD_JSON
+#endif
+
+// MQTT-grænser, vindue og samlinger står i backlog_sender.h
+#define TELEMETRY_INTERVAL_S 3600 // Hvor tit målingerne sendes på telemetryTopic
+
+// En plade der ses igen inden for så mange sekunder efter sidste observation er samme bil
+// i kø ved porten; den sendes kun som en tælling på presenceTopic (QoS 0, ikke gemt)
+#define RECENT_PLATE_TTL_S 60
 
 // Initialiser WiFi og MQTT-klient
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
+MqttConnection mqttConnection(mqttClient, mqtt_client_id);
+MqttOutbox mqttOutbox(espClient);
+uint8_t batchBuffer[MQTT_BATCH_BYTES]; // Kun publiceringsopgaven bygger samlede beskeder
 
 // Debounce-parametre
-volatile unsigned long lastInterruptTime1 = 0; // Tidspunkt for sidste interrupt
-const unsigned long debounceDelay = 5000; // Debounce-tid i millisekunder
-
-// Variabler til inaktivitet
-#define INACTIVITY_TIMEOUT 10000 // Timeout i millisekunder
-RTC_DATA_ATTR unsigned long lastMotionTime = 0; // Sidste bevægelsestid, gemt gennem deep sleep
-unsigned long lastMQTTRetryTime = 0; // Tidspunkt for sidste MQTT-forsøg
+#define DEBOUNCE_DELAY_MS 2000 // Standard debounce-tid i millisekunder pr. bane
+#define MOTION_QUEUE_SIZE 16 // Plads til bevægelser i interrupt-køen (potens af 2)
+
+// Sensorpin og debounce-vindue pr. bane (se lane_config.h)
+const LaneConfig laneConfig[] = {
+    {33, DEBOUNCE_DELAY_MS}, // Bane 0: den oprindelige sensor
+    {32, DEBOUNCE_DELAY_MS},
+    {25, DEBOUNCE_DELAY_MS},
+    {26, DEBOUNCE_DELAY_MS},
+};
+static_assert(LANE_COUNT >= 1 && LANE_COUNT <= sizeof(laneConfig) / sizeof(laneConfig[0]),
+              "LANE_COUNT skal passe til laneConfig");
+static_assert(sizeof(laneConfig) / sizeof(laneConfig[0]) <= DeviceConfig::MAX_LANES,
+              "DeviceConfig skal have plads til alle baner");
+
+// Bevægelser fra interrupt-handlerne til opsamlingsopgaven, tidsstemplet da sensoren trigger.
+// Alle baner deler én kø: GPIO-interrupts kører på kernen der tilknyttede dem og afbryder
+// ikke hinanden, så køen har stadig kun én producent ad gangen
+SpscQueue<MotionEvent, MOTION_QUEUE_SIZE> motionEvents;
+EdgeDebouncer laneDebounce[LANE_COUNT]; // Vinduerne sættes fra laneConfig i setup()
+uint32_t reportedOverflows = 0; // Antal tabte bevægelser der allerede er logget
+
+// Pipeline: opsamling på kerne 1, scanner-I/O og MQTT på kerne 0 (sammen med WiFi-stakken)
+#define CAPTURE_CORE 1
+#define NETWORK_CORE 0
+#define SCANNER_TASKS 2 // Parallelle scannerforespørgsler, så én langsom forespørgsel ikke sætter farten
+#define SCAN_QUEUE_SIZE 8 // Bevægelser der venter på scanneren, pr. scanneropgave
+#define SCAN_BATCH_SIZE 8 // Maks. plader hentet med én forespørgsel når flere biler venter
+#define SCANNER_TIMEOUT_MS 5000 // Timeout for forbindelse og svar fra scanneren
+#define PUBLISH_QUEUE_SIZE 16 // Plader der venter på at blive publiceret
+#define BUFFERED_RETRY_MS 100 // Hvor tit opsamlingsopgaven prøver igen med gemte bevægelser
+#define PUBLISH_IDLE_MS 1000 // Publiceringsopgavens ventetid uden noget at sende; nye plader vækker den
+
+TaskHandle_t captureTaskHandle = nullptr;
+// Scanneren udleverer pladerne for en bane i den rækkefølge bilerne kom, så hver bane har
+// én fast scanneropgave (bane % SCANNER_TASKS); to opgaver kunne ellers bytte om på tiderne
+QueueHandle_t scanQueues[SCANNER_TASKS] = {}; // MotionEvent: opsamling -> scanner
+QueueHandle_t publishQueue = nullptr; // PlateReading: scanner -> publicering
+QueueHandle_t scanResults = nullptr; // ScanResult: scanner -> opsamling, kun for gemte bevægelser
+SemaphoreHandle_t offlineLogMutex = nullptr; // Offline-loggen deles af scanner og publicering
+std::atomic<uint32_t> eventsInFlight(0); // Bevægelser der endnu ikke er publiceret eller gemt
+
+// Variabler til inaktivitet. Loop-funktionen venter på hændelser i stedet for at polle, og
+// tiden før deep sleep tilpasses trafikken (se IdleTimeout)
+#define INACTIVITY_TIMEOUT 10000 // Timeout i millisekunder indtil trafikken er kendt
+// Timeouten er GAP_FACTOR gange det typiske mellemrum op til et mellemrum på INACTIVITY_MAX_MS /
+// GAP_FACTOR og aftager derefter; begge ender holdes over INACTIVITY_MIN_MS
+#define INACTIVITY_MIN_MS 3000 // Nedre grænse: meget tæt trafik (1 s mellemrum) og meget sjælden trafik
+#define INACTIVITY_MAX_MS 60000 // Øvre grænse, nås ved et mellemrum på INACTIVITY_MAX_MS / GAP_FACTOR
+#define SUPERVISOR_RECHECK_MS 1000 // Ny vurdering når søvnen venter på pipelinen
+volatile unsigned long lastMotionTime = 0; // Sidste bevægelsestid (millis() starter forfra ved opstart)
+RTC_DATA_ATTR IdleTimeout idleTimeout; // Mellemrum mellem bevægelser, gemt gennem deep sleep
+TaskHandle_t supervisorTaskHandle = nullptr; // loop(); vækkes når der kan være grund til at sove
+bool apActive = false; // AP-mode kører webserveren og må ikke gå i light sleep
+
+// Tid i hver strømtilstand til telemetrien; beskyttet af telemetryMutex
+PowerState powerState = POWER_ACTIVE;
+int64_t powerSinceUs = 0; // esp_timer-tid for sidste skift; tiden fra opstart er aktiv
 
 // Webserver konfigureret til port 80
 AsyncWebServer server(80);
+// Opsætningssiden i AP-mode; filerne ligger gzip-komprimeret i LittleFS (se web_asset.h)
+WebAsset wifiManagerPage("/wifimanager.html", "text/html");
+WebAsset styleSheet("/style.css", "text/css");
+
+// Indstillinger: én binær post på LittleFS og en kopi i RTC, så opvågninger fra deep sleep
+// ikke behøver filsystemet
+const char *configPath = "/config.bin";
+RTC_DATA_ATTR DeviceConfig config;
 
-// Filer i LittleFS til gemte data
+// Filer i LittleFS fra før /config.bin; flyttes én gang og slettes
 const char *ssidPath = "/ssid.txt"; // Filsti til WiFi-SSID
 const char *passPath = "/pass.txt"; // Filsti til WiFi-password
-const char *dataPath = "/data.txt"; // Filsti til gemt data
+const char *dataPath = "/data.txt"; // Filsti til gemt data (gammelt format, flyttes til offline-loggen)
+
+// Beskeder der ikke kunne sendes, gemt i en segmenteret ringlog på LittleFS. Åbnes først når
+// der er noget at gemme eller sende (se openBacklog)
+OfflineLog offlineLog;
+BacklogSender backlogSender(mqttClient, mqttConnection, mqttOutbox, offlineLog, mqttTopic, batchBuffer,
+                            sizeof(batchBuffer));
+
+// Bevægelser fra korte opvågninger i radiofri tilstand; LittleFS tager over når ringen er fuld.
+// Bevægelser scannerkøen ikke kan rumme, gemmes også på LittleFS (se captureTask)
+RTC_DATA_ATTR RtcEventBuffer rtcEvents;
+OfflineLog pendingEvents;
+const char *pendingDir = "/pending";
+bool wakeBuffered = false; // Bevægelsen der vækkede os er allerede gemt i rtcEvents
+
+// Gemte bevægelser hos scanneren. De bliver i rtcEvents og pendingEvents, indtil scanneropgaverne
+// har meldt tilbage for hver af dem, så en genstart eller en scanner uden svar ikke taber dem.
+// Kun opsamlingsopgaven bruger dem
+struct BufferedScan {
+    int64_t captureUs; // Vægur-tid
+    uint8_t lane;
+    uint8_t attempts;
+    bool done;
+    ScanOutcome outcome;
+};
+struct ScanResult {
+    uint8_t slot; // Indeks i bufferedScans
+    ScanOutcome outcome;
+};
+BufferedScan bufferedScans[MOTION_QUEUE_SIZE];
+uint8_t bufferedTaken = 0; // Antal hos scanneren; de første bufferedFromRing kommer fra rtcEvents
+uint8_t bufferedFromRing = 0;
+uint8_t bufferedOpen = 0; // Endnu uden svar
+uint32_t bufferedLogEnd = 0; // Poster i pendingEvents før dette nummer er hos scanneren
+std::atomic<bool> bufferedFailed(false); // En upload i denne opvågning fik ikke alt afleveret ...
+unsigned long bufferedFailedAt = 0; // ... ved denne millis()
+
+// Nyligt sete plader; kun publiceringsopgaven slår op i den
+RTC_DATA_ATTR RecentPlates recentPlates;
+
+// Tidsmålinger og tællere der overlever deep sleep; låsen fordi alle opgaver måler
+RTC_DATA_ATTR Telemetry telemetry;
+SemaphoreHandle_t telemetryMutex = nullptr;
+char telemetryBuffer[Telemetry::JSON_MAX]; // Kun publiceringsopgaven sender telemetri
+RecentEvents recentEvents; // De seneste publicerede plader til /status; beskyttes også af telemetryMutex
+uint32_t seenOverflows = 0; // Tællerne herunder er pr. opstart; telemetrien får forskellen
+uint32_t seenSuppressed = 0;
+uint32_t seenAttempts = 0;
+uint32_t seenLogDropped = 0;
 
 // WiFi-parameternavne
 const char *PARAM_INPUT_1 = "ssid"; // SSID-parameternavn
 const char *PARAM_INPUT_2 = "password"; // Password-parameternavn
 
-// Variabler til WiFi-data
-String ssid; // Gemt SSID
-String pass; // Gemt password
-String data; // Gemt data
-
 // Tidservere
 const char* ntpServer = "pool.ntp.org";
 const long gmtOffset_sec = 3600; // Justér for din tidszone (GMT+1)
 const int daylightOffset_sec = 3600; // Sommer-/vintertid
 
+// Hurtig opvågning: forbindelse og ur fra sidste opvågning genbruges
+#define WIFI_CONNECT_TIMEOUT_MS 10000 // Fuld forbindelse med scanning og DHCP
+#define WIFI_FAST_TIMEOUT_MS 4000 // Gemt BSSID/kanal uden scanning, med DHCP; derefter fuld forbindelse
+#define NTP_RESYNC_INTERVAL_S (6 * 3600) // NTP køres igen efter så lang tid
+#define NTP_TIMEOUT_MS 5000 // Ventetid på NTP ved kold start
+
+RTC_DATA_ATTR WakeCache wakeCache; // Overlever deep sleep; tjekkes med CRC ved opstart
+bool wifiFromCache = false; // Forbundet til det gemte access point uden scanning
+bool ntpPending = false; // NTP-synkronisering i gang i baggrunden
+int64_t ntpStartWallUs = 0; // Uret da synkroniseringen startede
+int64_t ntpStartTimerUs = 0;
+bool firstPublishDone = false;
+
 // Variabel til AP-mode status
 RTC_DATA_ATTR bool triggerAPMode = false; // Indikator for AP-mode
 
 // Funktionsprototyper
-void IRAM_ATTR handleMotionSensor1();
-void processPlate();
-void initLittleFS();
+void IRAM_ATTR handleLaneMotion(void *arg);
+void IRAM_ATTR queueLaneMotion(uint8_t lane);
+bool anyLaneActive();
+void attachLanes();
+void pollLanes();
+bool pipelineIdle();
+void idleWait(uint32_t ms);
+void lightSleep(uint32_t ms);
+void setPowerState(PowerState state);
+void startPipeline();
+void captureTask(void *parameter);
+void scannerTask(void *parameter);
+void publishTask(void *parameter);
+uint32_t scanPlates(ScannerClient &scanner, const MotionEvent *events, uint32_t count, PlateReading *readings,
+                    ScanOutcome *outcomes = nullptr);
+void reportBufferedScan(const MotionEvent &event, ScanOutcome outcome);
+bool formatCaptureTime(int64_t captureUs, char *buffer, size_t size);
+bool storeOffline(const uint8_t *payload, size_t length);
+bool bufferWake(esp_sleep_wakeup_cause_t cause);
+bool spillEvent(int64_t captureUs, uint8_t lane, uint8_t attempts = 0);
+uint32_t takeBufferedEvents(MotionEvent *events, uint32_t max);
+void resolveBufferedEvents();
+bool bufferedWaiting();
+void recordStage(TelemetryStage stage, int64_t startUs);
+void collectTelemetry();
+bool publishTelemetry();
+bool initLittleFS();
+void loadConfig();
+void defaultConfig();
+bool saveConfig();
+bool openBacklog();
+uint32_t inactivityTimeout();
+bool connectNetwork();
 bool initWiFi();
+bool waitForWiFi(unsigned long timeoutMs);
+void rememberNetwork();
 void setupWiFi();
+void startWebServer();
+void collectStatus(StatusSnapshot &status);
+void handleStatus(AsyncWebServerRequest *request);
 void resetAP();
-bool queryPlateScanner(String &plate, String &timestamp);
-void writeFile(fs::FS &fs, const char *path, const char *message);
 String readFile(fs::FS &fs, const char *path);
-void sendToMQTT(const String &plate, const String &timestamp);
-void reconnectMQTT();
+void processPlate(const PlateReading &reading);
+void sendToMQTT(const PlateReading &reading);
 void goToSleep();
+bool serviceMqtt();
+void onMqttAck(uint32_t latencyUs);
+bool platesWaiting();
 void sendSavedData();
-void appendFile(fs::FS &fs, const char *path, const char *message);
-void handleMQTTConnectionStatus();
+void migrateSavedData();
 void setupRTC();
-
-RTC_DATA_ATTR bool motionDetected = false; // Bevægelsesindikator gemt gennem deep sleep
+void startNtpSync();
+bool checkNtpSync();
+int64_t wallClockUs();
 
 // Setup-funktion initialiserer systemet
 void setup() {
     Serial.begin(115200);
     Serial.println("Starter ESP32...");
 
-    // Initialiser filsystemet
-    initLittleFS();
+    // Radiofri tilstand: gem bevægelsen og sov videre, medmindre det er tid til upload.
+    // Bliver sensoren ved med at være aktiv, fortsættes med en fuld opvågning
+    esp_sleep_wakeup_cause_t wakeCause = esp_sleep_get_wakeup_cause();
+    // goToSleep() bruger låsene også efter en kort opvågning
+    telemetryMutex = xSemaphoreCreateMutex();
+    offlineLogMutex = xSemaphoreCreateMutex();
+    backlogSender.setMutex(offlineLogMutex);
+    if (!telemetry.valid()) {
+        telemetry.reset(0);
+    }
+    if (!recentPlates.valid()) {
+        recentPlates.reset();
+    }
+    if (!idleTimeout.valid()) {
+        idleTimeout.reset();
+    }
+    // Tiden i deep sleep regnes fra goToSleep() til opstart; RTC-uret går videre under søvnen
+    if (telemetry.sleepStartUs != 0) {
+        if (wakeCache.valid() && wakeCache.clockSynced()) {
+            telemetry.power(POWER_DEEP_SLEEP, wallClockUs() - esp_timer_get_time() - telemetry.sleepStartUs);
+        }
+        telemetry.sleepStartUs = 0;
+    }
+    if (RADIO_DUTY_CYCLE && bufferWake(wakeCause)) {
+        telemetry.shortWakes++;
+        for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+            pinMode(laneConfig[lane].pin, INPUT_PULLDOWN);
+        }
+        unsigned long start = millis();
+        while (anyLaneActive() && millis() - start < SENSOR_RELEASE_TIMEOUT_MS) {
+            delay(10);
+        }
+        goToSleep();
+    }
 
-    // Læs gemte WiFi-oplysninger fra LittleFS
-    ssid = readFile(LittleFS, ssidPath);
-    pass = readFile(LittleFS, passPath);
-    data = readFile(LittleFS, dataPath);
+    // Køerne til pipelinen oprettes før noget kan bruge dem
+    for (int i = 0; i < SCANNER_TASKS; i++) {
+        scanQueues[i] = xQueueCreate(SCAN_QUEUE_SIZE, sizeof(MotionEvent));
+    }
+    publishQueue = xQueueCreate(PUBLISH_QUEUE_SIZE, sizeof(PlateReading));
+    scanResults = xQueueCreate(MOTION_QUEUE_SIZE, sizeof(ScanResult));
+    telemetry.wakes++;
+
+    // Indstillinger fra RTC-kopien efter deep sleep, ellers én læsning af /config.bin.
+    // Offline-loggen åbnes først når der er noget at gemme eller sende
+    if (!wakeCache.valid()) {
+        Serial.println("Ingen gyldig RTC-cache (kold start).");
+        wakeCache.reset();
+    }
+    if (!config.valid()) {
+        loadConfig();
+    }
+    if (!rtcEvents.valid()) {
+        rtcEvents.reset();
+    }
+    if (rtcEvents.spilled > 0 && initLittleFS()) {
+        pendingEvents.begin(LittleFS, pendingDir);
+    }
 
-    // Konfigurer bevægelsessensor og LED
-    pinMode(SENSOR1_PIN, INPUT_PULLDOWN); // Sensor som input
+    // Konfigurer bevægelsessensorerne og LED
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        pinMode(laneConfig[lane].pin, INPUT_PULLDOWN); // Sensor som input
+        laneDebounce[lane].windowUs = config.debounceMs[lane] * 1000UL;
+    }
+
+    // Check sensorstatus ved opstart. Vækkede en sensor os fra deep sleep, dateres
+    // bevægelsen til opvågningen (tid 0) og ikke til når setup() når hertil.
+    // ext1-status siger hvilke baner der vækkede os; flere kan trigge samtidig.
+    // Før attachLanes(), så køen stadig kun har én producent ad gangen
+    uint64_t wakePins = wakeCause == ESP_SLEEP_WAKEUP_EXT1 ? esp_sleep_get_ext1_wakeup_status() : 0;
+    for (uint8_t lane = 0; lane < LANE_COUNT && !wakeBuffered; lane++) {
+        bool wokeBySensor = wakePins & (1ULL << laneConfig[lane].pin);
+        if (wokeBySensor || digitalRead(laneConfig[lane].pin) == HIGH) {
+            Serial.printf("Sensor på bane %u aktiv ved opstart.\n", (unsigned)lane);
+            int64_t captureUs = wokeBySensor ? 0 : esp_timer_get_time();
+            if (laneDebounce[lane].accept(captureUs)) {
+                motionEvents.push({captureUs, lane, 0});
+            }
+        }
+    }
+    attachLanes();
     pinMode(LED_PIN, OUTPUT); // LED som output
-    attachInterrupt(digitalPinToInterrupt(SENSOR1_PIN), handleMotionSensor1, RISING); // Interrupt for bevægelse
 
-    // Tilslut WiFi eller start AP-mode
-    if (!initWiFi()) {
+    // Tilslut WiFi og sæt uret, eller start AP-mode
+    if (connectNetwork()) {
+        WiFi.setSleep(true); // Modem sleep: radioen sover mellem beacons, forbindelsen holdes
+    } else {
         setupWiFi();
     }
-
-    // Initialiser RTC
-    setupRTC();
-
-    // Konfigurer MQTT
-    mqttClient.setServer(mqttBroker, mqttPort);
-
-    // Check sensorstatus ved opstart
-    if (digitalRead(SENSOR1_PIN) == HIGH) {
-        Serial.println("Sensor aktiv ved opstart.");
-        motionDetected = true; // Indstil bevægelsesflag
+    startWebServer();
+
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+    // Automatisk light sleep når alle opgaver venter, også med WiFi forbundet
+    esp_pm_config_esp32_t pmConfig = {};
+    pmConfig.max_freq_mhz = 240;
+    pmConfig.min_freq_mhz = 80;
+    pmConfig.light_sleep_enable = true;
+    if (esp_pm_configure(&pmConfig) != ESP_OK) {
+        Serial.println("Kunne ikke slå automatisk light sleep til.");
     }
-
-    // Sæt sidste bevægelsestid hvis ikke allerede sat
-    if (lastMotionTime == 0) {
-        lastMotionTime = millis();
+#endif
+
+    // Konfigurer MQTT. Forbindelsen oprettes af publiceringsopgaven uden at blokere
+    espClient.setTimeout(MQTT_CONNECT_TIMEOUT_S);
+    mqttClient.setServer(config.mqttBroker, config.mqttPort);
+    mqttOutbox.onAck(onMqttAck);
+    backlogSender.stopWhen(platesWaiting);
+    if (!backlogSender.configure(config.mqttWindow, config.mqttAckTimeoutMs)) {
+        Serial.println("Kunne ikke forstørre MQTT-bufferen. Samlede beskeder bliver mindre.");
     }
+    randomSeed(esp_random());
+
+    // Inaktivitetstiden regnes fra opstart
+    lastMotionTime = millis();
 
+    supervisorTaskHandle = xTaskGetCurrentTaskHandle();
+    startPipeline();
+
+    recordStage(STAGE_BOOT, 0); // esp_timer starter ved opstart
     Serial.println("Setup færdig.");
 }
 
-// Loop-funktionen kører konstant
+// Loop-funktionen overvåger kun; selve arbejdet sker i pipeline-opgaverne
 void loop() {
     // Håndter AP-mode
     if (triggerAPMode) {
         resetAP();
     }
 
-    // Håndter bevægelsesdetektion
-    if (motionDetected) {
-        motionDetected = false; // Nulstil bevægelsesflag
-        processPlate(); // Processer pladedata
-        lastMotionTime = millis(); // Opdater sidste bevægelsestid
+    // Sæt ESP'en i deep sleep når inaktivitetstiden er gået og pipelinen er tom. Ellers sov
+    // til fristen; en tom pipeline eller en sensor der slipper vækker tidligere
+    uint32_t timeout = inactivityTimeout();
+    uint32_t idleMs = millis() - lastMotionTime;
+    if (idleMs >= timeout && pipelineIdle()) {
+        goToSleep(); // Vender kun tilbage hvis en sensor stadig er aktiv
     }
+    idleWait(idleMs < timeout ? timeout - idleMs : SUPERVISOR_RECHECK_MS);
+}
 
-    // Sæt ESP'en i deep sleep efter inaktivitet
-    if ((millis() - lastMotionTime) > INACTIVITY_TIMEOUT) {
-        goToSleep();
+uint32_t inactivityTimeout() {
+    return idleTimeout.timeoutMs(config.inactivityMs, config.inactivityMinMs, config.inactivityMaxMs);
+}
+
+// Pipelinen er tom, og backloggen og bevægelserne fra korte opvågninger er sendt (eller kan
+// ikke sendes uden forbindelse)
+bool pipelineIdle() {
+    if (eventsInFlight != 0 || motionEvents.size() != 0 ||
+        (WiFi.status() == WL_CONNECTED && rtcEvents.pending() > 0 && !bufferedWaiting())) {
+        return false;
+    }
+    if (!mqttConnection.connected()) {
+        return true;
     }
+    xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+    uint32_t backlog = offlineLog.size();
+    xSemaphoreGive(offlineLogMutex);
+    return backlog == 0;
+}
+
+// Vent højst ms på at noget vækker loop(). Med WiFi forbundet holdes forbindelsen i modem
+// sleep (med PM slået til går chippen selv i light sleep mellem beacons). Uden WiFi og med en
+// tom pipeline går hele chippen i light sleep, vækket af en sensor eller timeren
+void idleWait(uint32_t ms) {
+    bool idle = pipelineIdle();
+    bool connected = WiFi.status() == WL_CONNECTED;
+    if (idle && !connected && !apActive && !anyLaneActive()) {
+        lightSleep(ms);
+        return;
+    }
+    setPowerState(idle && connected ? POWER_MODEM_SLEEP : POWER_ACTIVE);
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+    setPowerState(POWER_ACTIVE);
+}
 
-    // Håndter MQTT-forbindelse
-    if (mqttNotActive && (millis() - lastMQTTRetryTime) > 60000) {
-        Serial.println("MQTT er ikke aktiv. Forsøger igen...");
-        reconnectMQTT();
-        handleMQTTConnectionStatus();
-    } else if (!mqttClient.connected()) {
-        reconnectMQTT();
-        handleMQTTConnectionStatus();
+// Light sleep med sensorerne (HIGH) og en timer som vækkekilder. Kanttriggede interrupts
+// virker ikke under søvnen, så de kobles fra imens, og en sensor der vækkede os registreres
+// bagefter som en bevægelse på samme måde som i interrupt-handleren
+void lightSleep(uint32_t ms) {
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        detachInterrupt(digitalPinToInterrupt(laneConfig[lane].pin));
+        gpio_wakeup_enable((gpio_num_t)laneConfig[lane].pin, GPIO_INTR_HIGH_LEVEL);
     }
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+    Serial.flush(); // UART'en står stille under søvnen
+
+    setPowerState(POWER_LIGHT_SLEEP);
+    esp_light_sleep_start();
+    setPowerState(POWER_ACTIVE);
+
+    // Vækkekilderne må ikke følge med i deep sleep
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        gpio_wakeup_disable((gpio_num_t)laneConfig[lane].pin);
+    }
+    pollLanes(); // Før interrupts kobles til igen, så køen stadig kun har én producent ad gangen
+    attachLanes();
+}
+
+// Interrupt på begge flanker: stigende er en bevægelse, og begge opdaterer LED'en
+void attachLanes() {
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        attachInterruptArg(digitalPinToInterrupt(laneConfig[lane].pin), handleLaneMotion, (void *)(uintptr_t)lane,
+                           CHANGE);
+    }
+}
+
+// Registrer aktive sensorer som bevægelser, når interrupt-handlerne ikke kunne se flanken.
+// Kører i en opgave, så opsamlingsopgaven vækkes uden FromISR-kaldene
+void pollLanes() {
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        queueLaneMotion(lane);
+    }
+    if (captureTaskHandle) {
+        xTaskNotifyGive(captureTaskHandle);
+    }
+}
 
-    // Tænd/sluk LED baseret på sensorstatus
-    int sensorValue = digitalRead(SENSOR1_PIN);
-    digitalWrite(LED_PIN, sensorValue ? LOW : HIGH);
+// Læg tiden siden sidste skift til den nuværende strømtilstand; kaldes med telemetryMutex
+static void accountPower(int64_t nowUs) {
+    telemetry.power(powerState, nowUs - powerSinceUs);
+    powerSinceUs = nowUs;
+}
 
-    delay(100);
+void setPowerState(PowerState state) {
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    accountPower(esp_timer_get_time());
+    powerState = state;
+    xSemaphoreGive(telemetryMutex);
+}
+
+// Start opgaverne; opsamlingen får højest prioritet så LED og interrupt-kø altid passes
+void startPipeline() {
+    xTaskCreatePinnedToCore(captureTask, "capture", 3072, nullptr, 3, &captureTaskHandle, CAPTURE_CORE);
+    for (int i = 0; i < SCANNER_TASKS; i++) {
+        xTaskCreatePinnedToCore(scannerTask, "scanner", 6144, scanQueues[i], 2, nullptr, NETWORK_CORE);
+    }
+    xTaskCreatePinnedToCore(publishTask, "publish", 6144, nullptr, 2, nullptr, NETWORK_CORE);
+}
+
+// Opsamling: flyt bevægelser fra interrupt-køen til scannerkøen og opdater LED'en
+void captureTask(void *parameter) {
+    MotionEvent events[MOTION_QUEUE_SIZE];
+    bool laneActive = false;
+    for (;;) {
+        // Vågn ved interrupt på begge flanker. Venter der bevægelser på plads i scannerkøen
+        // eller bevægelser fra korte opvågninger, prøv igen snart; ellers ventes uden timeout
+        TickType_t wait = portMAX_DELAY;
+        if (motionEvents.size() > 0) {
+            wait = pdMS_TO_TICKS(10);
+        } else if (rtcEvents.pending() > 0) {
+            wait = pdMS_TO_TICKS(bufferedWaiting() ? UPLOAD_RETRY_S * 1000UL : BUFFERED_RETRY_MS);
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        // Bevægelser fra korte opvågninger er ældst og skal først til scanneren. Interrupt-køen
+        // tømmes altid; hvad scannerkøen ikke kan rumme, gemmes bag dem på LittleFS og hentes
+        // herfra igen, så modtryk fra scanneren ikke koster bevægelser
+        // Banerne kendes først når bevægelserne er taget, så den mindste plads gælder for alle
+        uint32_t max = MOTION_QUEUE_SIZE;
+        for (int i = 0; i < SCANNER_TASKS; i++) {
+            uint32_t space = uxQueueSpacesAvailable(scanQueues[i]);
+            max = space < max ? space : max;
+        }
+        uint32_t buffered = takeBufferedEvents(events, max);
+        for (uint32_t i = 0; i < buffered; i++) {
+            eventsInFlight++;
+            xQueueSend(scanQueues[events[i].lane % SCANNER_TASKS], &events[i], 0);
+        }
+        uint32_t count = motionEvents.popBatch(events, MOTION_QUEUE_SIZE);
+        uint32_t spilled = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (i < max - buffered) {
+                eventsInFlight++;
+                xQueueSend(scanQueues[events[i].lane % SCANNER_TASKS], &events[i], 0);
+                recordStage(STAGE_WAKE, events[i].captureUs);
+            } else if (spillEvent(wallClockUs() - (esp_timer_get_time() - events[i].captureUs), events[i].lane)) {
+                spilled++;
+            } else {
+                Serial.println("Kunne ikke gemme bevægelsen.");
+            }
+        }
+        if (spilled > 0) {
+            rtcEvents.seal();
+            Serial.printf("Scannerkøen er fuld. %u bevægelser gemt lokalt.\n", (unsigned)spilled);
+        }
+        if (count > 0) {
+            idleTimeout.motion(wallClockUs()); // Kun nye bevægelser siger noget om trafikken nu
+        }
+        if (count + buffered > 0) {
+            lastMotionTime = millis(); // Opdater sidste bevægelsestid
+        }
+
+        uint32_t overflows = motionEvents.overflows();
+        if (overflows != reportedOverflows) {
+            Serial.printf("%u bevægelser tabt fordi køen var fuld.\n", (unsigned)(overflows - reportedOverflows));
+            reportedOverflows = overflows;
+        }
+
+        // Tænd/sluk LED baseret på sensorstatus på alle baner. Når den sidste sensor slipper,
+        // kan loop() have ventet med deep sleep på det
+        bool active = anyLaneActive();
+        digitalWrite(LED_PIN, active ? LOW : HIGH);
+        if (laneActive && !active) {
+            xTaskNotifyGive(supervisorTaskHandle);
+        }
+        laneActive = active;
+    }
+}
+
+// Scanner: hent pladerne for de ventende bevægelser på opgavens baner og giv dem videre til
+// publicering. parameter er opgavens kø i scanQueues
+void scannerTask(void *parameter) {
+    QueueHandle_t scanQueue = (QueueHandle_t)parameter;
+    ScannerClient scanner(config.scannerHost, config.scannerPort); // Egen keep-alive-forbindelse pr. opgave
+    scanner.setTimeout(SCANNER_TIMEOUT_MS);
+    MotionEvent events[SCAN_BATCH_SIZE];
+    PlateReading readings[SCAN_BATCH_SIZE];
+    for (;;) {
+        if (xQueueReceive(scanQueue, &events[0], portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        // Venter flere biler, hentes de med én forespørgsel pr. bane
+        uint32_t count = 1;
+        while (count < SCAN_BATCH_SIZE && xQueueReceive(scanQueue, &events[count], 0) == pdTRUE) {
+            count++;
+        }
+        if (rtcEvents.pending() > 0) {
+            xTaskNotifyGive(captureTaskHandle); // Der er plads i scannerkøen til de gemte bevægelser
+        }
+        // Stabil sortering efter bane (højst SCAN_BATCH_SIZE), så rækkefølgen inden for en bane bevares
+        for (uint32_t i = 1; i < count; i++) {
+            MotionEvent event = events[i];
+            uint32_t j = i;
+            for (; j > 0 && events[j - 1].lane > event.lane; j--) {
+                events[j] = events[j - 1];
+            }
+            events[j] = event;
+        }
+
+        ScanOutcome outcomes[SCAN_BATCH_SIZE];
+        scanPlates(scanner, events, count, readings, outcomes);
+        uint32_t handedOff = 0;
+        const PlateReading *reading = readings;
+        for (uint32_t i = 0; i < count; i++) {
+            if (outcomes[i] != SCAN_PLATE) {
+                reportBufferedScan(events[i], outcomes[i]);
+                continue;
+            }
+            if (xQueueSend(publishQueue, reading, 0) == pdTRUE) {
+                handedOff++; // Publiceringsopgaven tæller den færdig
+            } else {
+                // Publiceringen kan ikke følge med: gem direkte i offline-loggen
+                uint8_t payload[OfflineLog::PAYLOAD_SIZE];
+                if (storeOffline(payload, encodePayload(PAYLOAD_FORMAT, *reading, payload, sizeof(payload)))) {
+                    Serial.println("Publiceringskøen er fuld. Data gemt lokalt.");
+                } else {
+                    outcomes[i] = SCAN_FAILED;
+                }
+            }
+            reportBufferedScan(events[i], outcomes[i]);
+            reading++;
+        }
+        eventsInFlight -= count - handedOff;
+    }
+}
+
+// Publicering: hold MQTT-forbindelsen, læg nye plader i udbakken og send fra den
+void publishTask(void *parameter) {
+    PlateReading reading;
+    bool wasIdle = false;
+    for (;;) {
+        checkNtpSync(); // Færdiggør en NTP-synkronisering startet af setupRTC()
+
+        // Højst ét forbindelsesforsøg pr. gennemløb; imens ligger alt i offline-loggen.
+        // Venter der kvitteringer, kigges der ofte efter dem. Uden noget at sende ventes
+        // længe, da nye plader i køen vækker opgaven med det samme
+        bool ready = serviceMqtt() && backlogSender.ready();
+        bool idle = pipelineIdle();
+        TickType_t wait = pdMS_TO_TICKS(idle && !ntpPending ? PUBLISH_IDLE_MS : 50);
+        if (ready) {
+            wait = 0;
+        } else if (mqttOutbox.inFlight() > 0) {
+            wait = pdMS_TO_TICKS(2);
+        }
+        if (idle && !wasIdle) {
+            xTaskNotifyGive(supervisorTaskHandle); // loop() kan have ventet med deep sleep på det
+        }
+        wasIdle = idle;
+        if (xQueueReceive(publishQueue, &reading, wait) == pdTRUE) {
+            processPlate(reading);
+            eventsInFlight--;
+        } else if (ready) {
+            sendSavedData(); // Send samlet inden for vinduet, i bidder af højst DRAIN_BUDGET_MS
+        }
+    }
+}
+
+// Vægur-tid i mikrosekunder siden epoch
+int64_t wallClockUs() {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    return (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
 }
 
 void setupRTC() {
-    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+    // Samme TZ-streng som configTime() bygger for hele timer og 1 times sommertid
+    char tz[16];
+    snprintf(tz, sizeof(tz), "UTC%ldDST", -gmtOffset_sec / 3600);
+    setenv("TZ", tz, 1);
+    tzset();
+
+    // Efter deep sleep er uret kørt videre på RTC-uret; læg den målte drift på og
+    // synkroniser kun i baggrunden når NTP_RESYNC_INTERVAL_S er gået
+    int64_t now = wallClockUs();
+    if (wakeCache.clockSynced() && now > wakeCache.ntpSyncUs) {
+        int64_t correction = wakeCache.driftCorrectionUs(now);
+        if (correction != 0) {
+            struct timeval corrected = {(time_t)((now + correction) / 1000000LL),
+                                        (suseconds_t)((now + correction) % 1000000LL)};
+            settimeofday(&corrected, nullptr);
+        }
+        wakeCache.correctedUs = now + correction;
+        wakeCache.seal();
+        Serial.printf("Ur gendannet fra RTC (driftkorrektion %lld us).\n", (long long)correction);
+        if (wakeCache.ntpDue(now, NTP_RESYNC_INTERVAL_S * uS_TO_S_FACTOR)) {
+            startNtpSync();
+        }
+        return;
+    }
+
+    // Kold start: uret er ukendt, så vent på NTP som før
+    startNtpSync();
+    unsigned long start = millis();
+    while (!checkNtpSync() && millis() - start < NTP_TIMEOUT_MS) {
+        delay(10);
+    }
 
     struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
+    if (wakeCache.clockSynced() && getLocalTime(&timeinfo, 0)) {
         Serial.println("RTC initialiseret med NTP-tid:");
         Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
     } else {
@@ -169,145 +745,552 @@ void setupRTC() {
     }
 }
 
-// Håndter MQTT-status
-void handleMQTTConnectionStatus() {
-    if (mqttNotActive) {
-        Serial.println("MQTT er ikke aktiv.");
-    } else {
-        Serial.println("MQTT er aktiv.");
-        sendSavedData(); // Send gemt data til MQTT
-        mqttClient.loop(); // Hold MQTT-forbindelse aktiv
+// Start NTP uden at vente; checkNtpSync() registrerer resultatet
+void startNtpSync() {
+    ntpStartWallUs = wallClockUs();
+    ntpStartTimerUs = esp_timer_get_time();
+    ntpPending = true;
+    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+}
+
+// Returnerer true når en igangværende synkronisering er færdig. Forskellen mellem
+// NTP-tiden og hvad uret selv ville have vist bruges til at måle RTC-urets drift
+bool checkNtpSync() {
+    if (!ntpPending || sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED) {
+        return false;
+    }
+    ntpPending = false;
+    recordStage(STAGE_NTP, ntpStartTimerUs);
+    int64_t localUs = ntpStartWallUs + (esp_timer_get_time() - ntpStartTimerUs);
+    int64_t ntpUs = wallClockUs();
+    bool hadSync = wakeCache.clockSynced();
+    wakeCache.recordSync(localUs, ntpUs);
+    wakeCache.seal();
+    if (hadSync) {
+        Serial.printf("NTP synkroniseret (afvigelse %lld ms, drift %ld ppb).\n", (long long)((ntpUs - localUs) / 1000),
+                      (long)wakeCache.driftPpb);
+    }
+    return true;
+}
+
+// Er banens sensor aktiv og uden for debounce-vinduet, lægges bevægelsen i interrupt-køen.
+// Fælles for interrupt-handleren og pollLanes()
+void IRAM_ATTR queueLaneMotion(uint8_t lane) {
+    int64_t now = esp_timer_get_time();
+    if (digitalRead(laneConfig[lane].pin) == HIGH && laneDebounce[lane].accept(now)) {
+        motionEvents.push({now, lane, 0});
+    }
+}
+
+// Interrupt-handler for en banes sensor (arg er banen): ved stigende flanke tidsstempel ind
+// i køen, og ved begge flanker væk opsamlingsopgaven, der styrer LED'en. Hver bane har sin
+// egen debounce, så biler på nabobaner tæller hver for sig
+void IRAM_ATTR handleLaneMotion(void *arg) {
+    queueLaneMotion((uint8_t)(uintptr_t)arg);
+    if (captureTaskHandle) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(captureTaskHandle, &woken);
+        portYIELD_FROM_ISR(woken);
     }
 }
 
-// Interrupt-handler for bevægelsessensor
-void IRAM_ATTR handleMotionSensor1() {
-    unsigned long currentTime = millis();
-    if (currentTime - lastInterruptTime1 > debounceDelay) {
-        lastInterruptTime1 = currentTime;
-        motionDetected = true; // Sæt bevægelsesflag
+bool anyLaneActive() {
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        if (digitalRead(laneConfig[lane].pin) == HIGH) {
+            return true;
+        }
     }
+    return false;
 }
 
-// Processer pladedata
-void processPlate() {
-    Serial.println("Bevægelse registreret. Henter data...");
+// Omregn et esp_timer-tidspunkt til vægur-tid med mikrosekunder (ISO 8601)
+bool formatCaptureTime(int64_t captureUs, char *buffer, size_t size) {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    int64_t wallUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec - (esp_timer_get_time() - captureUs);
+    time_t seconds = wallUs / 1000000LL;
     struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
-        char timeStr[64];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &timeinfo);
-        Serial.printf("Pladen blev registreret på: %s\n", timeStr);
-    } else {
-        Serial.println("Fejl under hentning af tid.");
+    localtime_r(&seconds, &timeinfo);
+    if (timeinfo.tm_year < (2020 - 1900)) {
+        return false; // Uret er ikke sat endnu
     }
+    size_t length = strftime(buffer, size, "%Y-%m-%dT%H:%M:%S", &timeinfo);
+    snprintf(buffer + length, size - length, ".%06ld", (long)(wallUs % 1000000LL));
+    return true;
+}
 
-    String plate, timestamp;
-    if (queryPlateScanner(plate, timestamp)) {
-        Serial.printf("Gyldig plade: %s kl. %s\n", plate.c_str(), timestamp.c_str());
-        sendToMQTT(plate, timestamp); // Send til MQTT
-    } else {
-        Serial.println("Ingen gyldig plade fundet.");
+// Hent pladerne for count bevægelser. Bevægelser på samme bane i træk hentes med én
+// forespørgsel til banens kamera. Scanneren leverer dem i den rækkefølge bilerne kom,
+// så plade nr. i på en bane får tidsstemplet fra bevægelse nr. i på banen. readings
+// fyldes i bevægelsernes rækkefølge for dem hvor outcomes (hvis givet) er SCAN_PLATE
+uint32_t scanPlates(ScannerClient &scanner, const MotionEvent *events, uint32_t count, PlateReading *readings,
+                    ScanOutcome *outcomes) {
+    Serial.printf("%u bevægelse(r) registreret. Henter data...\n", (unsigned)count);
+    uint32_t found = 0;
+    for (uint32_t first = 0; first < count;) {
+        uint8_t lane = events[first].lane;
+        uint32_t run = 1;
+        while (first + run < count && events[first + run].lane == lane) {
+            run++;
+        }
+        int64_t start = esp_timer_get_time();
+        PlateReading *laneReadings = readings + found;
+        uint32_t laneFound = run == 1 ? (scanner.fetch(laneReadings[0], lane) ? 1 : 0)
+                                      : scanner.fetchBatch(laneReadings, run, lane);
+        recordStage(STAGE_SCANNER, start);
+
+        for (uint32_t i = 0; i < laneFound; i++) {
+            const MotionEvent &event = events[first + i];
+            // Brug tidspunktet hvor sensoren trigger; scannerens tid kun hvis uret ikke er sat
+            char captureTime[32];
+            if (formatCaptureTime(event.captureUs, captureTime, sizeof(captureTime))) {
+                memcpy(laneReadings[i].timestamp, captureTime, sizeof(laneReadings[i].timestamp));
+            } else {
+                Serial.println("Fejl under hentning af tid.");
+            }
+            laneReadings[i].captureUs = wallClockUs() - (esp_timer_get_time() - event.captureUs);
+            laneReadings[i].lane = lane;
+            Serial.printf("Gyldig plade: %s kl. %s på bane %u\n", laneReadings[i].plate, laneReadings[i].timestamp,
+                          (unsigned)lane);
+        }
+        if (outcomes) {
+            // Svarede scanneren, havde den bare ikke flere plader; ellers kan de komme ved næste forsøg
+            int status = scanner.lastStatus();
+            ScanOutcome missing = status >= 200 && status < 500 ? SCAN_NO_PLATE : SCAN_FAILED;
+            for (uint32_t i = 0; i < run; i++) {
+                outcomes[first + i] = i < laneFound ? SCAN_PLATE : missing;
+            }
+        }
+        found += laneFound;
+        first += run;
     }
+    if (found < count) {
+        Serial.printf("Ingen gyldig plade fundet for %u bevægelse(r).\n", (unsigned)(count - found));
+    }
+    return found;
 }
 
-// Forespørg pladescanner for data
-bool queryPlateScanner(String &plate, String &timestamp) {
-    const char *serverUrl = "http://192.168.0.185:5000/get_plate"; // Flask-serverens IP
+// Kort opvågning i radiofri tilstand: gem bevægelsen i RTC-ringen (eller på LittleFS når
+// den er fuld) og returner true hvis radioen kan forblive slukket. Uden et sat ur kan
+// bevægelsen ikke dateres, så da køres en fuld opvågning som før
+bool bufferWake(esp_sleep_wakeup_cause_t cause) {
+    if (!rtcEvents.valid()) {
+        rtcEvents.reset();
+    }
+    if ((cause != ESP_SLEEP_WAKEUP_EXT1 && cause != ESP_SLEEP_WAKEUP_TIMER) || triggerAPMode ||
+        !wakeCache.valid() || !wakeCache.clockSynced()) {
+        return false;
+    }
 
-    WiFiClient client;
-    HTTPClient http;
+    int64_t now = wallClockUs();
+    if (cause == ESP_SLEEP_WAKEUP_EXT1) {
+        int64_t captureUs = now - esp_timer_get_time(); // En sensor vækkede os: bevægelsen skete ved opstart
+        uint64_t wakePins = esp_sleep_get_ext1_wakeup_status();
+        for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+            if (!(wakePins & (1ULL << laneConfig[lane].pin))) {
+                continue;
+            }
+            if (!rtcEvents.push(captureUs, lane) && !spillEvent(captureUs, lane)) {
+                Serial.println("Kunne ikke gemme bevægelsen.");
+            }
+        }
+        rtcEvents.seal();
+        wakeBuffered = true;
+    }
 
-    if (http.begin(client, serverUrl)) {
-        int httpCode = http.GET();
+    if (rtcEvents.uploadDue(now, UPLOAD_MIN_EVENTS, UPLOAD_MAX_AGE_S * uS_TO_S_FACTOR, UPLOAD_FILL_PERCENT,
+                            UPLOAD_RETRY_S * uS_TO_S_FACTOR)) {
+        // Forsøget gemmes; lykkes det ikke at aflevere alt, venter næste forsøg UPLOAD_RETRY_S
+        rtcEvents.lastUploadUs = now;
+        rtcEvents.seal();
+        Serial.printf("%u bevægelser venter. Starter radio.\n", (unsigned)rtcEvents.pending());
+        return false;
+    }
+    Serial.printf("Bevægelse gemt i RTC (%u venter).\n", (unsigned)rtcEvents.pending());
+    return true;
+}
 
-        if (httpCode == HTTP_CODE_OK) { // Tjek om HTTP-status er OK
-            String payload = http.getString();
-            Serial.println("Svar fra server: " + payload);
+// Gem en bevægelse (vægur-tid) på LittleFS bag RTC-ringen: tid (8 bytes) efterfulgt af banen
+// og antal scanninger uden plade. Kalderen sealer rtcEvents
+bool spillEvent(int64_t captureUs, uint8_t lane, uint8_t attempts) {
+    uint8_t record[sizeof(captureUs) + 2];
+    memcpy(record, &captureUs, sizeof(captureUs));
+    record[sizeof(captureUs)] = lane;
+    record[sizeof(captureUs) + 1] = attempts;
+    if (!pendingEvents.isOpen() && !(initLittleFS() && pendingEvents.begin(LittleFS, pendingDir))) {
+        return false;
+    }
+    if (!pendingEvents.append(record, sizeof(record))) {
+        return false;
+    }
+    rtcEvents.spill(captureUs);
+    return true;
+}
 
-            int commaIndex = payload.indexOf(',');
-            if (commaIndex != -1) {
-                plate = payload.substring(0, commaIndex);
-                timestamp = payload.substring(commaIndex + 1);
-                http.end();
-                return true;
-            } else {
-                Serial.println("Modtaget format er ugyldigt.");
+// Flyt bevægelser fra korte opvågninger (og fra en fuld scannerkø) videre til scanneren, ældste
+// først. Kun med WiFi og én samling ad gangen: næste samling tages først når scanneropgaverne
+// har meldt tilbage for alle i den forrige. Vægur-tiden omregnes til esp_timer (negativ for
+// bevægelser fra før opstart), så scanPlates dater dem som alle andre
+uint32_t takeBufferedEvents(MotionEvent *events, uint32_t max) {
+    ScanResult result;
+    while (xQueueReceive(scanResults, &result, 0) == pdTRUE) {
+        if (result.slot < bufferedTaken && !bufferedScans[result.slot].done) {
+            bufferedScans[result.slot].done = true;
+            bufferedScans[result.slot].outcome = result.outcome;
+            bufferedOpen--;
+        }
+    }
+    if (bufferedTaken > 0) {
+        if (bufferedOpen > 0) {
+            return 0;
+        }
+        resolveBufferedEvents();
+    }
+    if (rtcEvents.pending() == 0 || WiFi.status() != WL_CONNECTED || bufferedWaiting()) {
+        return 0;
+    }
+
+    if (max > MOTION_QUEUE_SIZE) {
+        max = MOTION_QUEUE_SIZE;
+    }
+    uint32_t count = 0;
+    for (; count < max && count < rtcEvents.count; count++) {
+        BufferedScan &scan = bufferedScans[count];
+        rtcEvents.peek(count, scan.captureUs, scan.lane, scan.attempts);
+    }
+    bufferedFromRing = count;
+
+    // Derefter LittleFS. Uden banebyte (gemt før der var flere baner) er det bane 0. En ødelagt
+    // post springes over og fjernes sammen med samlingen
+    bufferedLogEnd = pendingEvents.oldestSeq();
+    if (rtcEvents.spilled > 0 && (pendingEvents.isOpen() || (initLittleFS() && pendingEvents.begin(LittleFS, pendingDir)))) {
+        uint8_t record[OfflineLog::PAYLOAD_SIZE];
+        size_t length;
+        int64_t us;
+        for (; count < max && bufferedLogEnd < pendingEvents.nextSeq(); bufferedLogEnd++) {
+            if (!pendingEvents.read(bufferedLogEnd, record, sizeof(record), length) || length < sizeof(us) ||
+                length > sizeof(us) + 2) {
+                continue;
             }
+            BufferedScan &scan = bufferedScans[count++];
+            memcpy(&us, record, sizeof(us));
+            scan.captureUs = us;
+            scan.lane = length > sizeof(us) ? record[sizeof(us)] : 0;
+            scan.attempts = length > sizeof(us) + 1 ? record[sizeof(us) + 1] : 0;
+        }
+    } else if (rtcEvents.spilled > 0) {
+        Serial.println("Gemte bevægelser på LittleFS kunne ikke læses.");
+        rtcEvents.spilled = 0;
+        rtcEvents.seal();
+    }
+
+    int64_t offsetUs = esp_timer_get_time() - wallClockUs();
+    for (uint32_t i = 0; i < count; i++) {
+        bufferedScans[i].done = false;
+        events[i] = {bufferedScans[i].captureUs + offsetUs, bufferedScans[i].lane, (uint8_t)(i + 1)};
+    }
+    bufferedTaken = count;
+    bufferedOpen = count;
+    if (count == 0) {
+        resolveBufferedEvents(); // Kun ødelagte poster
+    }
+    return count;
+}
+
+// Scanneropgaven melder tilbage for en gemt bevægelse; nye bevægelser har ingen plads
+void reportBufferedScan(const MotionEvent &event, ScanOutcome outcome) {
+    if (event.bufferedSlot == 0) {
+        return;
+    }
+    ScanResult result = {(uint8_t)(event.bufferedSlot - 1), outcome};
+    xQueueSend(scanResults, &result, 0); // Plads til alle, da der kun er én samling ad gangen
+    if (captureTaskHandle) {
+        xTaskNotifyGive(captureTaskHandle);
+    }
+}
+
+// Alle i samlingen har svar: fjern dem der er afleveret, og gem resten igen bag de ventende.
+// De gemmes igen før de gamle fjernes, så en genstart midt i højst giver en ekstra scanning.
+// Mangler der plader, venter de til næste upload; en bevægelse scanneren svarer på uden
+// plade UPLOAD_SCAN_ATTEMPTS gange, opgives
+void resolveBufferedEvents() {
+    uint32_t kept = 0;
+    uint32_t abandoned = 0;
+    for (uint32_t i = 0; i < bufferedTaken; i++) {
+        const BufferedScan &scan = bufferedScans[i];
+        if (scan.outcome == SCAN_PLATE) {
+            continue;
+        }
+        uint8_t attempts = scan.attempts + (scan.outcome == SCAN_NO_PLATE ? 1 : 0);
+        if (attempts >= UPLOAD_SCAN_ATTEMPTS) {
+            abandoned++;
+        } else if (rtcEvents.push(scan.captureUs, scan.lane, attempts) || spillEvent(scan.captureUs, scan.lane, attempts)) {
+            kept++;
         } else {
-            Serial.printf("HTTP GET fejlede med fejl: %d\n", httpCode);
+            Serial.println("Kunne ikke gemme bevægelsen.");
         }
+    }
+    rtcEvents.seal();
 
-        http.end();
-    } else {
-        Serial.println("Kunne ikke forbinde til server.");
+    rtcEvents.drop(bufferedFromRing);
+    if (pendingEvents.isOpen()) {
+        if (bufferedLogEnd > pendingEvents.oldestSeq()) {
+            pendingEvents.popUntil(bufferedLogEnd);
+            pendingEvents.commit();
+        }
+        rtcEvents.spilled = pendingEvents.size();
     }
+    if (kept > 0) {
+        bufferedFailedAt = millis();
+        bufferedFailed = true;
+        rtcEvents.lastUploadUs = wallClockUs();
+        Serial.printf("%u gemte bevægelser ikke afleveret. Prøver igen ved næste upload.\n", (unsigned)kept);
+    } else if (rtcEvents.pending() == 0) {
+        rtcEvents.lastUploadUs = 0; // Alt er afleveret; næste upload behøver ikke vente
+    }
+    if (abandoned > 0) {
+        Serial.printf("Ingen plade for %u gemte bevægelser efter %u forsøg. De er opgivet.\n", (unsigned)abandoned,
+                      (unsigned)UPLOAD_SCAN_ATTEMPTS);
+    }
+    rtcEvents.seal();
+    bufferedTaken = 0;
+    bufferedFromRing = 0;
+    bufferedOpen = 0;
+}
 
-    return false;
+// Fik en upload i denne opvågning ikke alt afleveret, venter resten UPLOAD_RETRY_S
+bool bufferedWaiting() {
+    return bufferedFailed && millis() - bufferedFailedAt < UPLOAD_RETRY_S * 1000UL;
 }
 
-// Send data til MQTT
-void sendToMQTT(const String &plate, const String &timestamp) {
-    String message = "{\"plate\":\"" + plate + "\",\"timestamp\":\"" + timestamp + "\"}";
+// Registrer varigheden fra startUs (esp_timer) til nu for et trin
+void recordStage(TelemetryStage stage, int64_t startUs) {
+    int64_t elapsed = esp_timer_get_time() - startUs;
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    telemetry.record(stage, elapsed);
+    xSemaphoreGive(telemetryMutex);
+}
+
+// Læg tællerne fra denne opstart til telemetrien og mål backloggen. Er offline-loggen ikke
+// åbnet, gælder tallet fra sidste deep sleep ligesom i collectStatus()
+void collectTelemetry() {
+    uint32_t overflows = motionEvents.overflows();
+    uint32_t suppressed = 0;
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        suppressed += laneDebounce[lane].suppressed;
+    }
+    uint32_t attempts = mqttConnection.attempts();
+    xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+    uint32_t logDropped = offlineLog.dropped();
+    uint32_t depth = offlineLog.isOpen() ? offlineLog.size() : wakeCache.backlogRecords;
+    xSemaphoreGive(offlineLogMutex);
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    accountPower(esp_timer_get_time());
+    telemetry.idleTimeoutMs = inactivityTimeout();
+    telemetry.droppedEvents += overflows - seenOverflows;
+    telemetry.debouncedEvents += suppressed - seenSuppressed;
+    telemetry.mqttAttempts += attempts - seenAttempts;
+    telemetry.backlogDropped += logDropped - seenLogDropped;
+    if (depth != WakeCache::BACKLOG_UNKNOWN) {
+        telemetry.backlog(depth);
+    }
+    xSemaphoreGive(telemetryMutex);
+    seenOverflows = overflows;
+    seenSuppressed = suppressed;
+    seenAttempts = attempts;
+    seenLogDropped = logDropped;
+}
+
+// Send målingerne på telemetryTopic når TELEMETRY_INTERVAL_S er gået og start en ny periode.
+// Kræver et sat ur. Beskeden kan være større end PubSubClients buffer og skrives derfor direkte
+bool publishTelemetry() {
+    if (!wakeCache.clockSynced()) {
+        return false;
+    }
+    int64_t now = wallClockUs();
+    if (telemetry.periodStartUs == 0) {
+        telemetry.periodStartUs = now; // Første periode starter når uret er sat
+    }
+    if (now - telemetry.periodStartUs < (int64_t)TELEMETRY_INTERVAL_S * (int64_t)uS_TO_S_FACTOR) {
+        return false;
+    }
+
+    collectTelemetry();
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    size_t length = telemetry.encodeJson(mqtt_client_id, now, wakeCache.wakeToPublishMs, telemetryBuffer,
+                                         sizeof(telemetryBuffer));
+    if (length == 0) {
+        // Kan ikke ske med JSON_MAX; ellers ville hvert gennemløb prøve igen med en voksende periode
+        telemetry.reset(now);
+        xSemaphoreGive(telemetryMutex);
+        Serial.println("Kunne ikke kode telemetri. Starter en ny periode.");
+        return false;
+    }
+    xSemaphoreGive(telemetryMutex);
+    if (!mqttClient.beginPublish(telemetryTopic, length, false) ||
+        mqttClient.write((const uint8_t *)telemetryBuffer, length) != length || !mqttClient.endPublish()) {
+        Serial.println("Kunne ikke sende telemetri.");
+        return false;
+    }
 
+    // Låsen holdes ikke under publish, så målinger i det korte stykke derimellem går tabt
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    telemetry.reset(now);
+    xSemaphoreGive(telemetryMutex);
+    Serial.printf("Telemetri sendt (%u bytes).\n", (unsigned)length);
+    return true;
+}
 
-    if (mqttClient.publish(mqttTopic, message.c_str())) {
-        Serial.println("Data sendt til MQTT: " + message);
+// Gem en kodet besked i offline-loggen; låsen er nødvendig fordi flere opgaver skriver
+bool storeOffline(const uint8_t *payload, size_t length) {
+    if (length == 0) {
+        Serial.println("Beskeden kunne ikke kodes.");
+        return false;
+    }
+    xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+    bool stored = openBacklog() && offlineLog.append(payload, length);
+    xSemaphoreGive(offlineLogMutex);
+    return stored;
+}
+
+// En plade fra scanneren: første gang sendes den som altid, men ses den igen inden for
+// config.recentPlateTtlS (bilen holder i kø og udløser sensoren igen), sendes kun en tælling
+void processPlate(const PlateReading &reading) {
+    int64_t seenUs = reading.captureUs != 0 ? reading.captureUs : wallClockUs();
+    uint16_t repeats = recentPlates.seen(reading.plate, seenUs, config.recentPlateTtlS * uS_TO_S_FACTOR);
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    telemetry.plates++;
+    if (repeats > 0) {
+        telemetry.repeatedPlates++;
     } else {
-        Serial.println("Fejl ved at sende data til MQTT.");
+        recentEvents.add(reading);
+    }
+    xSemaphoreGive(telemetryMutex);
+    if (repeats == 0) {
+        sendToMQTT(reading);
+        return;
+    }
 
-        if (mqttNotActive) {
-            String messageWithNewline = message + "\n";
-            appendFile(LittleFS, dataPath, messageWithNewline.c_str());
-            Serial.println("MQTT er ikke aktiv. Data gemt lokalt.");
-            return;
-        }
+    // Tabes tællingen uden forbindelse, er pladen stadig registreret fra første gang
+    char message[96];
+    size_t length = encodePresenceJson(reading, repeats, message, sizeof(message));
+    if (length > 0 && mqttClient.connected() && mqttClient.publish(presenceTopic, (const uint8_t *)message, length)) {
+        Serial.printf("Plade %s stadig til stede (%u gange).\n", reading.plate, (unsigned)repeats);
+    } else {
+        Serial.printf("Plade %s stadig til stede (%u gange); tælling ikke sendt.\n", reading.plate, (unsigned)repeats);
     }
 }
 
-// Genopret MQTT-forbindelse
-void reconnectMQTT() {
-    int retries = 0;
-    lastMQTTRetryTime = millis();
+// Send data til MQTT: beskeden gemmes altid først i offline-loggen, som publiceringsopgaven
+// sender fra med QoS 1, så intet går tabt mellem TCP-skrivningen og brokeren.
+// Beskeden kodes i en buffer på stakken, så der ikke allokeres noget pr. plade
+void sendToMQTT(const PlateReading &reading) {
+    uint8_t payload[OfflineLog::PAYLOAD_SIZE];
+    size_t length = encodePayload(PAYLOAD_FORMAT, reading, payload, sizeof(payload));
+    storeOffline(payload, length);
+    if (length == 0) {
+        return;
+    }
+    if (mqttConnection.connected()) {
+        Serial.printf("Data sat i kø til MQTT: %s kl. %s (%u bytes)\n", reading.plate, reading.timestamp,
+                      (unsigned)length);
+    } else {
+        Serial.println("MQTT er ikke aktiv. Data gemt lokalt.");
+    }
+}
 
-    while (!mqttClient.connected()) {
-        Serial.print("Forbinder til MQTT-broker...");
-        if (mqttClient.connect(mqtt_client_id)) {
-            Serial.println("Forbundet til MQTT!");
-            mqttNotActive = false;
-            return; 
-        } else {
-            Serial.print("Fejl under forbindelse til MQTT-broker\nFejl (kode: ");
-            Serial.print(mqttClient.state());
-            Serial.println("). Forsøger igen om 5 sekunder...");
-            retries++;
-            if (retries > 3) {
-                mqttNotActive = true;
-                Serial.println("MQTT-tilslutning fejlede. Forsøg opgivet.");
-                break;
-            }
-            delay(5000);
-        }
+// PUBACK fra brokeren: publiceringen måles fra afsendelse til kvittering
+void onMqttAck(uint32_t latencyUs) {
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    telemetry.record(STAGE_PUBLISH, latencyUs);
+    xSemaphoreGive(telemetryMutex);
+    if (!firstPublishDone) {
+        // Tid fra opvågning (esp_timer starter ved boot) til den første kvitterede besked
+        firstPublishDone = true;
+        wakeCache.wakeToPublishMs = (uint32_t)(esp_timer_get_time() / 1000);
+        wakeCache.seal();
+        Serial.printf("Første publicering %u ms efter opvågning.\n", (unsigned)wakeCache.wakeToPublishMs);
     }
 }
 
-// Initialiser LittleFS
-void initLittleFS() {
+// Initialiser LittleFS første gang noget skal bruge det; en opvågning fra deep sleep klarer
+// sig ofte uden
+bool initLittleFS() {
+    static bool mounted = false;
+    if (mounted) {
+        return true;
+    }
     if (!LittleFS.begin(true)) {
         Serial.println("Kunne ikke montere LittleFS");
-        return;
+        return false;
     }
     Serial.println("LittleFS monteret succesfuldt.");
+    mounted = true;
+    return true;
+}
+
+// Læs /config.bin. Findes den ikke (første opstart eller ny firmware), bruges
+// standardværdierne med WiFi-oplysninger og data fra de gamle tekstfiler, og posten gemmes
+void loadConfig() {
+    if (initLittleFS() && config.load(LittleFS, configPath)) {
+        Serial.println("Indstillinger indlæst.");
+        return;
+    }
+    Serial.println("Ingen gyldige indstillinger. Bruger standardværdier.");
+    defaultConfig();
+    if (!initLittleFS()) {
+        return;
+    }
+    if (LittleFS.exists(ssidPath)) {
+        snprintf(config.ssid, sizeof(config.ssid), "%s", readFile(LittleFS, ssidPath).c_str());
+        snprintf(config.pass, sizeof(config.pass), "%s", readFile(LittleFS, passPath).c_str());
+    }
+    if (saveConfig()) {
+        LittleFS.remove(ssidPath);
+        LittleFS.remove(passPath);
+    }
+    migrateSavedData();
+}
 
-    // Opret standardfiler hvis de ikke findes
-    if (!LittleFS.exists(ssidPath)) {
-        writeFile(LittleFS, ssidPath, "");
+void defaultConfig() {
+    config.reset();
+    snprintf(config.scannerHost, sizeof(config.scannerHost), "%s", scannerHost);
+    config.scannerPort = scannerPort;
+    snprintf(config.mqttBroker, sizeof(config.mqttBroker), "%s", mqttBroker);
+    config.mqttPort = mqttPort;
+    for (uint8_t lane = 0; lane < DeviceConfig::MAX_LANES; lane++) {
+        config.debounceMs[lane] = lane < sizeof(laneConfig) / sizeof(laneConfig[0]) ? laneConfig[lane].debounceMs
+                                                                                     : DEBOUNCE_DELAY_MS;
+    }
+    config.inactivityMs = INACTIVITY_TIMEOUT;
+    config.inactivityMinMs = INACTIVITY_MIN_MS;
+    config.inactivityMaxMs = INACTIVITY_MAX_MS;
+    config.mqttWindow = MQTT_WINDOW;
+    config.mqttAckTimeoutMs = MQTT_ACK_TIMEOUT_MS;
+    config.recentPlateTtlS = RECENT_PLATE_TTL_S;
+    config.seal();
+}
+
+// Gem indstillingerne på LittleFS; RTC-kopien er opdateret med det samme
+bool saveConfig() {
+    config.seal();
+    if (!initLittleFS() || !config.save(LittleFS, configPath)) {
+        Serial.println("Kunne ikke gemme indstillinger.");
+        return false;
     }
-    if (!LittleFS.exists(passPath)) {
-        writeFile(LittleFS, passPath, "");
+    return true;
+}
+
+// Åbn offline-loggen første gang der skal gemmes eller sendes; gendannelsen læser alle
+// segmenter, så det undgås ved opvågninger uden backlog. Kaldes med offlineLogMutex
+bool openBacklog() {
+    if (offlineLog.isOpen()) {
+        return true;
     }
-    if (!LittleFS.exists(dataPath)) {
-        writeFile(LittleFS, dataPath, "");
+    if (!initLittleFS()) {
+        return false;
     }
+    return offlineLog.begin(LittleFS);
 }
 
 // Læs fil fra LittleFS
@@ -323,126 +1306,223 @@ String readFile(fs::FS &fs, const char *path) {
     return content;
 }
 
-// Skriv til fil i LittleFS
-void writeFile(fs::FS &fs, const char *path, const char *message) {
-    Serial.printf("Skriver til fil: %s\n", path);
-    File file = fs.open(path, "w");
+// Flyt linjer fra den gamle /data.txt over i offline-loggen (sker kun én gang)
+void migrateSavedData() {
+    File file = LittleFS.open(dataPath, FILE_READ);
     if (!file) {
-        Serial.println("Kunne ikke åbne fil til skrivning.");
         return;
     }
-    file.print(message);
-    file.close();
-}
 
-// Tilføj til fil i LittleFS
-void appendFile(fs::FS &fs, const char *path, const char *message) {
-    Serial.printf("Tilføjer til fil: %s\n", path);
-    File file = fs.open(path, FILE_APPEND);
-    if (!file) {
-        Serial.println("Kunne ikke åbne fil til tilføjelse.");
-        return;
+    if (file.size() > 0 && openBacklog()) {
+        Serial.println("Flytter gemt data til offline-loggen...");
+        while (file.available()) {
+            String line = file.readStringUntil('\n');
+            line.trim();
+            if (!line.isEmpty()) {
+                offlineLog.append(line.c_str());
+            }
+        }
     }
-    file.print(message);
     file.close();
-    Serial.println("Data tilføjet til fil.");
+    LittleFS.remove(dataPath);
 }
 
 // Initialiser WiFi
+// Forbind WiFi og sæt uret. Med en gyldig RTC-cache springes scanning og NTP over
+bool connectNetwork() {
+    int64_t start = esp_timer_get_time();
+    bool connected = initWiFi();
+    if (connected) {
+        recordStage(STAGE_WIFI, start);
+    }
+    setupRTC();
+    if (connected && !wifiFromCache) {
+        rememberNetwork();
+    }
+    return connected;
+}
+
 bool initWiFi() {
-    if (ssid.isEmpty()) {
+    if (config.ssid[0] == '\0') {
         Serial.println("SSID ikke defineret.");
         return false;
     }
 
-    WiFi.begin(ssid.c_str(), pass.c_str());
+    // Hurtig vej: samme access point og kanal som sidst, så scanningen springes over.
+    // Adressen hentes med DHCP som ellers; en gammel lease genbruges ikke som statisk IP,
+    // da routeren kan have givet den til en anden enhed
+    wifiFromCache = false;
+    if (wakeCache.hasNetwork()) {
+        WiFi.begin(config.ssid, config.pass, wakeCache.channel, wakeCache.bssid);
+        Serial.println("Forbinder til WiFi med gemt forbindelse...");
+        if (waitForWiFi(WIFI_FAST_TIMEOUT_MS)) {
+            wifiFromCache = true;
+            Serial.println("\nForbundet til WiFi.");
+            Serial.println(WiFi.localIP());
+            return true;
+        }
+
+        // Access pointet er skiftet kanal eller findes ikke længere: glem det og scan på normal vis
+        Serial.println("\nGemt forbindelse fejlede.");
+        wakeCache.channel = 0;
+        wakeCache.seal();
+        WiFi.disconnect();
+    }
+
+    WiFi.begin(config.ssid, config.pass);
     Serial.println("Forbinder til WiFi...");
 
-    unsigned long startAttemptTime = millis();
+    if (!waitForWiFi(WIFI_CONNECT_TIMEOUT_MS)) {
+        Serial.println("Kunne ikke oprette forbindelse til WiFi.");
+        return false;
+    }
 
+    Serial.println("\nForbundet til WiFi.");
+    Serial.println(WiFi.localIP());
+    return true;
+}
+
+bool waitForWiFi(unsigned long timeoutMs) {
+    unsigned long startAttemptTime = millis();
+    unsigned long lastDot = startAttemptTime;
     while (WiFi.status() != WL_CONNECTED) {
-        if (millis() - startAttemptTime > 10000) {
-            Serial.println("Kunne ikke oprette forbindelse til WiFi.");
+        if (millis() - startAttemptTime > timeoutMs) {
             return false;
         }
-        delay(500);
-        Serial.print(".");
+        delay(10);
+        if (millis() - lastDot >= 500) {
+            lastDot = millis();
+            Serial.print(".");
+        }
     }
-
-    Serial.println("\nForbundet til WiFi.");
-    Serial.println(WiFi.localIP());
     return true;
 }
 
+// Gem den nye forbindelse i RTC-cachen til næste opvågning
+void rememberNetwork() {
+    memcpy(wakeCache.bssid, WiFi.BSSID(), sizeof(wakeCache.bssid));
+    wakeCache.channel = WiFi.channel();
+    wakeCache.seal();
+}
+
 // Konfigurer AP-mode
 void setupWiFi() {
+    apActive = true;
+    initLittleFS(); // Til opsætningssiden
     WiFi.softAP("ESP-WIFI-MANAGER");
     IPAddress IP = WiFi.softAPIP();
     Serial.print("AP IP-adresse: ");
     Serial.println(IP);
 
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(LittleFS, "/wifimanager.html", "text/html");
-    });
+    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) { wifiManagerPage.serve(LittleFS, request); });
+    server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request) { styleSheet.serve(LittleFS, request); });
 
     server.on("/", HTTP_POST, [](AsyncWebServerRequest *request) {
         int params = request->params();
         for (int i = 0; i < params; i++) {
             AsyncWebParameter *p = request->getParam(i);
             if (p->name() == PARAM_INPUT_1) {
-                ssid = p->value();
-                writeFile(LittleFS, ssidPath, ssid.c_str());
+                wakeCache.reset(); // Nye oplysninger: den gemte forbindelse gælder ikke længere
+                snprintf(config.ssid, sizeof(config.ssid), "%s", p->value().c_str());
             } else if (p->name() == PARAM_INPUT_2) {
-                pass = p->value();
-                writeFile(LittleFS, passPath, pass.c_str());
+                snprintf(config.pass, sizeof(config.pass), "%s", p->value().c_str());
             }
         }
+        saveConfig();
         request->send(200, "text/plain", "Gemte oplysninger. Genstarter...");
         delay(1000);
         ESP.restart();
     });
+}
 
+// Webserveren kører i begge tilstande, så en enhed i drift kan ses på det lokale net.
+// /status findes altid; opsætningssiden registreres kun i AP-mode (setupWiFi)
+void startWebServer() {
+    server.on("/status", HTTP_GET, handleStatus);
     server.begin();
 }
 
-// Send gemt data til MQTT
-void sendSavedData() {
-    Serial.println("Sender gemt data til MQTT...");
-
-    if (WiFi.status() == WL_CONNECTED && mqttClient.connected()) {
-        File file = LittleFS.open(dataPath, FILE_READ);
-
-        if (!file || file.size() == 0) {
-            Serial.println("Ingen gemt data at sende.");
-            return;
-        }
+// Øjebliksbillede til /status. Låsene holdes kun mens tallene kopieres
+void collectStatus(StatusSnapshot &status) {
+    status.uptimeS = (uint32_t)(esp_timer_get_time() / uS_TO_S_FACTOR);
+    status.wifiConnected = WiFi.status() == WL_CONNECTED;
+    status.rssi = status.wifiConnected ? WiFi.RSSI() : 0;
+    status.ip = status.wifiConnected ? (uint32_t)WiFi.localIP() : (uint32_t)WiFi.softAPIP();
+    status.mqttConnected = mqttConnection.connected();
+    status.mqttAttempts = mqttConnection.attempts();
+    status.mqttInFlight = mqttOutbox.inFlight();
+    status.eventsInFlight = eventsInFlight;
+    status.idleTimeoutMs = inactivityTimeout();
+
+    xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+    if (offlineLog.isOpen()) {
+        status.backlogKnown = true;
+        status.backlogRecords = offlineLog.size();
+    } else {
+        status.backlogKnown = wakeCache.backlogRecords != WakeCache::BACKLOG_UNKNOWN;
+        status.backlogRecords = wakeCache.backlogRecords;
+    }
+    status.backlogDropped = offlineLog.dropped();
+    xSemaphoreGive(offlineLogMutex);
+
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    status.powerState = Telemetry::powerStateName(powerState);
+    status.plates = telemetry.plates;
+    status.repeatedPlates = telemetry.repeatedPlates;
+    status.eventCount = recentEvents.copy(status.events);
+    xSemaphoreGive(telemetryMutex);
+}
 
-        String remainingData = "";
+// JSON sendes chunked efterhånden som TCP-vinduet tillader det (se StatusStream); strømmen
+// lever til webserveren har sendt sidste bid og slipper lambdaen
+void handleStatus(AsyncWebServerRequest *request) {
+    std::shared_ptr<StatusStream> stream = std::make_shared<StatusStream>();
+    collectStatus(stream->snapshot);
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "application/json", [stream](uint8_t *buffer, size_t maxLen, size_t) { return stream->fill(buffer, maxLen); });
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
 
-        while (file.available()) {
-            String line = file.readStringUntil('\n');
-            line.trim();
+// Hold forbindelsen ved lige (se BacklogSender::service) og åbn loggen når den kan tømmes
+bool serviceMqtt() {
+    if (!backlogSender.service()) {
+        return false;
+    }
+    if (!offlineLog.isOpen() && wakeCache.backlogRecords != 0) {
+        // Der lå noget ved deep sleep (eller det vides ikke): åbn loggen nu hvor den kan tømmes
+        xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+        openBacklog();
+        xSemaphoreGive(offlineLogMutex);
+    }
+    publishTelemetry(); // Sender kun når TELEMETRY_INTERVAL_S er gået
+    return true;
+}
 
-            if (line.isEmpty()) {
-                continue;
-            }
+// Nye plader i publiceringskøen går forud for den gemte data
+bool platesWaiting() { return uxQueueMessagesWaiting(publishQueue) > 0; }
 
-            if (mqttClient.publish(mqttTopic, line.c_str())) {
-                Serial.println("Data sendt til MQTT: " + line);
-            } else {
-                Serial.println("Fejl ved at sende data til MQTT. Gemmer til senere.");
-                remainingData += line + "\n";
-            }
+// Send usendte poster fra offline-loggen med QoS 1, højst DRAIN_BUDGET_MS ad gangen
+void sendSavedData() {
+    if (WiFi.status() == WL_CONNECTED && mqttClient.connected()) {
+        xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+        uint32_t backlog = offlineLog.size();
+        xSemaphoreGive(offlineLogMutex);
+        if (backlog == 0) {
+            Serial.println("Ingen gemt data at sende.");
+            return;
         }
 
-        file.close();
-
-        File writeFile = LittleFS.open(dataPath, FILE_WRITE);
-        if (writeFile) {
-            writeFile.print(remainingData);
-            writeFile.close();
-        } else {
-            Serial.println("Kunne ikke opdatere gemt data.");
+        uint32_t batches = backlogSender.messages();
+        int64_t startUs = esp_timer_get_time();
+        uint32_t sent = backlogSender.send(DRAIN_BUDGET_MS);
+        if (sent > 0) {
+            recordStage(STAGE_DRAIN, startUs);
+            xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+            backlog = offlineLog.size();
+            xSemaphoreGive(offlineLogMutex);
+            Serial.printf("%u poster sendt til MQTT i %u beskeder, %u venter på kvittering eller afsendelse.\n",
+                          (unsigned)sent, (unsigned)(backlogSender.messages() - batches), (unsigned)backlog);
         }
     } else {
         Serial.println("WiFi eller MQTT ikke forbundet. Kunne ikke sende data.");
@@ -452,19 +1532,52 @@ void sendSavedData() {
 // Gendan til AP-mode
 void resetAP() {
     triggerAPMode = false;
-    LittleFS.remove(ssidPath);
-    LittleFS.remove(passPath);
+    wakeCache.reset();
+    config.ssid[0] = '\0';
+    config.pass[0] = '\0';
+    saveConfig();
     ESP.restart();
 }
 
 // Sæt ESP'en i deep sleep
 void goToSleep() {
-    if (digitalRead(SENSOR1_PIN) == HIGH) {
+    if (anyLaneActive()) {
         Serial.println("Bevægelsessensor aktiv. Afventer.");
         return;
     }
 
     Serial.println("Ingen aktivitet. Går i deep sleep...");
-    esp_sleep_enable_ext0_wakeup(GPIO_NUM_33, 1); // Wake-up ved HIGH signal
+    collectTelemetry();
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    powerState = POWER_DEEP_SLEEP;
+    telemetry.sleepStartUs = wallClockUs();
+    telemetry.seal(); // Målingerne skal overleve søvnen
+    xSemaphoreGive(telemetryMutex);
+    recentPlates.seal(); // Ændres den imens, er CRC'en forkert og cachen starter forfra
+    idleTimeout.seal();
+    // Markøren gemmes, så kvitterede poster ikke sendes igen, og næste opvågning ved om
+    // loggen skal åbnes. Blev den ikke åbnet, gælder det gamle tal stadig. Låsen fordi
+    // scanner- og publiceringsopgaven stadig kører
+    xSemaphoreTake(offlineLogMutex, portMAX_DELAY);
+    if (offlineLog.isOpen()) {
+        offlineLog.commit();
+        wakeCache.backlogRecords = offlineLog.size();
+        wakeCache.seal();
+    }
+    xSemaphoreGive(offlineLogMutex);
+    // Wake-up ved HIGH signal på en hvilken som helst bane
+    uint64_t wakeMask = 0;
+    for (uint8_t lane = 0; lane < LANE_COUNT; lane++) {
+        wakeMask |= 1ULL << laneConfig[lane].pin;
+    }
+    esp_sleep_enable_ext1_wakeup(wakeMask, ESP_EXT1_WAKEUP_ANY_HIGH);
+
+    // Ventende bevægelser fra korte opvågninger: vågn når de skal uploades, dog tidligst
+    // UPLOAD_RETRY_S efter et forsøg der ikke fik alt afleveret
+    if (RADIO_DUTY_CYCLE && rtcEvents.pending() > 0) {
+        int64_t dueUs = rtcEvents.uploadInUs(wallClockUs(), UPLOAD_MIN_EVENTS, UPLOAD_MAX_AGE_S * uS_TO_S_FACTOR,
+                                             UPLOAD_FILL_PERCENT, UPLOAD_RETRY_S * uS_TO_S_FACTOR);
+        esp_sleep_enable_timer_wakeup(dueUs > (int64_t)uS_TO_S_FACTOR ? dueUs : uS_TO_S_FACTOR);
+    }
     esp_deep_sleep_start();
 }
@@ -0,0 +1,68 @@
+#include "mqtt_connection.h"
+
+#include <WiFi.h>
+
+uint32_t MqttConnection::nextBackoffMs() {
+    // Fordobling pr. fejl op til loftet; jitter i [halvdelen, hele] ventetiden
+    uint32_t delayMs = backoffMaxMs;
+    if (consecutiveFailures < 16) {
+        uint64_t doubled = (uint64_t)backoffMinMs << (consecutiveFailures - 1);
+        if (doubled < backoffMaxMs) {
+            delayMs = (uint32_t)doubled;
+        }
+    }
+    return delayMs / 2 + random(delayMs / 2 + 1);
+}
+
+uint32_t MqttConnection::retryInMs() const {
+    if (state != BACKOFF) {
+        return 0;
+    }
+    long remaining = (long)(nextAttemptAt - millis());
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+bool MqttConnection::poll() {
+    if (client.connected()) {
+        if (state != CONNECTED) {
+            Serial.println("Forbundet til MQTT!");
+            state = CONNECTED;
+            consecutiveFailures = 0;
+        }
+        return true;
+    }
+
+    if (state == CONNECTED) {
+        // Forbindelsen er tabt: prøv igen med det samme, derefter med backoff
+        Serial.printf("MQTT-forbindelsen blev afbrudt (kode: %d).\n", client.state());
+        state = DISCONNECTED;
+    }
+
+    if (state == BACKOFF && (long)(millis() - nextAttemptAt) < 0) {
+        return false;
+    }
+
+    if (WiFi.status() != WL_CONNECTED) {
+        consecutiveFailures++;
+        state = BACKOFF;
+        nextAttemptAt = millis() + nextBackoffMs();
+        return false;
+    }
+
+    Serial.print("Forbinder til MQTT-broker...");
+    totalAttempts++;
+    if (client.connect(clientId)) {
+        Serial.println("Forbundet til MQTT!");
+        state = CONNECTED;
+        consecutiveFailures = 0;
+        return true;
+    }
+
+    consecutiveFailures++;
+    uint32_t waitMs = nextBackoffMs();
+    state = BACKOFF;
+    nextAttemptAt = millis() + waitMs;
+    Serial.printf("Fejl under forbindelse til MQTT-broker (kode: %d). Forsøger igen om %u ms.\n", client.state(),
+                  (unsigned)waitMs);
+    return false;
+}
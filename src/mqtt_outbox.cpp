@@ -0,0 +1,156 @@
+#include "mqtt_outbox.h"
+
+#include "esp_timer.h"
+
+static const uint8_t MQTT_PUBLISH_QOS1 = 0x32;
+static const uint8_t MQTT_PUBACK = 0x40;
+static const uint8_t MQTT_PINGREQ = 0xC0;
+
+bool MqttOutbox::write(const uint8_t *data, size_t length) {
+    lastOutMs = millis();
+    if (client.write(data, length) == length) {
+        return true;
+    }
+    // En halv pakke kan ikke trækkes tilbage; brokeren ville læse resten af strømmen forkert
+    client.stop();
+    return false;
+}
+
+bool MqttOutbox::publish(const char *topic, const uint8_t *payload, size_t length, uint32_t endSeq) {
+    if (!canSend()) {
+        return false;
+    }
+    uint16_t packetId = nextPacketId;
+    nextPacketId = nextPacketId == 0xFFFF ? 1 : nextPacketId + 1;
+
+    // Fast header, emne og pakke-id skrives samlet; beskeden bagefter direkte fra kalderens buffer
+    size_t topicLength = strlen(topic);
+    uint8_t header[5 + 2 + 64 + 2];
+    if (topicLength > 64) {
+        return false;
+    }
+    size_t remaining = 2 + topicLength + 2 + length;
+    size_t pos = 0;
+    header[pos++] = MQTT_PUBLISH_QOS1;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        header[pos++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0);
+    header[pos++] = topicLength >> 8;
+    header[pos++] = topicLength & 0xFF;
+    memcpy(header + pos, topic, topicLength);
+    pos += topicLength;
+    header[pos++] = packetId >> 8;
+    header[pos++] = packetId & 0xFF;
+    if (!write(header, pos) || !write(payload, length)) {
+        return false;
+    }
+
+    Pending &entry = pending[(first + count) % MAX_WINDOW];
+    entry.packetId = packetId;
+    entry.acked = false;
+    entry.endSeq = endSeq;
+    entry.sentUs = esp_timer_get_time();
+    count++;
+    sent = endSeq;
+    return true;
+}
+
+bool MqttOutbox::readPacket(bool &complete) {
+    complete = false;
+    while (client.available() > 0) {
+        int c = client.read();
+        if (c < 0) {
+            return true; // Resten kommer ved et senere kald
+        }
+        switch (rxStage) {
+        case RX_HEADER:
+            rxHeader = (uint8_t)c;
+            rxRemaining = 0;
+            rxMultiplier = 1;
+            rxLength = 0;
+            rxStage = RX_LENGTH;
+            break;
+        case RX_LENGTH:
+            if (rxMultiplier > 128 * 128 * 128) {
+                rxStage = RX_HEADER;
+                return false;
+            }
+            rxRemaining += (c & 0x7F) * rxMultiplier;
+            rxMultiplier *= 128;
+            if (!(c & 0x80)) {
+                rxStage = RX_BODY;
+            }
+            break;
+        case RX_BODY:
+            // Større pakker end forventet læses til ende og kasseres
+            if (rxLength < sizeof(rxBody)) {
+                rxBody[rxLength] = (uint8_t)c;
+            }
+            rxLength++;
+            break;
+        }
+        if (rxStage == RX_BODY && rxLength == rxRemaining) {
+            rxStage = RX_HEADER;
+            complete = true;
+            return true;
+        }
+    }
+    return true;
+}
+
+void MqttOutbox::handleAck(uint16_t packetId) {
+    for (uint8_t i = 0; i < count; i++) {
+        Pending &entry = pending[(first + i) % MAX_WINDOW];
+        if (entry.packetId == packetId && !entry.acked) {
+            entry.acked = true;
+            if (ackHandler) {
+                ackHandler((uint32_t)(esp_timer_get_time() - entry.sentUs));
+            }
+            break;
+        }
+    }
+    // Kvitteringer kommer normalt i rækkefølge; en der springer frem venter på de ældre
+    while (count > 0 && pending[first].acked) {
+        acked = pending[first].endSeq;
+        first = (first + 1) % MAX_WINDOW;
+        count--;
+    }
+}
+
+bool MqttOutbox::poll() {
+    bool complete = true;
+    while (complete) {
+        if (!readPacket(complete)) {
+            return false;
+        }
+        if (complete && (rxHeader & 0xF0) == MQTT_PUBACK && rxLength == 2) {
+            handleAck((rxBody[0] << 8) | rxBody[1]);
+        }
+        // PINGRESP og andet kræver ikke noget
+    }
+
+    if (count > 0 && esp_timer_get_time() - pending[first].sentUs > (int64_t)ackTimeoutMs * 1000) {
+        Serial.println("Ingen kvittering fra MQTT-brokeren. Forbinder igen.");
+        return false;
+    }
+    if (keepAliveMs > 0 && millis() - lastOutMs >= keepAliveMs) {
+        uint8_t ping[] = {MQTT_PINGREQ, 0};
+        if (!write(ping, sizeof(ping))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MqttOutbox::reset(uint32_t resendFrom) {
+    if (count > 0) {
+        resendCount += count;
+    }
+    first = 0;
+    count = 0;
+    acked = resendFrom;
+    sent = resendFrom;
+    rxStage = RX_HEADER; // En halv pakke fra den gamle forbindelse hører ikke til den nye
+}
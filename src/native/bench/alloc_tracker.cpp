@@ -0,0 +1,71 @@
+// Global operator new/delete der tæller allokeringer pr. tråd
+#include "alloc_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Hver blok får et lille hoved foran med størrelsen og om den blev talt med
+struct alignas(16) Header {
+    size_t size;
+    bool tracked;
+};
+
+thread_local bool trackThread = false;
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> bytes{0};
+std::atomic<int64_t> liveBytes{0};
+std::atomic<int64_t> peakLiveBytes{0};
+
+void *allocate(size_t size) {
+    Header *header = static_cast<Header *>(std::malloc(sizeof(Header) + size));
+    if (!header) {
+        throw std::bad_alloc();
+    }
+    header->size = size;
+    header->tracked = trackThread;
+    if (trackThread) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        int64_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+        while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live)) {
+        }
+    }
+    return header + 1;
+}
+
+void release(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    Header *header = static_cast<Header *>(ptr) - 1;
+    if (header->tracked) {
+        liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    }
+    std::free(header);
+}
+
+}  // namespace
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void operator delete(void *ptr) noexcept { release(ptr); }
+void operator delete[](void *ptr) noexcept { release(ptr); }
+void operator delete(void *ptr, size_t) noexcept { release(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { release(ptr); }
+
+namespace alloctracker {
+
+void trackThisThread() { trackThread = true; }
+
+Snapshot snapshot() {
+    return {allocations.load(), bytes.load(), liveBytes.load(), peakLiveBytes.load()};
+}
+
+void resetPeak() { peakLiveBytes.store(liveBytes.load()); }
+
+}  // namespace alloctracker
@@ -0,0 +1,22 @@
+// Tæller heap-allokeringer foretaget af den tråd der måles på
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace alloctracker {
+
+struct Snapshot {
+    uint64_t allocations;
+    uint64_t bytes;
+    int64_t liveBytes;
+    int64_t peakLiveBytes;
+};
+
+// Kun allokeringer fra tråde der har kaldt trackThisThread() tælles med
+void trackThisThread();
+Snapshot snapshot();
+// Nulstil toppunktet til det nuværende niveau, så hver måling får sit eget toppunkt
+void resetPeak();
+
+}  // namespace alloctracker
@@ -0,0 +1,950 @@
+// Latens- og allokeringsmålinger af pladepipelinen på host
+//
+// Kører firmwarens egne funktioner fra src/main.cpp mod lokale stand-ins for
+// scanneren og brokeren. Sæt BENCH_SCANNER=host:port (fx fake_scanner.py) eller
+// BENCH_BROKER=host:port (fx mosquitto) for at bruge rigtige tjenester i stedet.
+// BENCH_RADIO=scan,dhcp,ntp (ms) sætter de simulerede radioomkostninger ved opvågning.
+// BENCH_TELEMETRY=1 udskriver telemetribeskeden med histogrammerne fra kørslen.
+// BENCH_RTT_MS sætter brokerens simulerede kvitteringstid i sammenligningen af QoS 1-vinduer.
+// Bygget med -DLANE_COUNT=4 (env:native_lanes) måles banerne samtidig.
+// Afslutter med kode 1 hvis en af kontrollerne undervejs fejler.
+//
+// `pio test` bygger src/ sammen med testene under test/, som har deres egen main()
+#ifndef PIO_UNIT_TESTING
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "ESPAsyncWebServer.h"
+#include "LittleFS.h"
+#include "PubSubClient.h"
+#include "WiFi.h"
+#include "alloc_tracker.h"
+#include "backlog_sender.h"
+#include "device_config.h"
+#include "esp_timer.h"
+#include "event_queue.h"
+#include "idle_timeout.h"
+#include "lane_config.h"
+#include "offline_log.h"
+#include "payload_codec.h"
+#include "recent_plates.h"
+#include "rtc_event_buffer.h"
+#include "scanner_client.h"
+#include "status_stream.h"
+#include "telemetry.h"
+#include "local_services.h"
+#include "mqtt_connection.h"
+#include "mqtt_outbox.h"
+#include "native_shim.h"
+#include "wake_cache.h"
+#include "web_asset.h"
+
+// Fra src/main.cpp
+void setup();
+void loadConfig();
+bool bufferedWaiting();
+bool connectNetwork();
+uint32_t scanPlates(ScannerClient &scanner, const MotionEvent *events, uint32_t count, PlateReading *readings,
+                    ScanOutcome *outcomes = nullptr);
+void reportBufferedScan(const MotionEvent &event, ScanOutcome outcome);
+void processPlate(const PlateReading &reading);
+void sendToMQTT(const PlateReading &reading);
+int64_t wallClockUs();
+bool serviceMqtt();
+void sendSavedData();
+bool formatCaptureTime(int64_t captureUs, char *buffer, size_t size);
+bool bufferWake(esp_sleep_wakeup_cause_t cause);
+uint32_t takeBufferedEvents(MotionEvent *events, uint32_t max);
+void recordStage(TelemetryStage stage, int64_t startUs);
+bool publishTelemetry();
+bool pipelineIdle();
+void idleWait(uint32_t ms);
+void setPowerState(PowerState state);
+String readFile(fs::FS &fs, const char *path);
+extern PubSubClient mqttClient;
+extern MqttConnection mqttConnection;
+extern MqttOutbox mqttOutbox;
+extern BacklogSender backlogSender;
+extern DeviceConfig config;
+extern OfflineLog offlineLog;
+extern SpscQueue<MotionEvent, 16> motionEvents;
+extern EdgeDebouncer laneDebounce[];
+extern WakeCache wakeCache;
+extern RtcEventBuffer rtcEvents;
+extern std::atomic<bool> bufferedFailed;
+extern Telemetry telemetry;
+extern RecentPlates recentPlates;
+extern IdleTimeout idleTimeout;
+extern AsyncWebServer server;
+
+namespace {
+
+const uint8_t sensorPin = laneConfig[0].pin;
+const char *sampleRecord = "{\"plate\":\"A000AA78\",\"timestamp\":\"2024-12-12T10:00:00.000000\"}";
+
+using Clock = std::chrono::steady_clock;
+
+// Kontroller der er fejlet indtil nu
+int failedChecks = 0;
+
+bool check(bool ok) {
+    failedChecks += ok ? 0 : 1;
+    return ok;
+}
+
+struct Stage {
+    explicit Stage(const char *name) : name(name) {}
+
+    template <typename Fn>
+    void measure(Fn fn) {
+        alloctracker::Snapshot before = alloctracker::snapshot();
+        auto start = Clock::now();
+        fn();
+        auto end = Clock::now();
+        alloctracker::Snapshot after = alloctracker::snapshot();
+        micros.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        allocations += after.allocations - before.allocations;
+        bytes += after.bytes - before.bytes;
+    }
+
+    void report() {
+        if (micros.empty()) {
+            return;
+        }
+        std::sort(micros.begin(), micros.end());
+        auto pct = [&](double p) { return micros[std::min(micros.size() - 1, size_t(p * micros.size()))]; };
+        double n = static_cast<double>(micros.size());
+        std::printf("%-22s %7zu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, micros.size(), pct(0.50),
+                    pct(0.95), pct(0.99), micros.back(), allocations / n, bytes / n);
+    }
+
+    const char *name;
+    std::vector<double> micros;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+bool parseHostPort(const char *value, std::string &host, uint16_t &port) {
+    if (!value) {
+        return false;
+    }
+    std::string str = value;
+    size_t colon = str.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    host = str.substr(0, colon);
+    port = static_cast<uint16_t>(std::atoi(str.c_str() + colon + 1));
+    return true;
+}
+
+std::vector<size_t> parseSizes(const char *value, const char *defaults = "10,1000,100000") {
+    std::vector<size_t> sizes;
+    std::string str = value ? value : defaults;
+    size_t pos = 0;
+    while (pos < str.size()) {
+        size_t comma = str.find(',', pos);
+        sizes.push_back(std::strtoull(str.c_str() + pos, nullptr, 10));
+        pos = comma == std::string::npos ? str.size() : comma + 1;
+    }
+    return sizes;
+}
+
+// Skift offline-log; udbakken følger med, da den husker sekvensnumre i loggen
+void useLog(const char *dir, uint16_t segmentRecords = OfflineLog::DEFAULT_SEGMENT_RECORDS) {
+    offlineLog.begin(LittleFS, dir, 16, segmentRecords);
+    mqttOutbox.reset(offlineLog.oldestSeq());
+}
+
+// Hver størrelse får sin egen log med plads nok til alle poster
+void fillBacklog(size_t records) {
+    char dir[16];
+    snprintf(dir, sizeof(dir), "/bench%zu", records);
+    useLog(dir, static_cast<uint16_t>(std::max<size_t>(16, (records + 7) / 8)));
+    for (size_t i = 0; i < records; i++) {
+        offlineLog.append(sampleRecord);
+    }
+}
+
+// Det publiceringsopgaven gør: send fra offline-loggen og læs kvitteringer, indtil alt er
+// kvitteret. Returnerer false ved timeout
+bool pumpMqtt(int timeoutMs = 10000) {
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (offlineLog.size() > 0) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        if (serviceMqtt() && backlogSender.ready()) {
+            sendSavedData();
+        } else if (!mqttClient.connected()) {
+            delay(5);
+        }
+    }
+    return true;
+}
+
+// Scannerforbindelsen for den kaldende tråd, som scanneropgaverne har hver deres.
+// Oprettes når indstillingerne er indlæst
+std::unique_ptr<ScannerClient> benchScanner;
+
+// Samme arbejde som én bevægelse gennem scanner- og publiceringsopgaven, men i den kaldende tråd
+void handleMotion(const MotionEvent &event) {
+    PlateReading reading;
+    if (scanPlates(*benchScanner, &event, 1, &reading) == 1) {
+        processPlate(reading);
+        if (mqttClient.connected()) {
+            pumpMqtt();
+        }
+    }
+}
+
+// Tag de bevægelser ISR'en har lagt i køen, som opsamlingsopgaven ville gøre
+uint32_t drainMotionEvents(bool handle) {
+    MotionEvent events[16];
+    uint32_t count = motionEvents.popBatch(events, 16);
+    for (uint32_t i = 0; i < count && handle; i++) {
+        handleMotion(events[i]);
+    }
+    return count;
+}
+
+// Send count flanker og mål hændelser/s til brokeren, enten i den kaldende tråd
+// eller gennem opgaverne. Flankerne fordeles så interrupt-køen aldrig løber over
+double measureThroughput(LocalBroker &broker, int count, bool pipelined) {
+    uint64_t target = broker.records() + count;
+    auto t0 = Clock::now();
+    for (int i = 0; i < count; i++) {
+        while (motionEvents.size() >= motionEvents.capacity()) {
+            delay(1);
+        }
+        nativeshim::setPin(sensorPin, HIGH);
+        nativeshim::setPin(sensorPin, LOW);
+        if (!pipelined) {
+            drainMotionEvents(true);
+        }
+    }
+    broker.waitForRecords(target, 30000); // Flere poster kan nå frem i samme besked
+    double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    return count / seconds;
+}
+
+bool ensureConnected(int timeoutMs = 10000) {
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!mqttConnection.poll()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        delay(5);
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    char fsRoot[] = "/tmp/plate_bench_XXXXXX";
+    nativeshim::setFsRoot(mkdtemp(fsRoot));
+    nativeshim::setDeepSleepHandler([] { std::fprintf(stderr, "deep sleep under måling\n"); });
+
+    int iterations = getenv("BENCH_ITERATIONS") ? std::atoi(getenv("BENCH_ITERATIONS")) : 200;
+    std::vector<size_t> backlogSizes = parseSizes(getenv("BENCH_BACKLOG"));
+
+    // setup() skal finde et SSID for at gå i stationstilstand; den gamle tekstfil flyttes til
+    // /config.bin. Indstillingerne indlæses her, så scanner og broker er firmwarens egne
+    LittleFS.begin(true);
+    File ssidFile = LittleFS.open("/ssid.txt", FILE_WRITE);
+    ssidFile.print("bench");
+    ssidFile.close();
+    nativeshim::setSerialQuiet(true);
+    loadConfig();
+
+    std::unique_ptr<LocalScanner> localScanner;
+    std::unique_ptr<LocalBroker> localBroker;
+    std::string host;
+    uint16_t port;
+    if (parseHostPort(getenv("BENCH_SCANNER"), host, port)) {
+        nativeshim::redirect(config.scannerHost, config.scannerPort, host.c_str(), port);
+    } else {
+        localScanner.reset(new LocalScanner());
+        nativeshim::redirect(config.scannerHost, config.scannerPort, "127.0.0.1", localScanner->port());
+    }
+    if (parseHostPort(getenv("BENCH_BROKER"), host, port)) {
+        nativeshim::redirect(config.mqttBroker, config.mqttPort, host.c_str(), port);
+    } else {
+        localBroker.reset(new LocalBroker());
+        nativeshim::redirect(config.mqttBroker, config.mqttPort, "127.0.0.1", localBroker->port());
+    }
+    benchScanner.reset(new ScannerClient(config.scannerHost, config.scannerPort));
+
+    alloctracker::trackThisThread();
+    // Opgaverne holdes tilbage, så hvert trin kan måles for sig i denne tråd
+    nativeshim::holdTasks(true);
+
+    Stage boot("setup");
+    boot.measure([] { setup(); });
+    ensureConnected();
+
+    // Filsystemarbejdet ved opstart: før læste setup() tre tekstfiler og åbnede altid
+    // offline-loggen; nu læses /config.bin kun ved kold start, og loggen åbnes ved behov
+    Stage bootText("boot: 3 tekstfiler");
+    Stage bootConfig("boot: /config.bin");
+    Stage bootLog("boot: åbn offline-log");
+    {
+        const char *oldFiles[] = {"/old_ssid.txt", "/old_pass.txt", "/old_data.txt"};
+        for (const char *path : oldFiles) {
+            File file = LittleFS.open(path, FILE_WRITE);
+            file.print("bench");
+            file.close();
+        }
+        OfflineLog filled;
+        filled.begin(LittleFS, "/bootlog");
+        for (int i = 0; i < 100; i++) {
+            filled.append(sampleRecord);
+        }
+        filled.end();
+        for (int i = 0; i < iterations; i++) {
+            bootText.measure([&] {
+                for (const char *path : oldFiles) {
+                    readFile(LittleFS, path);
+                }
+            });
+            bootConfig.measure([] {
+                DeviceConfig loaded;
+                loaded.load(LittleFS, "/config.bin");
+            });
+            bootLog.measure([] {
+                OfflineLog log;
+                log.begin(LittleFS, "/bootlog");
+                log.end();
+            });
+        }
+        for (const char *path : oldFiles) {
+            LittleFS.remove(path);
+        }
+    }
+
+    // Opvågning til første publicering med simuleret scanning, DHCP og NTP (ms). Kold
+    // tømmer RTC-cachen som efter strømsvigt; varm genbruger den som efter deep sleep
+    Stage wakeCold("wake->publish (kold)");
+    Stage wakeWarm("wake->publish (varm)");
+    if (localBroker) {
+        std::vector<size_t> radio = parseSizes(getenv("BENCH_RADIO"), "1200,400,150");
+        radio.resize(3, 0);
+        nativeshim::setRadioTiming(radio[0], radio[1], radio[2]);
+        auto wake = [&](Stage &stage, bool cold) {
+            if (cold) {
+                wakeCache.reset();
+                WiFi.config(IPAddress(), IPAddress(), IPAddress()); // Efter genstart bruges DHCP
+            }
+            mqttClient.disconnect();
+            WiFi.disconnect();
+            uint64_t expected = localBroker->publishes() + 1;
+            stage.measure([&] {
+                connectNetwork();
+                ensureConnected();
+                handleMotion({esp_timer_get_time(), 0, 0});
+                localBroker->waitForPublishes(expected, 5000);
+            });
+        };
+        for (int i = 0; i < 3; i++) {
+            wake(wakeCold, true);
+            wake(wakeWarm, false);
+        }
+        nativeshim::setRadioTiming(0, 0, 0);
+    }
+
+    // Radiofri tilstand: en kort opvågning gemmer kun bevægelsen i RTC, og pladerne hentes
+    // og sendes samlet ved upload. Sidst fyldes ringen, så overløbet til LittleFS måles
+    Stage wakeBuffer("wake (RTC-buffer)");
+    Stage wakeSpill("wake (LittleFS)");
+    Stage upload("upload pr. hændelse");
+    unsigned shortWakes = 0;
+    unsigned uploads = 0;
+    bool keptWhenScannerDown = false;
+    if (localBroker) {
+        auto drainBuffered = [&] {
+            uint32_t pending = rtcEvents.pending();
+            uint64_t expected = localBroker->records() + pending;
+            auto t0 = Clock::now();
+            MotionEvent events[8];
+            PlateReading readings[8];
+            ScanOutcome outcomes[8];
+            uint32_t count;
+            // Som scanneropgaven: afleverede plader meldes tilbage, før næste samling tages
+            while ((count = takeBufferedEvents(events, 8)) > 0) {
+                scanPlates(*benchScanner, events, count, readings, outcomes);
+                const PlateReading *reading = readings;
+                for (uint32_t i = 0; i < count; i++) {
+                    if (outcomes[i] == SCAN_PLATE) {
+                        processPlate(*reading++);
+                    }
+                    reportBufferedScan(events[i], outcomes[i]);
+                }
+            }
+            pumpMqtt();
+            localBroker->waitForRecords(expected, 5000);
+            upload.micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / pending);
+            uploads++;
+        };
+        nativeshim::setWakeupCause(ESP_SLEEP_WAKEUP_EXT1, 1ULL << sensorPin); // Bane 0 vækker enheden
+        rtcEvents.reset();
+        for (int i = 0; i < iterations; i++) {
+            bool stayAsleep = false;
+            wakeBuffer.measure([&] { stayAsleep = bufferWake(ESP_SLEEP_WAKEUP_EXT1); });
+            if (stayAsleep) {
+                shortWakes++;
+            } else {
+                drainBuffered();
+            }
+        }
+        rtcEvents.reset();
+        for (int i = 0; i < RtcEventBuffer::CAPACITY; i++) {
+            rtcEvents.push(wakeCache.ntpSyncUs + i, 0);
+        }
+        rtcEvents.seal();
+        for (int i = 0; i < 16; i++) {
+            wakeSpill.measure([] { bufferWake(ESP_SLEEP_WAKEUP_EXT1); });
+        }
+        drainBuffered();
+
+        // Scanneren svarer ikke: bevægelserne skal blive i RTC, og næste upload skal vente
+        ScannerClient deadScanner("127.0.0.1", 1);
+        rtcEvents.reset();
+        for (int i = 0; i < 5; i++) {
+            rtcEvents.push(wallClockUs() - i, 0);
+        }
+        rtcEvents.seal();
+        MotionEvent events[8];
+        PlateReading readings[8];
+        ScanOutcome outcomes[8];
+        uint32_t count = takeBufferedEvents(events, 8);
+        scanPlates(deadScanner, events, count, readings, outcomes);
+        for (uint32_t i = 0; i < count; i++) {
+            reportBufferedScan(events[i], outcomes[i]);
+        }
+        uint32_t retaken = takeBufferedEvents(events, 8);
+        // Forsøget er registreret, så både denne opvågning og næste venter UPLOAD_RETRY_S
+        keptWhenScannerDown = count == 5 && retaken == 0 && rtcEvents.valid() && rtcEvents.pending() == 5 &&
+                              bufferedWaiting() && rtcEvents.lastUploadUs != 0;
+        rtcEvents.reset();
+        bufferedFailed = false;
+        nativeshim::setWakeupCause(ESP_SLEEP_WAKEUP_UNDEFINED);
+    }
+
+    Stage scanner("scanner");
+    Stage publish("publish");
+    Stage batch("scanner-batch (8)");
+    Stage isr("isr->publish");
+    Stage motion("motion->publish");
+    Stage broker("motion->broker");
+    Stage append("backlog-append");
+    Stage pollDown("poll (broker nede)");
+    Stage motionDown("motion (broker nede)");
+
+    PlateReading sample = {"A000AA78", "2024-12-12T10:00:00.000000", 0, 0};
+    for (int i = 0; i < iterations; i++) {
+        PlateReading readings[8];
+        scanner.measure([&] { benchScanner->fetch(readings[0]); });
+        batch.measure([&] { benchScanner->fetchBatch(readings, 8); });
+        publish.measure([&] { sendToMQTT(sample); });
+        motion.measure([] { handleMotion({esp_timer_get_time(), 0, 0}); });
+        if (localBroker) {
+            uint64_t expected = localBroker->publishes() + 1;
+            broker.measure([&] {
+                handleMotion({esp_timer_get_time(), 0, 0});
+                localBroker->waitForPublishes(expected, 5000);
+            });
+        }
+    }
+
+    // Fra sensorflanke gennem interrupt-køen til publish; debounce slås fra så hver flanke tæller
+    uint32_t window = laneDebounce[0].windowUs;
+    laneDebounce[0].windowUs = 0;
+    for (int i = 0; i < iterations; i++) {
+        isr.measure([] {
+            nativeshim::setPin(sensorPin, HIGH);
+            nativeshim::setPin(sensorPin, LOW);
+            drainMotionEvents(true);
+        });
+    }
+
+    // To biler lige efter hinanden må ikke blive til én hændelse
+    const int burst = 8;
+    for (int i = 0; i < burst; i++) {
+        nativeshim::setPin(sensorPin, HIGH);
+        nativeshim::setPin(sensorPin, LOW);
+    }
+    uint32_t burstEvents = drainMotionEvents(false);
+    laneDebounce[0].windowUs = window;
+
+    // Alle baner trigger på samme tid, og hver sensor prelles lige efter. Hver bane skal
+    // give præcis én hændelse pr. bil med sin egen bane, uanset de andre baner
+    const int laneRounds = 200;
+    uint32_t laneEvents[LANE_COUNT] = {};
+    uint32_t suppressedBefore[LANE_COUNT];
+    uint32_t windows[LANE_COUNT];
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        suppressedBefore[lane] = laneDebounce[lane].suppressed;
+        windows[lane] = laneDebounce[lane].windowUs;
+        laneDebounce[lane].windowUs = 1000; // 1 ms, så runderne ikke tager sekunder
+    }
+    delay(2); // Ude af vinduet fra flankerne ovenfor
+    for (int round = 0; round < laneRounds; round++) {
+        for (int bounce = 0; bounce < 2; bounce++) {
+            for (int lane = 0; lane < LANE_COUNT; lane++) {
+                nativeshim::setPin(laneConfig[lane].pin, HIGH);
+                nativeshim::setPin(laneConfig[lane].pin, LOW);
+            }
+        }
+        MotionEvent events[16];
+        uint32_t count = motionEvents.popBatch(events, 16);
+        for (uint32_t i = 0; i < count; i++) {
+            laneEvents[events[i].lane]++;
+        }
+        delay(2);
+    }
+    bool lanesOk = true;
+    std::printf("Baner: %d runder hvor alle %d baner trigger samtidig og prelles\n", laneRounds, LANE_COUNT);
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        uint32_t suppressed = laneDebounce[lane].suppressed - suppressedBefore[lane];
+        std::printf("  bane %d (pin %u): %u hændelser, %u prel filtreret\n", lane, laneConfig[lane].pin, laneEvents[lane],
+                    suppressed);
+        lanesOk = lanesOk && laneEvents[lane] == laneRounds && suppressed == laneRounds;
+        laneDebounce[lane].windowUs = windows[lane];
+    }
+    std::printf("  %s\n", check(lanesOk) ? "ingen tabt eller fejlplaceret" : "FEJL: hændelser tabt eller fejlplaceret");
+
+    for (int i = 0; i < iterations; i++) {
+        append.measure([] { offlineLog.append(sampleRecord); });
+    }
+
+    // Udfald: loopet må ikke blokere, og hændelser skal ende i offline-loggen
+    double recoveryMs = -1;
+    if (localBroker) {
+        useLog("/outage");
+        // Forbindelsen falder mens beskeder venter på PUBACK; de skal sendes igen bagefter
+        ensureConnected();
+        localBroker->setAckDelay(10000);
+        for (int i = 0; i < 8; i++) {
+            offlineLog.append(sampleRecord);
+        }
+        while (mqttOutbox.inFlight() == 0 && serviceMqtt()) {
+            if (backlogSender.ready()) {
+                sendSavedData();
+            }
+        }
+        uint32_t resendsBefore = mqttOutbox.resends();
+        localBroker->setAvailable(false);
+        localBroker->setAckDelay(0);
+        while (mqttClient.connected()) {
+            delay(1);
+        }
+        for (int i = 0; i < iterations; i++) {
+            pollDown.measure([] { mqttConnection.poll(); });
+            motionDown.measure([] { handleMotion({esp_timer_get_time(), 0, 0}); });
+        }
+        uint64_t before = localBroker->records();
+        uint32_t queued = offlineLog.size();
+        localBroker->setAvailable(true);
+        auto t0 = Clock::now();
+        pumpMqtt(120000);
+        localBroker->waitForRecords(before + queued, 5000);
+        recoveryMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        uint64_t recovered = localBroker->records() - before;
+        check(recovered >= queued);
+        std::printf("Udfald: %u hændelser gemt, %llu leveret efter genopkobling på %.0f ms (%u forsøg i alt, "
+                    "%u ukvitterede beskeder sendt igen)\n",
+                    queued, static_cast<unsigned long long>(recovered), recoveryMs,
+                    mqttConnection.attempts(), mqttOutbox.resends() - resendsBefore);
+    }
+
+    std::printf("\nPr. trin (mikrosekunder, allokeringer og bytes pr. kald)\n");
+    std::printf("%-22s %7s %10s %10s %10s %10s %10s %10s\n", "trin", "n", "p50", "p95", "p99", "max", "alloc/op",
+                "bytes/op");
+    boot.report();
+    bootText.report();
+    bootConfig.report();
+    bootLog.report();
+    wakeCold.report();
+    wakeWarm.report();
+    wakeBuffer.report();
+    wakeSpill.report();
+    upload.report();
+    scanner.report();
+    batch.report();
+    publish.report();
+    isr.report();
+    motion.report();
+    broker.report();
+    append.report();
+    pollDown.report();
+    motionDown.report();
+
+    check(burstEvents == static_cast<uint32_t>(burst));
+    std::printf("Burst: %d flanker uden debounce -> %u hændelser\n", burst, burstEvents);
+    if (localBroker) {
+        std::printf("Radiofri tilstand: %u af %d opvågninger uden radio, %u uploads; scanner nede: %s\n", shortWakes,
+                    iterations, uploads, check(keptWhenScannerDown) ? "bevægelserne bevaret" : "FEJL: bevægelser tabt");
+    }
+
+    // Kodning: den tidligere String-sammensætning mod de allokeringsfri kodere. Bytes på
+    // luften er hele MQTT PUBLISH-pakken (fast header + emne + payload) ved QoS 0
+    const int encodeBatch = 100;
+    std::printf("\nKodning af payload (%d x %d kald)\n", iterations, encodeBatch);
+    std::printf("%-14s %8s %10s %10s %10s %8s\n", "format", "bytes", "MQTT bytes", "ns/kald", "alloc/kald", "retur");
+    auto reportEncoding = [&](const char *name, size_t bytes, auto encode, bool roundTrip) {
+        Stage stage(name);
+        for (int i = 0; i < iterations; i++) {
+            stage.measure([&] {
+                for (int j = 0; j < encodeBatch; j++) {
+                    encode();
+                }
+            });
+        }
+        std::sort(stage.micros.begin(), stage.micros.end());
+        size_t onAir = 2 + 2 + std::strlen("plates/detected") + bytes;
+        double calls = double(stage.micros.size()) * encodeBatch;
+        std::printf("%-14s %8zu %10zu %10.0f %10.2f %8s\n", name, bytes, onAir,
+                    stage.micros[stage.micros.size() / 2] * 1000.0 / encodeBatch, stage.allocations / calls,
+                    roundTrip ? "ok" : "-");
+    };
+    auto legacyEncode = [&] {
+        return String("{\"plate\":\"") + sample.plate + "\",\"timestamp\":\"" + sample.timestamp + "\",\"lane\":" +
+               String(sample.lane) + "}";
+    };
+    String legacy = legacyEncode();
+    reportEncoding("String-konkat", legacy.length(), [&] { legacy = legacyEncode(); }, false);
+    uint8_t encoded[OfflineLog::PAYLOAD_SIZE];
+    size_t jsonBytes = encodeJson(sample, reinterpret_cast<char *>(encoded), sizeof(encoded));
+    bool jsonSame = legacy == reinterpret_cast<char *>(encoded);
+    reportEncoding("json", jsonBytes, [&] { encodeJson(sample, reinterpret_cast<char *>(encoded), sizeof(encoded)); },
+                   check(jsonSame));
+    size_t binaryBytes = encodeBinary(sample, encoded, sizeof(encoded));
+    PlateReading decoded;
+    bool binaryRoundTrip = decodeBinary(encoded, binaryBytes, decoded) && std::strcmp(decoded.plate, sample.plate) == 0 &&
+                           std::strcmp(decoded.timestamp, sample.timestamp) == 0;
+    reportEncoding("binary v2", binaryBytes, [&] { encodeBinary(sample, encoded, sizeof(encoded)); },
+                   check(binaryRoundTrip));
+
+    // Telemetri: hvad en måling koster i hot path, og beskeden med histogrammerne fra kørslen
+    {
+        const int calls = 100000;
+        Telemetry measured = telemetry; // Målingerne fra kørslen skal ikke drukne i disse
+        int64_t start = esp_timer_get_time();
+        auto t0 = Clock::now();
+        for (int i = 0; i < calls; i++) {
+            recordStage(STAGE_PUBLISH, start);
+        }
+        double recordNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / calls;
+        telemetry = measured;
+        char json[Telemetry::JSON_MAX];
+        size_t jsonBytes = telemetry.encodeJson("bench", esp_timer_get_time(), 0, json, sizeof(json));
+        bool sent = false;
+        if (localBroker && ensureConnected()) {
+            uint64_t before = localBroker->publishes();
+            telemetry.periodStartUs = 1; // Perioden er gået
+            sent = check(publishTelemetry() && localBroker->waitForPublishes(before + 1, 5000));
+        }
+        std::printf("\nTelemetri: %.0f ns pr. måling (med lås), besked %zu bytes, sendt: %s\n", recordNs, jsonBytes,
+                    sent ? "ja" : "nej");
+        if (getenv("BENCH_TELEMETRY")) {
+            std::printf("%.*s\n", static_cast<int>(jsonBytes), json);
+        }
+    }
+
+    // Cache af nyligt sete plader: opslagets pris, og en kø ved porten hvor hver bil
+    // udløser sensoren flere gange
+    {
+        const int lookups = 100000;
+        RecentPlates saved = recentPlates;
+        static char plates[1000][16];
+        for (int i = 0; i < 1000; i++) {
+            snprintf(plates[i], sizeof(plates[i]), "Q%03dQQ%02d", i, i % 100);
+        }
+        int64_t now = wallClockUs();
+        int64_t ttlUs = config.recentPlateTtlS * 1000000LL;
+        recentPlates.reset();
+        auto t0 = Clock::now();
+        for (int i = 0; i < lookups; i++) {
+            recentPlates.seen(plates[0], now, ttlUs); // Samme plade: fundet
+        }
+        double hitNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / lookups;
+        t0 = Clock::now();
+        for (int i = 0; i < lookups; i++) {
+            recentPlates.seen(plates[i % 1000], now + i, ttlUs); // Flere plader end pladser: altid ny
+        }
+        double missNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / lookups;
+        t0 = Clock::now();
+        for (int i = 0; i < lookups; i++) {
+            recentPlates.seal();
+        }
+        double sealNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / lookups;
+        std::printf("\nNyligt sete plader (%u pladser, %zu bytes RTC): opslag %.0f ns fundet, %.0f ns ny, "
+                    "CRC før søvn %.0f ns\n",
+                    RecentPlates::CAPACITY, sizeof(RecentPlates), hitNs, missNs, sealNs);
+
+        // 20 biler i kø; hver udløser sensoren 5 gange med 3 s mellemrum
+        if (localBroker && ensureConnected()) {
+            const int cars = 20;
+            const int triggers = 5;
+            recentPlates.reset();
+            uint32_t platesBefore = telemetry.plates;
+            uint32_t repeatedBefore = telemetry.repeatedPlates;
+            uint64_t bytesBefore = localBroker->payloadBytes();
+            uint64_t publishesBefore = localBroker->publishes();
+            for (int car = 0; car < cars; car++) {
+                for (int t = 0; t < triggers; t++) {
+                    PlateReading reading = {};
+                    memcpy(reading.plate, plates[car], sizeof(reading.plate));
+                    reading.captureUs = now + (car * triggers + t) * 3000000LL;
+                    formatCaptureTime(reading.captureUs - wallClockUs() + esp_timer_get_time(), reading.timestamp,
+                                      sizeof(reading.timestamp));
+                    processPlate(reading);
+                    pumpMqtt();
+                }
+            }
+            localBroker->waitForPublishes(publishesBefore + cars * triggers, 5000);
+            uint32_t seen = telemetry.plates - platesBefore;
+            uint32_t repeated = telemetry.repeatedPlates - repeatedBefore;
+            PlateReading event = {};
+            uint8_t encoded[OfflineLog::PAYLOAD_SIZE];
+            memcpy(event.plate, plates[0], sizeof(event.plate));
+            formatCaptureTime(esp_timer_get_time(), event.timestamp, sizeof(event.timestamp));
+            size_t eventBytes = encodePayload(PAYLOAD_JSON, event, encoded, sizeof(encoded));
+            std::printf("Kø ved porten: %u plader, %u sendt som hændelse, %u som tilstedeværelse (hit rate %.0f%%), "
+                        "%llu bytes til brokeren (%zu uden cachen)\n",
+                        seen, seen - repeated, repeated, 100.0 * repeated / seen,
+                        static_cast<unsigned long long>(localBroker->payloadBytes() - bytesBefore),
+                        seen * eventBytes);
+        }
+        recentPlates = saved;
+    }
+
+    std::printf("\nTømning af backlog (sendSavedData)\n");
+    std::printf("%10s %12s %12s %12s %14s %14s %10s %10s\n", "poster", "total ms", "us/post", "alloc/post",
+                "top heap (B)", "maks/kald ms", "beskeder", "leveret");
+    for (size_t records : backlogSizes) {
+        fillBacklog(records);
+        ensureConnected();
+        uint64_t before = localBroker ? localBroker->records() : 0;
+        uint64_t messagesBefore = localBroker ? localBroker->publishes() : 0;
+
+        alloctracker::resetPeak();
+        alloctracker::Snapshot start = alloctracker::snapshot();
+        // sendSavedData() arbejder i tidsbudgetter, så den kaldes som fra publiceringsopgaven
+        double worstCallMs = 0;
+        auto t0 = Clock::now();
+        while (offlineLog.size() > 0 && ensureConnected()) {
+            if (!serviceMqtt() || !backlogSender.ready()) {
+                continue;
+            }
+            auto callStart = Clock::now();
+            sendSavedData();
+            worstCallMs = std::max(worstCallMs,
+                                   std::chrono::duration<double, std::milli>(Clock::now() - callStart).count());
+        }
+        auto t1 = Clock::now();
+        alloctracker::Snapshot end = alloctracker::snapshot();
+
+        uint64_t delivered = 0;
+        uint64_t messages = 0;
+        if (localBroker) {
+            localBroker->waitForRecords(before + records, 10000);
+            delivered = localBroker->records() - before;
+            messages = localBroker->publishes() - messagesBefore;
+            check(delivered == records);
+        }
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        std::printf("%10zu %12.1f %12.2f %12.2f %14lld %14.1f %10llu %10llu\n", records, ms, ms * 1000.0 / records,
+                    double(end.allocations - start.allocations) / records,
+                    static_cast<long long>(end.peakLiveBytes - start.liveBytes), worstCallMs,
+                    static_cast<unsigned long long>(messages), static_cast<unsigned long long>(delivered));
+    }
+
+    // QoS 1 over en forbindelse med rundturstid: med vindue 1 venter hver besked på den
+    // forriges PUBACK, med et større vindue er flere undervejs samtidig
+    if (localBroker) {
+        int rttMs = getenv("BENCH_RTT_MS") ? std::atoi(getenv("BENCH_RTT_MS")) : 20;
+        const size_t records = 512;
+        localBroker->setAckDelay(rttMs);
+        std::printf("\nQoS 1 med %d ms kvitteringstid, %zu poster i backlog + %d enkeltvis\n", rttMs, records,
+                    iterations);
+        std::printf("%8s %12s %12s %14s %14s\n", "vindue", "backlog ms", "poster/s", "enkelt p50 ms",
+                    "enkelt p99 ms");
+        for (uint8_t window : {1, 4, 8, 16}) {
+            mqttOutbox.setWindow(window);
+            char dir[16];
+            snprintf(dir, sizeof(dir), "/window%u", window);
+            useLog(dir, records / 8);
+            for (size_t i = 0; i < records; i++) {
+                offlineLog.append(sampleRecord);
+            }
+            ensureConnected();
+            auto t0 = Clock::now();
+            pumpMqtt(60000);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+            Stage single("enkelt");
+            for (int i = 0; i < iterations; i++) {
+                single.measure([] {
+                    offlineLog.append(sampleRecord);
+                    pumpMqtt();
+                });
+            }
+            std::sort(single.micros.begin(), single.micros.end());
+            std::printf("%8u %12.1f %12.0f %14.2f %14.2f\n", window, ms, records * 1000.0 / ms,
+                        single.micros[single.micros.size() / 2] / 1000.0,
+                        single.micros[single.micros.size() * 99 / 100] / 1000.0);
+        }
+        localBroker->setAckDelay(0);
+        std::printf("Genudsendelser i alt: %u\n", mqttOutbox.resends());
+    }
+
+    // Ventetid mellem bevægelser: uden WiFi sover chippen i light sleep og vækkes af sensoren,
+    // med WiFi venter loop() i modem sleep. Reaktionstiden er fra flanken til bevægelsen ligger
+    // i køen og loop() kører igen; før blev LED og søvn kun vurderet hver 100 ms
+    if (localBroker) {
+        const int wakes = std::max(iterations / 10, 5);
+        uint32_t window = laneDebounce[0].windowUs;
+        laneDebounce[0].windowUs = 0;
+        drainMotionEvents(false);
+        Telemetry measured = telemetry;
+        setPowerState(POWER_ACTIVE); // Tiden indtil nu tælles ikke med
+        std::memset(telemetry.powerUs, 0, sizeof(telemetry.powerUs));
+        mqttClient.disconnect();
+        WiFi.disconnect();
+        Stage reaction("sensor->light sleep slut");
+        uint32_t captured = 0;
+        for (int i = 0; i < wakes; i++) {
+            Clock::time_point edge;
+            std::thread sensor([&] {
+                delay(20);
+                edge = Clock::now();
+                nativeshim::setPin(sensorPin, HIGH);
+            });
+            bool idle = pipelineIdle();
+            idleWait(1000);
+            reaction.micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - edge).count());
+            sensor.join();
+            captured += idle ? drainMotionEvents(false) : 0;
+            nativeshim::setPin(sensorPin, LOW);
+        }
+        idleWait(200); // Uden bevægelse: timeren vækker
+        nativeshim::setWakeupCause(ESP_SLEEP_WAKEUP_UNDEFINED);
+        connectNetwork();
+        ensureConnected();
+        pumpMqtt();
+        for (int i = 0; i < 5; i++) {
+            idleWait(40);
+        }
+        laneDebounce[0].windowUs = window;
+        std::sort(reaction.micros.begin(), reaction.micros.end());
+        std::printf("\nLight sleep: %d sensoropvågninger, %u bevægelser registreret, reaktion p50 %.0f us, maks %.0f us\n",
+                    wakes, captured, reaction.micros[reaction.micros.size() / 2], reaction.micros.back());
+        uint64_t total = 0;
+        for (uint64_t us : telemetry.powerUs) {
+            total += us;
+        }
+        std::printf("Strømtilstande i forløbet:");
+        for (uint8_t p = 0; p < POWER_STATE_COUNT; p++) {
+            std::printf(" %s %.0f ms (%.0f%%)", Telemetry::powerStateName(static_cast<PowerState>(p)),
+                        telemetry.powerUs[p] / 1000.0, total ? 100.0 * telemetry.powerUs[p] / total : 0.0);
+        }
+        std::printf("\n");
+        telemetry = measured;
+    }
+
+    // Inaktivitetstid før deep sleep ved forskellig trafik (mellemrum mellem biler)
+    {
+        IdleTimeout saved = idleTimeout;
+        std::printf("\nInaktivitetstid (standard %u ms, %u-%u ms):", (unsigned)config.inactivityMs,
+                    (unsigned)config.inactivityMinMs, (unsigned)config.inactivityMaxMs);
+        for (uint32_t gapS : {1u, 5u, 15u, 29u, 31u, 120u}) {
+            idleTimeout.reset();
+            for (int i = 0; i <= 8; i++) {
+                idleTimeout.motion(1700000000000000LL + i * gapS * 1000000LL);
+            }
+            std::printf(" %us -> %u ms;", gapS, idleTimeout.timeoutMs(config.inactivityMs, config.inactivityMinMs,
+                                                                     config.inactivityMaxMs));
+        }
+        std::printf("\n");
+        idleTimeout = saved;
+    }
+
+    // /status i stationstilstand: øjebliksbillede og chunked JSON. Bidderne er en fuld TCP-
+    // pakke og en lille rest i sendebufferen, så en del der deles over to kald også måles
+    {
+        Stage status("/status");
+        std::string body;
+        size_t chunks = 0;
+        for (size_t chunkSize : {size_t(1436), size_t(64)}) {
+            for (int i = 0; i < iterations; i++) {
+                AsyncWebServerRequest request;
+                status.measure([&] {
+                    server.dispatch("/status", HTTP_GET, request);
+                    body = request.response->content(chunkSize);
+                });
+            }
+            chunks = (body.size() + chunkSize - 1) / chunkSize;
+        }
+        StatusSnapshot snapshot;
+        bool finished = check(body.size() > 2 && body.compare(body.size() - 2, 2, "]}") == 0);
+        std::printf("\n/status: %zu bytes, %zu bidder à 64 bytes, p50 %.1f us, %.1f allokeringer pr. forespørgsel inkl. svarobjekt "
+                    "(øjebliksbillede %zu bytes), afsluttet: %s\n",
+                    body.size(), chunks, status.micros[status.micros.size() / 2],
+                    status.allocations / static_cast<double>(status.micros.size()), sizeof(snapshot),
+                    finished ? "ja" : "nej");
+        if (getenv("BENCH_STATUS")) {
+            std::printf("%s\n", body.c_str());
+        }
+
+        // Statisk fil: første forespørgsel får den komprimerede fil, den næste kun 304
+        File gz = LittleFS.open("/bench.css.gz", FILE_WRITE);
+        for (int i = 0; i < 215; i++) {
+            gz.write(static_cast<uint8_t>(i));
+        }
+        gz.close();
+        WebAsset asset("/bench.css", "text/css");
+        AsyncWebServerRequest first;
+        asset.serve(LittleFS, &first);
+        AsyncWebServerRequest again;
+        again.addHeader("If-None-Match", first.response->header("ETag"));
+        asset.serve(LittleFS, &again);
+        check(first.responseCode == 200 && again.responseCode == 304);
+        std::printf("Statisk fil: %d med %u bytes (%s, ETag %s), igen %d med %u bytes\n", first.responseCode,
+                    first.responseBody.length(), first.response->header("Content-Encoding").c_str(),
+                    first.response->header("ETag").c_str(), again.responseCode, again.responseBody.length());
+        LittleFS.remove("/bench.css.gz");
+    }
+
+    // Gennemløb med en langsom scanner: i den kaldende tråd følger hver bevægelse efter
+    // den forrige, gennem opgaverne overlapper scannerforespørgslerne og publiceringen
+    if (localBroker && localScanner) {
+        int scannerDelayMs = getenv("BENCH_SCANNER_DELAY_MS") ? std::atoi(getenv("BENCH_SCANNER_DELAY_MS")) : 20;
+        int events = std::max(iterations, 20);
+        localScanner->setResponseDelay(scannerDelayMs);
+        laneDebounce[0].windowUs = 0;
+        double sequential = measureThroughput(*localBroker, events, false);
+        nativeshim::holdTasks(false);
+        double pipelined = measureThroughput(*localBroker, events, true);
+        std::printf("\nGennemløb med %d ms scanner, %d bevægelser: %.1f hændelser/s i én tråd, %.1f gennem opgaverne "
+                    "(%u tabt i interrupt-køen)\n",
+                    scannerDelayMs, events, sequential, pipelined, motionEvents.overflows());
+    }
+
+    if (failedChecks > 0) {
+        std::printf("\nFEJL: %d kontroller fejlede\n", failedChecks);
+    }
+
+    // Opgaverne kører videre i baggrunden og kan ikke stoppes; afslut uden at vente på dem
+    std::fflush(stdout);
+    std::_Exit(failedChecks > 0 ? 1 : 0);
+}
+
+#endif  // PIO_UNIT_TESTING
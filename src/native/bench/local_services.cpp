@@ -0,0 +1,410 @@
+// Lokale stand-ins for pladescanneren og MQTT-brokeren
+#include "local_services.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+
+namespace {
+
+int listenLoopback(uint16_t &port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(fd, 1024);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+bool readExact(int fd, uint8_t *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = ::recv(fd, buf + got, len - got, 0);
+        if (n <= 0) {
+            return false;
+        }
+        got += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void writeAll(int fd, const void *buf, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+    while (len > 0) {
+        ssize_t n = ::send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+void wakeAccept(uint16_t port) {
+    // accept() vågner først når nogen forbinder, så forbind til os selv ved nedlukning
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::close(fd);
+}
+
+// Antal pladeposter i en besked: et JSON-array, en binær samling (0xB1) eller én post
+uint64_t countRecords(const uint8_t *payload, size_t length) {
+    if (length >= 2 && (payload[0] & 0xF0) == 0xB0) {
+        return payload[1];
+    }
+    if (length == 0 || payload[0] != '[') {
+        return 1;
+    }
+    uint64_t count = 0;
+    int depth = 0;
+    bool inString = false;
+    for (size_t i = 0; i < length; i++) {
+        char c = static_cast<char>(payload[i]);
+        if (inString) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '[' || c == '{') {
+            if (c == '{' && depth == 1) {
+                count++;
+            }
+            depth++;
+        } else if (c == ']' || c == '}') {
+            depth--;
+        }
+    }
+    return count;
+}
+
+// En ny plade for hver bil, så enhedens cache af nyligt sete plader ikke slår til
+std::string plateFor(uint64_t seq) {
+    char plate[16];
+    snprintf(plate, sizeof(plate), "%c%03uAA%02u", 'A' + (int)(seq % 26), (unsigned)(seq / 26 % 1000),
+             (unsigned)(seq / 26000 % 100));
+    return plate;
+}
+
+}  // namespace
+
+LocalScanner::LocalScanner() {
+    listenFd_ = listenLoopback(port_);
+    acceptThread_ = std::thread(&LocalScanner::acceptLoop, this);
+}
+
+LocalScanner::~LocalScanner() {
+    running_ = false;
+    wakeAccept(port_);
+    acceptThread_.join();
+    ::close(listenFd_);
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    for (auto &t : clients_) {
+        t.detach();
+    }
+}
+
+void LocalScanner::acceptLoop() {
+    while (running_) {
+        int fd = ::accept(listenFd_, nullptr, nullptr);
+        if (fd < 0 || !running_) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            continue;
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        clients_.emplace_back(&LocalScanner::serve, this, fd);
+    }
+}
+
+void LocalScanner::serve(int fd) {
+    std::string pending;
+    char buf[1024];
+    while (running_) {
+        size_t end = pending.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                break;
+            }
+            pending.append(buf, n);
+            continue;
+        }
+        std::string request = pending.substr(0, end);
+        pending.erase(0, end + 4);
+        requests_++;
+
+        time_t now = time(nullptr);
+        struct tm tmNow;
+        localtime_r(&now, &tmNow);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tmNow);
+        // /get_plates?max=N svarer med N plader, én pr. linje, som om N biler stod i kø
+        std::string body;
+        size_t batch = request.compare(0, 15, "GET /get_plates") == 0 ? 1 : 0;
+        if (batch) {
+            size_t max = request.find("max=");
+            batch = max == std::string::npos ? 8 : std::strtoul(request.c_str() + max + 4, nullptr, 10);
+            for (size_t i = 0; i < batch; i++) {
+                body += plateFor(plates_++) + "," + stamp + "\n";
+            }
+        } else {
+            body = plateFor(plates_++) + "," + stamp;
+        }
+
+        if (responseDelayMs_ > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(responseDelayMs_.load()));
+        }
+
+        bool close = request.find("Connection: close") != std::string::npos;
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: " +
+                               std::to_string(body.size()) + (close ? "\r\nConnection: close" : "") + "\r\n\r\n" +
+                               body;
+        writeAll(fd, response.data(), response.size());
+        if (close) {
+            break;
+        }
+    }
+    ::close(fd);
+}
+
+LocalBroker::LocalBroker() {
+    listenFd_ = listenLoopback(port_);
+    acceptThread_ = std::thread(&LocalBroker::acceptLoop, this);
+}
+
+LocalBroker::~LocalBroker() {
+    running_ = false;
+    wakeAccept(port_);
+    acceptThread_.join();
+    ::close(listenFd_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int fd : clientFds_) {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+    for (auto &t : clients_) {
+        t.detach();
+    }
+}
+
+bool LocalBroker::waitForPublishes(uint64_t count, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return published_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                               [&] { return publishes_.load() >= count; });
+}
+
+bool LocalBroker::waitForRecords(uint64_t count, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return published_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                               [&] { return records_.load() >= count; });
+}
+
+void LocalBroker::setAvailable(bool available) {
+    available_ = available;
+    if (!available) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int fd : clientFds_) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+}
+
+void LocalBroker::acceptLoop() {
+    while (running_) {
+        int fd = ::accept(listenFd_, nullptr, nullptr);
+        if (fd < 0 || !running_) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            continue;
+        }
+        if (!available_) {
+            ::close(fd);
+            continue;
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        std::lock_guard<std::mutex> lock(mutex_);
+        clientFds_.push_back(fd);
+        clients_.emplace_back(&LocalBroker::serve, this, fd);
+    }
+}
+
+void LocalBroker::forward(const uint8_t *topic, size_t topicLength, const uint8_t *payload, size_t length) {
+    std::lock_guard<std::mutex> lock(forwardMutex_);
+    if (subscriberFds_.empty()) {
+        return;
+    }
+    uint8_t header[5];
+    size_t pos = 0;
+    size_t remaining = topicLength + length;
+    header[pos++] = 0x30;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        header[pos++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0);
+    for (int fd : subscriberFds_) {
+        writeAll(fd, header, pos);
+        writeAll(fd, topic, topicLength);
+        writeAll(fd, payload, length);
+    }
+}
+
+void LocalBroker::serve(int fd) {
+    std::vector<uint8_t> body;
+
+    // Forsinkede PUBACK sendes fra en egen tråd i den rækkefølge de blev modtaget
+    struct PendingAck {
+        std::chrono::steady_clock::time_point due;
+        uint8_t packet[4];
+    };
+    std::deque<PendingAck> acks;
+    std::mutex ackMutex;
+    std::condition_variable ackReady;
+    bool open = true;
+    std::thread acker([&] {
+        std::unique_lock<std::mutex> lock(ackMutex);
+        for (;;) {
+            ackReady.wait(lock, [&] { return !acks.empty() || !open; });
+            if (acks.empty()) {
+                return;
+            }
+            if (std::chrono::steady_clock::now() < acks.front().due) {
+                ackReady.wait_until(lock, acks.front().due);
+                continue;
+            }
+            PendingAck ack = acks.front();
+            acks.pop_front();
+            lock.unlock();
+            writeAll(fd, ack.packet, sizeof(ack.packet));
+            lock.lock();
+        }
+    });
+
+    while (running_) {
+        uint8_t header;
+        if (!readExact(fd, &header, 1)) {
+            break;
+        }
+        size_t remaining = 0;
+        size_t multiplier = 1;
+        uint8_t digit;
+        do {
+            if (!readExact(fd, &digit, 1)) {
+                goto done;
+            }
+            remaining += (digit & 0x7F) * multiplier;
+            multiplier *= 128;
+        } while (digit & 0x80);
+        body.resize(remaining);
+        if (remaining > 0 && !readExact(fd, body.data(), remaining)) {
+            break;
+        }
+
+        switch (header >> 4) {
+        case 1: {  // CONNECT
+            uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+            writeAll(fd, connack, sizeof(connack));
+            break;
+        }
+        case 3: {  // PUBLISH
+            uint8_t qos = (header >> 1) & 0x03;
+            size_t topicLength = (body[0] << 8) | body[1];
+            size_t offset = 2 + topicLength;
+            if (qos > 0) {
+                PendingAck ack = {std::chrono::steady_clock::now() + std::chrono::milliseconds(ackDelayMs_),
+                                  {0x40, 0x02, body[offset], body[offset + 1]}};
+                offset += 2;
+                if (ackDelayMs_ > 0) {
+                    std::lock_guard<std::mutex> lock(ackMutex);
+                    acks.push_back(ack);
+                    ackReady.notify_one();
+                } else {
+                    writeAll(fd, ack.packet, sizeof(ack.packet));
+                }
+            }
+            payloadBytes_ += remaining - offset;
+            forward(body.data(), 2 + topicLength, body.data() + offset, remaining - offset);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                publishes_++;
+                records_ += countRecords(body.data() + offset, remaining - offset);
+            }
+            published_.notify_all();
+            break;
+        }
+        case 8: {  // SUBSCRIBE: én bekræftelse med QoS 0 for hvert filter
+            uint8_t suback[8] = {0x90, 0x00, body[0], body[1]};
+            size_t filters = 0;
+            for (size_t pos = 2; pos + 2 < remaining && filters < 4; filters++) {
+                pos += 2 + ((body[pos] << 8) | body[pos + 1]) + 1;
+                suback[4 + filters] = 0x00;
+            }
+            suback[1] = static_cast<uint8_t>(2 + filters);
+            writeAll(fd, suback, 4 + filters);
+            std::lock_guard<std::mutex> lock(forwardMutex_);
+            subscriberFds_.push_back(fd);
+            break;
+        }
+        case 12: {  // PINGREQ
+            uint8_t pingresp[] = {0xD0, 0x00};
+            writeAll(fd, pingresp, sizeof(pingresp));
+            break;
+        }
+        case 14:  // DISCONNECT
+            goto done;
+        default:
+            break;
+        }
+    }
+done:
+    {
+        std::lock_guard<std::mutex> lock(ackMutex);
+        acks.clear();
+        open = false;
+    }
+    ackReady.notify_one();
+    acker.join();
+    {
+        std::lock_guard<std::mutex> lock(forwardMutex_);
+        for (auto it = subscriberFds_.begin(); it != subscriberFds_.end(); ++it) {
+            if (*it == fd) {
+                subscriberFds_.erase(it);
+                break;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = clientFds_.begin(); it != clientFds_.end(); ++it) {
+        if (*it == fd) {
+            clientFds_.erase(it);
+            break;
+        }
+    }
+    ::close(fd);
+}
@@ -0,0 +1,85 @@
+// Lokale stand-ins for pladescanneren og MQTT-brokeren, så målinger kan køre uden netværk
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Svarer på GET /get_plate med "plade,tidsstempel" og på GET /get_plates?max=N med N
+// linjer, ligesom fake_scanner.py. Forbindelser holdes åbne (keep-alive)
+class LocalScanner {
+public:
+    LocalScanner();
+    ~LocalScanner();
+
+    uint16_t port() const { return port_; }
+    uint64_t requests() const { return requests_.load(); }
+
+    // Simuler en langsom genkendelse: vent ms før hvert svar
+    void setResponseDelay(int ms) { responseDelayMs_ = ms; }
+
+private:
+    void acceptLoop();
+    void serve(int fd);
+
+    int listenFd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> running_{true};
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> plates_{0};
+    std::atomic<int> responseDelayMs_{0};
+    std::thread acceptThread_;
+    std::mutex clientsMutex_;
+    std::vector<std::thread> clients_;
+};
+
+// Minimal MQTT 3.1.1-broker: CONNACK, PUBACK (QoS 1), PINGRESP. Tæller modtagne PUBLISH
+// og pladeposterne i dem (en samlet besked fra PayloadBatch indeholder flere).
+// Abonnenter får alle PUBLISH videresendt med QoS 0; emnefiltre ses der bort fra
+class LocalBroker {
+public:
+    LocalBroker();
+    ~LocalBroker();
+
+    uint16_t port() const { return port_; }
+    uint64_t publishes() const { return publishes_.load(); }
+    uint64_t records() const { return records_.load(); }
+    uint64_t payloadBytes() const { return payloadBytes_.load(); }
+
+    // Vent til mindst count PUBLISH/poster er modtaget; returnerer false ved timeout
+    bool waitForPublishes(uint64_t count, int timeoutMs);
+    bool waitForRecords(uint64_t count, int timeoutMs);
+
+    // Simuler udfald: afvis nye forbindelser og luk de eksisterende
+    void setAvailable(bool available);
+
+    // Simuler rundturstiden til en rigtig broker: PUBACK sendes ms efter at PUBLISH er
+    // modtaget, uden at holde de næste PUBLISH tilbage
+    void setAckDelay(int ms) { ackDelayMs_ = ms; }
+
+private:
+    void acceptLoop();
+    void serve(int fd);
+    // Send PUBLISH videre til abonnenterne; topic er med længdefeltet foran
+    void forward(const uint8_t *topic, size_t topicLength, const uint8_t *payload, size_t length);
+
+    int listenFd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> running_{true};
+    std::atomic<bool> available_{true};
+    std::atomic<int> ackDelayMs_{0};
+    std::atomic<uint64_t> publishes_{0};
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> payloadBytes_{0};
+    std::mutex mutex_;
+    std::condition_variable published_;
+    std::thread acceptThread_;
+    std::vector<std::thread> clients_;
+    std::vector<int> clientFds_;
+    std::mutex forwardMutex_; // Skrivning til abonnenterne fra flere forbindelser
+    std::vector<int> subscriberFds_;
+};
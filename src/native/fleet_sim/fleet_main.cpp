@@ -0,0 +1,359 @@
+// Flådesimulator: mange pladelæsere mod én MQTT-broker, til kapacitetstest af modtagersiden
+//
+// Hver simuleret enhed kører firmwarens egen kodning, offline-log og QoS 1-udbakke (se
+// sim_device.h), og en abonnent i samme proces måler hvad der når frem på emnet.
+// Enhederne fordeles på arbejdstråde, som hver kører deres enheder på skift, så tusindvis
+// af enheder kan køre fra én maskine. Miljøvariabler:
+//
+//   FLEET_BROKER=host:port     brokeren (standard: bench'ens lokale stand-in, kun til at prøve værktøjet)
+//   FLEET_DEVICES=100          antal enheder
+//   FLEET_THREADS=0            arbejdstråde (0 = én pr. kerne)
+//   FLEET_DURATION_S=30        så længe der kommer biler; derefter tømmes backloggen
+//   FLEET_DRAIN_S=60           længste ventetid på at alt er kvitteret og modtaget
+//   FLEET_INTERVAL_S=30        gennemsnitlig tid mellem bølger af biler pr. enhed
+//   FLEET_BURST=4              biler pr. bølge (1 til N) med 2 s imellem
+//   FLEET_OUTAGES_PER_H=2      WiFi-udfald pr. enhed i timen
+//   FLEET_OUTAGE_S=20          gennemsnitlig varighed af et udfald (højst det tredobbelte)
+//   FLEET_STORM=start,varighed hele flåden offline (s), derefter genopkobling og tømning på én gang
+//   FLEET_FORMAT=binary|json   payloadformat
+//   FLEET_WINDOW=8             QoS 1-vindue pr. enhed
+//   FLEET_TOPIC=plates/detected
+//   FLEET_SEED=1               samme frø giver samme trafik
+//
+// Fx: FLEET_BROKER=127.0.0.1:1883 FLEET_DEVICES=2000 FLEET_STORM=20,30 .pio/build/fleet_sim/program
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "WiFi.h"
+#include "esp_timer.h"
+#include "local_services.h"
+#include "native_shim.h"
+#include "plate_subscriber.h"
+#include "sim_device.h"
+
+namespace {
+
+const int64_t PROGRESS_INTERVAL_US = 5000000;
+const int64_t SAMPLE_INTERVAL_US = 100000;
+
+// Tal fra én arbejdstråd; opdateres løbende så hovedtråden kan følge med
+struct Worker {
+    std::vector<SimDevice *> devices;
+    std::thread thread;
+    std::atomic<uint64_t> generated{0};
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint32_t> backlog{0};
+    std::atomic<uint32_t> connected{0};
+    std::vector<uint32_t> ackLatencies; // Overtages når tråden stopper
+};
+
+struct Phase {
+    int64_t generateUntilUs = 0;
+    int64_t stormStartUs = INT64_MAX;
+    int64_t stormEndUs = INT64_MAX;
+    std::atomic<bool> stop{false};
+};
+
+double envDouble(const char *name, double defaultValue) {
+    const char *value = getenv(name);
+    return value ? std::atof(value) : defaultValue;
+}
+
+bool parseHostPort(const char *value, std::string &host, uint16_t &port) {
+    if (!value) {
+        return false;
+    }
+    std::string str = value;
+    size_t colon = str.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    host = str.substr(0, colon);
+    port = static_cast<uint16_t>(std::atoi(str.c_str() + colon + 1));
+    return true;
+}
+
+// splitmix64, så nabonumre giver uafhængige frø
+uint64_t seedFor(uint64_t seed, uint32_t id) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (id + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void runWorker(Worker &worker, Phase &phase) {
+    int64_t lastSample = 0;
+    auto sample = [&] {
+        uint64_t generated = 0, published = 0, messages = 0, dropped = 0;
+        uint32_t backlog = 0, connected = 0;
+        for (SimDevice *device : worker.devices) {
+            generated += device->generated;
+            published += device->published;
+            messages += device->messages;
+            dropped += device->dropped();
+            backlog += device->backlog();
+            connected += device->connected();
+        }
+        worker.generated = generated;
+        worker.published = published;
+        worker.messages = messages;
+        worker.dropped = dropped;
+        worker.backlog = backlog;
+        worker.connected = connected;
+    };
+    while (!phase.stop) {
+        int64_t nowUs = esp_timer_get_time();
+        bool generate = nowUs < phase.generateUntilUs;
+        bool storm = nowUs >= phase.stormStartUs && nowUs < phase.stormEndUs;
+        bool busy = false;
+        for (SimDevice *device : worker.devices) {
+            busy |= device->step(nowUs, generate, storm);
+        }
+        if (nowUs - lastSample >= SAMPLE_INTERVAL_US) {
+            sample();
+            lastSample = nowUs;
+        }
+        if (!busy) {
+            usleep(1000);
+        }
+    }
+    sample();
+    worker.ackLatencies.swap(SimDevice::threadAckLatencies());
+}
+
+double percentileMs(const std::vector<uint32_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))] / 1000.0;
+}
+
+// Hver enhed har to åbne segmentfiler og en socket; hæv grænsen til det tilladte
+void raiseFileLimit(uint32_t devices) {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    rlim_t needed = (rlim_t)devices * 3 + 64;
+    if (limit.rlim_cur < needed) {
+        std::fprintf(stderr, "Advarsel: %llu filhåndtag tilladt, %llu behøves (ulimit -n).\n",
+                     (unsigned long long)limit.rlim_cur, (unsigned long long)needed);
+    }
+}
+
+}  // namespace
+
+int main() {
+    FleetConfig config;
+    config.devices = (uint32_t)envDouble("FLEET_DEVICES", config.devices);
+    config.threads = (uint32_t)envDouble("FLEET_THREADS", config.threads);
+    config.durationS = (uint32_t)envDouble("FLEET_DURATION_S", config.durationS);
+    config.drainS = (uint32_t)envDouble("FLEET_DRAIN_S", config.drainS);
+    config.burstIntervalS = envDouble("FLEET_INTERVAL_S", config.burstIntervalS);
+    config.burstMax = (uint32_t)envDouble("FLEET_BURST", config.burstMax);
+    config.outagesPerHour = envDouble("FLEET_OUTAGES_PER_H", config.outagesPerHour);
+    config.outageS = envDouble("FLEET_OUTAGE_S", config.outageS);
+    config.window = (uint8_t)envDouble("FLEET_WINDOW", config.window);
+    if (getenv("FLEET_TOPIC")) {
+        config.topic = getenv("FLEET_TOPIC");
+    }
+    if (getenv("FLEET_FORMAT") && std::string(getenv("FLEET_FORMAT")) == "json") {
+        config.format = PAYLOAD_JSON;
+    }
+    if (getenv("FLEET_STORM")) {
+        unsigned start = 0, length = 0;
+        std::sscanf(getenv("FLEET_STORM"), "%u,%u", &start, &length);
+        config.stormAtS = start;
+        config.stormS = length;
+    }
+    if (config.threads == 0) {
+        config.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    config.threads = std::min(config.threads, std::max(1u, config.devices));
+    uint64_t seed = (uint64_t)envDouble("FLEET_SEED", 1);
+
+    // Offline-loggene i RAM når det kan lade sig gøre; tusindvis af enheder skriver samtidig
+    char fsRoot[] = "/dev/shm/fleet_sim_XXXXXX";
+    char tmpRoot[] = "/tmp/fleet_sim_XXXXXX";
+    const char *root = mkdtemp(fsRoot);
+    if (!root) {
+        root = mkdtemp(tmpRoot);
+    }
+    nativeshim::setFsRoot(root);
+    LittleFS.begin(true);
+    nativeshim::setSerialQuiet(true);
+    raiseFileLimit(config.devices);
+    WiFi.begin("fleet"); // MqttConnection forbinder kun med WiFi oppe; udfald simuleres pr. enhed
+
+    std::unique_ptr<LocalBroker> localBroker;
+    if (!parseHostPort(getenv("FLEET_BROKER"), config.host, config.port)) {
+        localBroker.reset(new LocalBroker());
+        config.host = "127.0.0.1";
+        config.port = localBroker->port();
+        std::printf("Ingen FLEET_BROKER: bruger den lokale stand-in (tallene siger ikke noget om en rigtig broker).\n");
+    }
+
+    PlateSubscriber subscriber(config.devices);
+    if (!subscriber.begin(config.host, config.port, config.topic)) {
+        std::fprintf(stderr, "Kunne ikke abonnere på %s hos %s:%u.\n", config.topic.c_str(), config.host.c_str(),
+                     (unsigned)config.port);
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<SimDevice>> devices;
+    std::vector<Worker> workers(config.threads);
+    for (uint32_t id = 0; id < config.devices; id++) {
+        devices.emplace_back(new SimDevice(id, config, seedFor(seed, id)));
+        if (!devices.back()->begin(LittleFS)) {
+            std::fprintf(stderr, "Kunne ikke åbne offline-loggen for enhed %u.\n", (unsigned)id);
+            return 1;
+        }
+        workers[id % config.threads].devices.push_back(devices.back().get());
+    }
+
+    std::printf("Flådesimulering: %u enheder i %u tråde mod %s:%u, %s, vindue %u, %u s trafik\n",
+                (unsigned)config.devices, (unsigned)config.threads, config.host.c_str(), (unsigned)config.port,
+                config.format == PAYLOAD_JSON ? "json" : "binary", (unsigned)config.window,
+                (unsigned)config.durationS);
+    Phase phase;
+    int64_t startUs = esp_timer_get_time();
+    phase.generateUntilUs = startUs + config.durationS * 1000000LL;
+    if (config.stormS > 0) {
+        phase.stormStartUs = startUs + config.stormAtS * 1000000LL;
+        phase.stormEndUs = phase.stormStartUs + config.stormS * 1000000LL;
+    }
+    for (Worker &worker : workers) {
+        worker.thread = std::thread(runWorker, std::ref(worker), std::ref(phase));
+    }
+
+    // Følg med til trafikken er slut og alt er tømt og modtaget, eller tømningen løber ud
+    uint64_t generated = 0, published = 0, messages = 0, dropped = 0;
+    uint32_t backlog = 0, connected = 0, peakBacklog = 0;
+    int64_t lastProgress = startUs;
+    // Højeste rate over et helt sekund, sendt og modtaget
+    int64_t windowStartUs = startUs;
+    uint64_t windowPublished = 0, windowReceived = 0;
+    double peakPublished = 0, peakReceived = 0;
+    int64_t drainDeadline = phase.generateUntilUs + config.drainS * 1000000LL;
+    int64_t doneUs = 0;
+    for (;;) {
+        usleep(SAMPLE_INTERVAL_US);
+        int64_t nowUs = esp_timer_get_time();
+        generated = published = messages = dropped = 0;
+        backlog = connected = 0;
+        for (Worker &worker : workers) {
+            generated += worker.generated;
+            published += worker.published;
+            messages += worker.messages;
+            dropped += worker.dropped;
+            backlog += worker.backlog;
+            connected += worker.connected;
+        }
+        peakBacklog = std::max(peakBacklog, backlog);
+        if (nowUs - windowStartUs >= 1000000) {
+            double window = (nowUs - windowStartUs) / 1e6;
+            peakPublished = std::max(peakPublished, (published - windowPublished) / window);
+            peakReceived = std::max(peakReceived, (subscriber.unique() - windowReceived) / window);
+            windowStartUs = nowUs;
+            windowPublished = published;
+            windowReceived = subscriber.unique();
+        }
+        if (nowUs - lastProgress >= PROGRESS_INTERVAL_US) {
+            std::printf("%4.0f s: %llu bevægelser, %llu sendt, %llu modtaget, backlog %u, forbundet %u/%u\n",
+                        (nowUs - startUs) / 1e6, (unsigned long long)generated, (unsigned long long)published,
+                        (unsigned long long)subscriber.unique(), (unsigned)backlog, (unsigned)connected,
+                        (unsigned)config.devices);
+            std::fflush(stdout);
+            lastProgress = nowUs;
+        }
+        if (nowUs >= phase.generateUntilUs && backlog == 0 && subscriber.unique() + dropped >= generated) {
+            doneUs = nowUs;
+            break;
+        }
+        if (nowUs >= drainDeadline) {
+            std::printf("Tømningen nåede ikke at blive færdig på %u s.\n", (unsigned)config.drainS);
+            doneUs = nowUs;
+            break;
+        }
+    }
+
+    phase.stop = true;
+    std::vector<uint32_t> acks;
+    generated = published = messages = dropped = 0;
+    for (Worker &worker : workers) {
+        worker.thread.join();
+        generated += worker.generated;
+        published += worker.published;
+        messages += worker.messages;
+        dropped += worker.dropped;
+        acks.insert(acks.end(), worker.ackLatencies.begin(), worker.ackLatencies.end());
+    }
+    usleep(200000); // De sidste videresendelser fra brokeren
+    subscriber.stop();
+
+    uint64_t attempts = 0, resends = 0, outages = 0;
+    uint32_t maxBacklog = 0, silentDevices = 0, pending = 0;
+    for (uint32_t id = 0; id < config.devices; id++) {
+        SimDevice &device = *devices[id];
+        attempts += device.attempts();
+        resends += device.resends();
+        outages += device.outages;
+        maxBacklog = std::max(maxBacklog, device.maxBacklog);
+        pending += device.backlog();
+        if (device.generated > 0 && subscriber.received(id) < device.generated) {
+            silentDevices++;
+        }
+        device.end();
+    }
+    std::filesystem::remove_all(root);
+
+    double seconds = (doneUs - startUs) / 1e6;
+    int64_t missing = (int64_t)generated - (int64_t)subscriber.unique();
+    std::vector<uint32_t> &latencies = subscriber.latencies();
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(acks.begin(), acks.end());
+
+    std::printf("\nTrafik: %llu bevægelser på %u s (%.1f/s), færdig efter %.1f s\n", (unsigned long long)generated,
+                (unsigned)config.durationS, generated / (double)std::max(1u, config.durationS), seconds);
+    std::printf("Sendt: %llu poster i %llu beskeder (%.1f poster/s, %.1f beskeder/s), %llu genudsendt\n",
+                (unsigned long long)published, (unsigned long long)messages, published / seconds, messages / seconds,
+                (unsigned long long)resends);
+    std::printf("Højeste sekund: %.0f poster sendt, %.0f modtaget\n", peakPublished, peakReceived);
+    std::printf("Forbindelse: %llu forsøg, %llu udfald; backlog størst %u samlet, %u på én enhed\n",
+                (unsigned long long)attempts, (unsigned long long)outages, (unsigned)peakBacklog,
+                (unsigned)maxBacklog);
+    std::printf("Modtaget: %llu unikke i %llu beskeder, %llu dubletter, %llu uafkodelige\n",
+                (unsigned long long)subscriber.unique(), (unsigned long long)subscriber.messages(),
+                (unsigned long long)subscriber.duplicates(), (unsigned long long)subscriber.undecoded());
+    // Poster der stadig ligger i en backlog er forsinkede, ikke tabt; overskrevne er tabt på enheden
+    std::printf("Ikke modtaget: %lld (%.3f%%) fra %u enheder; %u ligger stadig i backloggen, %llu er overskrevet "
+                "i offline-loggen\n",
+                (long long)missing, generated ? 100.0 * missing / generated : 0.0, (unsigned)silentDevices,
+                (unsigned)pending, (unsigned long long)dropped);
+    std::printf("Latens bevægelse->abonnent (ms): p50 %.1f  p95 %.1f  p99 %.1f  p99.9 %.1f  maks %.1f\n",
+                percentileMs(latencies, 0.50), percentileMs(latencies, 0.95), percentileMs(latencies, 0.99),
+                percentileMs(latencies, 0.999), percentileMs(latencies, 1.0));
+    std::printf("Kvittering publish->PUBACK (ms): p50 %.1f  p99 %.1f  maks %.1f\n", percentileMs(acks, 0.50),
+                percentileMs(acks, 0.99), percentileMs(acks, 1.0));
+
+    std::fflush(stdout);
+    std::_Exit(0); // Brokerens stand-in har tråde der ikke kan stoppes pænt
+}
@@ -0,0 +1,298 @@
+#include "plate_subscriber.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "event_queue.h"
+#include "payload_codec.h"
+#include "sim_device.h"
+
+namespace {
+
+const uint16_t KEEPALIVE_S = 60;
+
+int64_t wallClockUs() {
+    timeval now;
+    gettimeofday(&now, nullptr);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+// "YYYY-MM-DDTHH:MM:SS.ffffff" i UTC, som SimDevice skriver det
+bool parseTimestamp(const char *text, int64_t &us) {
+    tm utc = {};
+    unsigned micros = 0;
+    if (sscanf(text, "%4d-%2d-%2dT%2d:%2d:%2d.%6u", &utc.tm_year, &utc.tm_mon, &utc.tm_mday, &utc.tm_hour, &utc.tm_min,
+               &utc.tm_sec, &micros) != 7) {
+        return false;
+    }
+    utc.tm_year -= 1900;
+    utc.tm_mon -= 1;
+    us = (int64_t)timegm(&utc) * 1000000 + micros;
+    return true;
+}
+
+// Find "key":"værdi" fra p og frem; p flyttes forbi værdien
+bool jsonString(const char *&p, const char *end, const char *key, char *out, size_t size) {
+    size_t keyLength = strlen(key);
+    const char *found = std::search(p, end, key, key + keyLength);
+    if (found == end) {
+        return false;
+    }
+    const char *value = found + keyLength;
+    const char *close = std::find(value, end, '"');
+    if (close == end || (size_t)(close - value) >= size) {
+        return false;
+    }
+    memcpy(out, value, close - value);
+    out[close - value] = '\0';
+    p = close + 1;
+    return true;
+}
+
+bool readExact(int fd, uint8_t *buffer, size_t length) {
+    size_t got = 0;
+    while (got < length) {
+        ssize_t n = ::recv(fd, buffer + got, length - got, 0);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool PlateSubscriber::writePacket(uint8_t header, const uint8_t *body, size_t length) {
+    uint8_t packet[512];
+    size_t pos = 0;
+    packet[pos++] = header;
+    size_t remaining = length;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        packet[pos++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0);
+    if (pos + length > sizeof(packet)) {
+        return false;
+    }
+    if (length > 0) {
+        memcpy(packet + pos, body, length);
+        pos += length;
+    }
+    return ::send(fd, packet, pos, MSG_NOSIGNAL) == (ssize_t)pos;
+}
+
+bool PlateSubscriber::begin(const std::string &host, uint16_t port, const std::string &topic) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+        return false;
+    }
+    fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    bool connected = ::connect(fd, result->ai_addr, result->ai_addrlen) == 0;
+    freeaddrinfo(result);
+    if (!connected) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // CONNECT med ren session, derefter SUBSCRIBE med QoS 1 så brokeren ikke taber noget til os
+    const char *clientId = "fleet-sim-subscriber";
+    uint8_t body[256];
+    size_t pos = 0;
+    const uint8_t header[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, KEEPALIVE_S >> 8, KEEPALIVE_S & 0xFF};
+    memcpy(body, header, sizeof(header));
+    pos = sizeof(header);
+    body[pos++] = 0;
+    body[pos++] = (uint8_t)strlen(clientId);
+    memcpy(body + pos, clientId, strlen(clientId));
+    pos += strlen(clientId);
+    uint8_t connack[4];
+    if (!writePacket(0x10, body, pos) || !readExact(fd, connack, sizeof(connack)) || connack[0] != 0x20 ||
+        connack[3] != 0) {
+        stop();
+        return false;
+    }
+
+    pos = 0;
+    body[pos++] = 0;
+    body[pos++] = 1;
+    body[pos++] = topic.size() >> 8;
+    body[pos++] = topic.size() & 0xFF;
+    memcpy(body + pos, topic.data(), topic.size());
+    pos += topic.size();
+    body[pos++] = 1;
+    uint8_t suback[5];
+    if (!writePacket(0x82, body, pos) || !readExact(fd, suback, sizeof(suback)) || suback[0] != 0x90 ||
+        suback[4] == 0x80) {
+        stop();
+        return false;
+    }
+
+    running = true;
+    thread = std::thread(&PlateSubscriber::run, this);
+    return true;
+}
+
+void PlateSubscriber::stop() {
+    if (running.exchange(false)) {
+        thread.join();
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+uint32_t PlateSubscriber::received(uint32_t device) const {
+    return device < seen.size() ? (uint32_t)std::count(seen[device].begin(), seen[device].end(), true) : 0;
+}
+
+void PlateSubscriber::run() {
+    std::vector<uint8_t> buffer(1 << 16);
+    size_t filled = 0;
+    time_t lastPing = time(nullptr);
+    while (running) {
+        if (time(nullptr) - lastPing >= KEEPALIVE_S / 2) {
+            writePacket(0xC0, nullptr, 0);
+            lastPing = time(nullptr);
+        }
+        pollfd waiting = {fd, POLLIN, 0};
+        if (::poll(&waiting, 1, 100) <= 0) {
+            continue;
+        }
+        if (filled == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        ssize_t n = ::recv(fd, buffer.data() + filled, buffer.size() - filled, 0);
+        if (n <= 0) {
+            std::fprintf(stderr, "Abonnementet mistede forbindelsen til brokeren.\n");
+            break;
+        }
+        filled += n;
+
+        // Behandl alle hele pakker i bufferen; en halv pakke venter på resten
+        size_t pos = 0;
+        while (pos + 2 <= filled) {
+            size_t remaining = 0;
+            size_t multiplier = 1;
+            size_t at = pos + 1;
+            bool complete = false;
+            while (at < filled) {
+                uint8_t digit = buffer[at++];
+                remaining += (digit & 0x7F) * multiplier;
+                multiplier *= 128;
+                if (!(digit & 0x80)) {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete || at + remaining > filled) {
+                break;
+            }
+            if ((buffer[pos] >> 4) == 3) {
+                handlePublish(buffer[pos], buffer.data() + at, remaining);
+            }
+            pos = at + remaining;
+        }
+        memmove(buffer.data(), buffer.data() + pos, filled - pos);
+        filled -= pos;
+    }
+}
+
+void PlateSubscriber::handlePublish(uint8_t header, const uint8_t *body, size_t length) {
+    int64_t nowUs = wallClockUs();
+    uint8_t qos = (header >> 1) & 0x03;
+    size_t offset = 2 + ((body[0] << 8) | body[1]);
+    if (qos > 0) {
+        uint8_t puback[] = {body[offset], body[offset + 1]};
+        writePacket(0x40, puback, sizeof(puback));
+        offset += 2;
+    }
+    if (offset > length) {
+        undecoded_++;
+        return;
+    }
+    messages_++;
+    handlePayload(body + offset, length - offset, nowUs);
+}
+
+void PlateSubscriber::handlePayload(const uint8_t *payload, size_t length, int64_t nowUs) {
+    if (length == 0) {
+        undecoded_++;
+        return;
+    }
+    PlateReading reading;
+    if ((payload[0] & 0xF0) == PAYLOAD_BATCH_MARKER && length >= 2) {
+        const uint8_t *p = payload + 2;
+        const uint8_t *end = payload + length;
+        for (uint8_t i = 0; i < payload[1] && p < end; i++) {
+            size_t recordLength = *p++;
+            if (p + recordLength > end || !decodeBinary(p, recordLength, reading)) {
+                undecoded_++;
+                return;
+            }
+            handleRecord(reading.plate, reading.timestamp, nowUs);
+            p += recordLength;
+        }
+    } else if ((payload[0] & 0xF0) == PAYLOAD_BINARY_MARKER) {
+        if (decodeBinary(payload, length, reading)) {
+            handleRecord(reading.plate, reading.timestamp, nowUs);
+        } else {
+            undecoded_++;
+        }
+    } else {
+        // JSON: ét objekt eller et array af dem fra PayloadBatch
+        const char *p = (const char *)payload;
+        const char *end = p + length;
+        bool any = false;
+        while (jsonString(p, end, "\"plate\":\"", reading.plate, sizeof(reading.plate)) &&
+               jsonString(p, end, "\"timestamp\":\"", reading.timestamp, sizeof(reading.timestamp))) {
+            handleRecord(reading.plate, reading.timestamp, nowUs);
+            any = true;
+        }
+        if (!any) {
+            undecoded_++;
+        }
+    }
+}
+
+void PlateSubscriber::handleRecord(const char *plate, const char *timestamp, int64_t nowUs) {
+    uint32_t device, seq;
+    if (!SimDevice::parsePlate(plate, device, seq) || device >= seen.size()) {
+        undecoded_++;
+        return;
+    }
+    records_++;
+    std::vector<bool> &received = seen[device];
+    if (seq >= received.size()) {
+        received.resize(std::max<size_t>(seq + 1, received.size() * 2));
+    }
+    if (received[seq]) {
+        return;
+    }
+    received[seq] = true;
+    unique_++;
+    int64_t captureUs;
+    if (parseTimestamp(timestamp, captureUs)) {
+        latencies_.push_back((uint32_t)std::max<int64_t>(0, nowUs - captureUs));
+    }
+}
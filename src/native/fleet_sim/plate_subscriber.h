@@ -0,0 +1,50 @@
+// Modtagersiden i flådesimulatoren: abonnerer på pladeemnet og måler latens og tab
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Én MQTT-forbindelse med QoS 1-abonnement, læst i sin egen tråd.
+//
+// Alle formater fra payload_codec.h afkodes (JSON, binær og samlinger af begge). Pladen
+// fortæller enhed og løbenummer (SimDevice::parsePlate); gentagelser efter genudsendelse
+// tælles som dubletter, og latensen er fra tidsstemplet til modtagelsen.
+class PlateSubscriber {
+public:
+    explicit PlateSubscriber(uint32_t devices) : seen(devices) {}
+    ~PlateSubscriber() { stop(); }
+
+    bool begin(const std::string &host, uint16_t port, const std::string &topic);
+    void stop();
+
+    uint64_t messages() const { return messages_.load(); }
+    uint64_t records() const { return records_.load(); }
+    uint64_t unique() const { return unique_.load(); }
+    uint64_t duplicates() const { return records_.load() - unique_.load(); }
+    uint64_t undecoded() const { return undecoded_.load(); }
+
+    // Unikke poster modtaget fra enheden (kaldes efter stop())
+    uint32_t received(uint32_t device) const;
+    // Latens fra bevægelse til modtagelse i mikrosekunder, for unikke poster (efter stop())
+    std::vector<uint32_t> &latencies() { return latencies_; }
+
+private:
+    void run();
+    bool writePacket(uint8_t header, const uint8_t *body, size_t length);
+    void handlePublish(uint8_t header, const uint8_t *body, size_t length);
+    void handleRecord(const char *plate, const char *timestamp, int64_t nowUs);
+    void handlePayload(const uint8_t *payload, size_t length, int64_t nowUs);
+
+    int fd = -1;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> messages_{0};
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> unique_{0};
+    std::atomic<uint64_t> undecoded_{0};
+    std::vector<std::vector<bool>> seen; // Pr. enhed: løbenumre der er modtaget
+    std::vector<uint32_t> latencies_;
+};
@@ -0,0 +1,143 @@
+#include "sim_device.h"
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+#include "Arduino.h"
+#include "esp_timer.h"
+
+namespace {
+
+const uint8_t LANES = 4;
+
+thread_local std::vector<uint32_t> ackLatencies;
+
+void recordAck(uint32_t latencyUs) { ackLatencies.push_back(latencyUs); }
+
+int64_t wallClockUs() {
+    timeval now;
+    gettimeofday(&now, nullptr);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+}  // namespace
+
+std::vector<uint32_t> &SimDevice::threadAckLatencies() { return ackLatencies; }
+
+SimDevice::SimDevice(uint32_t id, const FleetConfig &config, uint64_t seed)
+    : config(config), id(id), rng(seed), mqtt(client), connection(mqtt, clientId), outbox(client),
+      sender(mqtt, connection, outbox, log, config.topic.c_str(), batchBuffer, sizeof(batchBuffer)) {
+    snprintf(clientId, sizeof(clientId), "fleet-sim-%05u", (unsigned)id);
+    snprintf(dir, sizeof(dir), "/d%05u", (unsigned)id);
+}
+
+bool SimDevice::begin(fs::FS &fs) {
+    client.setTimeout(MQTT_CONNECT_TIMEOUT_S);
+    mqtt.setServer(config.host.c_str(), config.port);
+    outbox.onAck(recordAck);
+    sender.configure(config.window, MQTT_ACK_TIMEOUT_MS);
+
+    // Enhederne starter spredt over den første bølgeafstand, som en flåde der allerede kører
+    std::uniform_real_distribution<double> start(0, config.burstIntervalS * 1e6);
+    int64_t nowUs = esp_timer_get_time();
+    nextMotionUs = nowUs + (int64_t)start(rng);
+    nextOutageUs = config.outagesPerHour > 0 ? nowUs + exponentialUs(3600 / config.outagesPerHour) : INT64_MAX;
+    if (!log.begin(fs, dir)) {
+        return false;
+    }
+    outbox.reset(log.oldestSeq());
+    return true;
+}
+
+void SimDevice::end() {
+    mqtt.disconnect();
+    log.end();
+}
+
+int64_t SimDevice::exponentialUs(double meanS) {
+    std::exponential_distribution<double> wait(1 / meanS);
+    return (int64_t)(wait(rng) * 1e6);
+}
+
+bool SimDevice::parsePlate(const char *plate, uint32_t &device, uint32_t &seq) {
+    unsigned d, s;
+    if (sscanf(plate, "D%5uN%8u", &d, &s) != 2) {
+        return false;
+    }
+    device = d;
+    seq = s;
+    return true;
+}
+
+// Som sendToMQTT: kod pladen og gem den i offline-loggen; afsendelsen sker i drain()
+void SimDevice::motion() {
+    int64_t us = wallClockUs();
+    time_t seconds = (time_t)(us / 1000000);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+
+    PlateReading reading;
+    snprintf(reading.plate, sizeof(reading.plate), "D%05uN%08u", (unsigned)id, (unsigned)generated);
+    size_t written = strftime(reading.timestamp, sizeof(reading.timestamp), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(reading.timestamp + written, sizeof(reading.timestamp) - written, ".%06u", (unsigned)(us % 1000000));
+    reading.captureUs = us;
+    reading.lane = (uint8_t)(rng() % LANES);
+    generated++;
+
+    uint8_t payload[OfflineLog::PAYLOAD_SIZE];
+    size_t length = encodePayload(config.format, reading, payload, sizeof(payload));
+    if (length > 0) {
+        log.append(payload, length);
+    }
+    if (log.size() > maxBacklog) {
+        maxBacklog = log.size();
+    }
+}
+
+bool SimDevice::step(int64_t nowUs, bool generate, bool fleetOutage) {
+    bool busy = false;
+    if (generate && nowUs >= nextMotionUs) {
+        motion();
+        if (burstLeft > 0) {
+            burstLeft--;
+            nextMotionUs = nowUs + config.burstGapMs * 1000LL;
+        } else {
+            burstLeft = (uint32_t)(rng() % (config.burstMax > 0 ? config.burstMax : 1));
+            nextMotionUs = nowUs + exponentialUs(config.burstIntervalS);
+        }
+        busy = true;
+    }
+
+    // Nye udfald kun mens der er trafik, så tømningen til sidst kan blive færdig
+    if (generate && nowUs >= nextOutageUs) {
+        // Højst tre gange middelværdien, så den lange hale ikke løber forbi tømningen
+        int64_t outageUs = std::min<int64_t>(exponentialUs(config.outageS), (int64_t)(3 * config.outageS * 1e6));
+        outageUntilUs = nowUs + outageUs;
+        nextOutageUs = outageUntilUs + exponentialUs(3600 / config.outagesPerHour);
+    }
+    bool down = fleetOutage || nowUs < outageUntilUs;
+    if (down) {
+        if (!offline) {
+            // Radioen er væk: forbindelsen lukkes uden DISCONNECT, og alt ukvitteret sendes igen
+            client.stop();
+            outbox.reset(log.oldestSeq());
+            outages++;
+            offline = true;
+        }
+        return busy;
+    }
+    offline = false;
+
+    // Som serviceMqtt og sendSavedData i main.cpp; loggen er kun enhedens egen, så uden lås
+    uint32_t oldest = log.oldestSeq();
+    if (!sender.service()) {
+        return busy;
+    }
+    published += sender.send(DRAIN_BUDGET_MS);
+    busy = busy || log.oldestSeq() != oldest || sender.messages() != messages;
+    messages = sender.messages();
+    return busy;
+}
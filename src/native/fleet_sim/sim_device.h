@@ -0,0 +1,101 @@
+// Én simuleret pladelæser i flådesimulatoren
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FS.h"
+#include "PubSubClient.h"
+#include "WiFiClient.h"
+#include "backlog_sender.h"
+#include "mqtt_connection.h"
+#include "mqtt_outbox.h"
+#include "offline_log.h"
+#include "payload_codec.h"
+
+// Indstillinger for hele flåden (se fleet_main.cpp for miljøvariablerne)
+struct FleetConfig {
+    std::string host = "127.0.0.1";
+    uint16_t port = 1883;
+    std::string topic = "plates/detected"; // mqttTopic i main.cpp
+    uint32_t devices = 100;
+    uint32_t threads = 0; // 0 = én pr. kerne
+    uint32_t durationS = 30; // Så længe der kommer biler; derefter tømmes backloggen
+    uint32_t drainS = 60; // Længste ventetid på at alt er kvitteret og modtaget
+    double burstIntervalS = 30; // Gennemsnitlig tid mellem bølger af biler pr. enhed
+    uint32_t burstMax = 4; // Biler pr. bølge, 1 til burstMax
+    uint32_t burstGapMs = 2000; // Mellem bilerne i en bølge (DEBOUNCE_DELAY_MS i main.cpp)
+    double outagesPerHour = 2; // Enhedens egne WiFi-udfald
+    double outageS = 20; // Gennemsnitlig varighed af et udfald (højst det tredobbelte)
+    uint32_t stormAtS = 0; // Hele flåden mister forbindelsen her (0 = aldrig) ...
+    uint32_t stormS = 0; // ... så længe, og forbinder og tømmer derefter samtidig
+    PayloadFormat format = PAYLOAD_BINARY;
+    uint8_t window = MQTT_WINDOW;
+};
+
+// Som firmwaren: hver bevægelse kodes og gemmes i offline-loggen, og loggen sendes af
+// samme BacklogSender, så samlinger, udfald og genudsendelse følger samme vej.
+// Scanneren springes over; pladen er enhedens nummer og et løbenummer, og tidsstemplet
+// er vægur-tiden for bevægelsen i UTC, så modtageren kan måle latens og finde tab.
+// Hvert gennemløb af step() blokerer kun ved oprettelse af forbindelsen, så én tråd
+// kan drive hundredvis af enheder.
+class SimDevice {
+public:
+    SimDevice(uint32_t id, const FleetConfig &config, uint64_t seed);
+    SimDevice(const SimDevice &) = delete;
+    SimDevice &operator=(const SimDevice &) = delete;
+
+    bool begin(fs::FS &fs);
+    void end();
+
+    // Ét gennemløb ved nowUs (esp_timer-tid): bevægelser, udfald og afsendelse.
+    // generate = false stopper nye biler og udfald; fleetOutage er et udfald for hele flåden.
+    // Returnerer true hvis der skete noget
+    bool step(int64_t nowUs, bool generate, bool fleetOutage);
+
+    bool connected() { return client.connected(); }
+    bool drained() const { return log.size() == 0; }
+    uint32_t backlog() const { return log.size(); }
+
+    // Kvitteringstider i mikrosekunder fra enhederne i den kaldende tråd
+    static std::vector<uint32_t> &threadAckLatencies();
+
+    uint32_t generated = 0; // Bevægelser
+    uint32_t published = 0; // Poster sendt (inkl. genudsendelser)
+    uint32_t messages = 0; // PUBLISH-beskeder
+    uint32_t outages = 0;
+    uint32_t maxBacklog = 0;
+
+    uint32_t attempts() const { return connection.attempts(); }
+    uint32_t resends() const { return outbox.resends(); }
+    uint32_t dropped() const { return log.dropped(); }
+
+    // "D00042N00001234": enhed og løbenummer
+    static bool parsePlate(const char *plate, uint32_t &device, uint32_t &seq);
+
+private:
+    void motion();
+    int64_t exponentialUs(double meanS);
+
+    const FleetConfig &config;
+    uint32_t id;
+    char clientId[24];
+    char dir[16];
+    std::mt19937_64 rng;
+
+    WiFiClient client;
+    PubSubClient mqtt;
+    MqttConnection connection;
+    MqttOutbox outbox;
+    OfflineLog log;
+    uint8_t batchBuffer[MQTT_BATCH_BYTES];
+    BacklogSender sender;
+
+    int64_t nextMotionUs = 0;
+    uint32_t burstLeft = 0;
+    int64_t outageUntilUs = 0;
+    int64_t nextOutageUs = 0;
+    bool offline = false;
+};
@@ -0,0 +1,194 @@
+// Host-udgave af ESPAsyncWebServer; handlere registreres men der lyttes ikke på nogen port
+#pragma once
+
+#include <strings.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+#include "FS.h"
+
+typedef enum { HTTP_GET = 0b00000001, HTTP_POST = 0b00000010, HTTP_ANY = 0b01111111 } WebRequestMethod;
+
+class AsyncWebParameter {
+public:
+    AsyncWebParameter(const String &name, const String &value) : name_(name), value_(value) {}
+    const String &name() const { return name_; }
+    const String &value() const { return value_; }
+
+private:
+    String name_;
+    String value_;
+};
+
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+// Svar med statuskode, headere og indhold. Chunked svar hentes først i content()
+class AsyncWebServerResponse {
+public:
+    AsyncWebServerResponse(int code, const String &contentType) : code_(code), contentType_(contentType) {}
+
+    void addHeader(const String &name, const String &value) { headers_.emplace_back(name, value); }
+
+    int code() const { return code_; }
+    const String &contentType() const { return contentType_; }
+    // Tom hvis headeren ikke er sat
+    String header(const char *name) const {
+        for (auto &header : headers_) {
+            if (strcasecmp(header.first.c_str(), name) == 0) {
+                return header.second;
+            }
+        }
+        return String();
+    }
+    bool chunked() const { return static_cast<bool>(filler_); }
+
+    // Hele indholdet; et chunked svar hentes i bidder af højst chunkSize som over TCP
+    std::string content(size_t chunkSize = 1436) {
+        if (!filler_) {
+            return body_;
+        }
+        std::string out;
+        std::vector<uint8_t> chunk(chunkSize);
+        size_t length;
+        while ((length = filler_(chunk.data(), chunkSize, out.size())) > 0) {
+            out.append(reinterpret_cast<const char *>(chunk.data()), length);
+        }
+        return out;
+    }
+
+    void setBody(std::string body) { body_ = std::move(body); }
+    void setFiller(AwsResponseFiller filler) { filler_ = std::move(filler); }
+
+private:
+    int code_;
+    String contentType_;
+    std::vector<std::pair<String, String>> headers_;
+    std::string body_;
+    AwsResponseFiller filler_;
+};
+
+class AsyncWebServerRequest {
+public:
+    int params() const { return static_cast<int>(params_.size()); }
+    AsyncWebParameter *getParam(int index) { return &params_[index]; }
+    void addParam(const String &name, const String &value) { params_.emplace_back(name, value); }
+
+    bool hasHeader(const String &name) const { return findHeader(name.c_str()) != nullptr; }
+    const String &header(const char *name) const {
+        static const String empty;
+        const AsyncWebParameter *header = findHeader(name);
+        return header ? header->value() : empty;
+    }
+    void addHeader(const String &name, const String &value) { headers_.emplace_back(name, value); }
+
+    AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(),
+                                          const String &content = String()) {
+        AsyncWebServerResponse *response = new AsyncWebServerResponse(code, contentType);
+        response->setBody(content.c_str());
+        return response;
+    }
+    // Som biblioteket: findes kun path + ".gz", sendes den med Content-Encoding: gzip
+    AsyncWebServerResponse *beginResponse(FS &fs, const String &path, const String &contentType = String(),
+                                          bool download = false) {
+        String file = path;
+        bool gzip = !download && !fs.exists(path) && fs.exists(path + ".gz");
+        if (gzip) {
+            file = path + ".gz";
+        }
+        File source = fs.open(file, FILE_READ);
+        if (!source) {
+            return beginResponse(404);
+        }
+        AsyncWebServerResponse *response = new AsyncWebServerResponse(200, contentType);
+        if (gzip) {
+            response->addHeader("Content-Encoding", "gzip");
+        }
+        std::string body(source.size(), '\0');
+        body.resize(source.read(reinterpret_cast<uint8_t *>(&body[0]), body.size()));
+        response->setBody(std::move(body));
+        return response;
+    }
+    AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller filler) {
+        AsyncWebServerResponse *response = new AsyncWebServerResponse(200, contentType);
+        response->setFiller(std::move(filler));
+        return response;
+    }
+    void send(AsyncWebServerResponse *response) {
+        this->response.reset(response);
+        responseCode = response->code();
+        responseType = response->contentType();
+        if (!response->chunked()) {
+            std::string body = response->content();
+            responseBody = String(body.c_str(), body.size());
+        }
+    }
+
+    void send(int code, const String &contentType = String(), const String &content = String()) {
+        responseCode = code;
+        responseType = contentType;
+        responseBody = content;
+    }
+    void send(FS &fs, const String &path, const String &contentType = String()) {
+        (void)fs;
+        responseCode = 200;
+        responseType = contentType;
+        responseBody = path;
+    }
+
+    int responseCode = 0;
+    String responseType;
+    String responseBody;
+    std::unique_ptr<AsyncWebServerResponse> response; // Sat af send(AsyncWebServerResponse *)
+
+private:
+    const AsyncWebParameter *findHeader(const char *name) const {
+        for (auto &header : headers_) {
+            if (strcasecmp(header.name().c_str(), name) == 0) {
+                return &header;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<AsyncWebParameter> params_;
+    std::vector<AsyncWebParameter> headers_;
+};
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+
+class AsyncWebServer {
+public:
+    explicit AsyncWebServer(uint16_t port) : port_(port) {}
+
+    void on(const char *uri, WebRequestMethod method, ArRequestHandlerFunction handler) {
+        routes_.push_back({uri, method, std::move(handler)});
+    }
+    void begin() { started_ = true; }
+
+    // Kald en registreret handler direkte (bruges af host-målinger)
+    bool dispatch(const char *uri, WebRequestMethod method, AsyncWebServerRequest &request) {
+        for (auto &route : routes_) {
+            if (route.method == method && strcmp(route.uri, uri) == 0) {
+                route.handler(&request);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Route {
+        const char *uri;
+        WebRequestMethod method;
+        ArRequestHandlerFunction handler;
+    };
+
+    uint16_t port_;
+    bool started_ = false;
+    std::vector<Route> routes_;
+};
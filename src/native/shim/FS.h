@@ -0,0 +1,74 @@
+// Host-udgave af Arduino-ESP32's FS-lag; stier mappes ind under en mappe på host
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "Stream.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+public:
+    using Print::write;
+
+    File() = default;
+    File(std::FILE *handle, const char *name);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    size_t read(uint8_t *buffer, size_t size);
+    size_t readBytes(uint8_t *buffer, size_t length) override { return read(buffer, length); }
+
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    const char *name() const { return name_.c_str(); }
+    void close();
+
+    explicit operator bool() const { return handle_ != nullptr; }
+
+private:
+    std::shared_ptr<std::FILE> handle_;
+    std::string name_;
+};
+
+class FS {
+public:
+    explicit FS(std::string mountRoot = std::string()) : root_(std::move(mountRoot)) {}
+    virtual ~FS() = default;
+
+    File open(const char *path, const char *mode = FILE_READ, bool create = false);
+    File open(const String &path, const char *mode = FILE_READ, bool create = false) {
+        return open(path.c_str(), mode, create);
+    }
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *from, const char *to);
+    bool mkdir(const char *path);
+
+protected:
+    std::string hostPath(const char *path) const;
+
+    // Tom rod betyder nativeshim::fsRoot()
+    std::string root_;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
@@ -0,0 +1,35 @@
+// Host-udgave af Arduinos IPAddress
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include "Stream.h"
+
+class IPAddress : public Printable {
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes_{a, b, c, d} {}
+    explicit IPAddress(uint32_t address) {
+        for (int i = 0; i < 4; i++) {
+            bytes_[i] = static_cast<uint8_t>(address >> (8 * i));
+        }
+    }
+
+    operator uint32_t() const {
+        return bytes_[0] | (bytes_[1] << 8) | (bytes_[2] << 16) | (static_cast<uint32_t>(bytes_[3]) << 24);
+    }
+    uint8_t operator[](int index) const { return bytes_[index]; }
+    uint8_t &operator[](int index) { return bytes_[index]; }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes_[0], bytes_[1], bytes_[2], bytes_[3]);
+        return String(buf);
+    }
+
+    size_t printTo(Print &out) const override { return out.print(toString()); }
+
+private:
+    uint8_t bytes_[4] = {0, 0, 0, 0};
+};
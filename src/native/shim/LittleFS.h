@@ -0,0 +1,18 @@
+// Host-udgave af LittleFS
+#pragma once
+
+#include "FS.h"
+
+namespace fs {
+
+class LittleFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+               const char *partitionLabel = "spiffs");
+    size_t totalBytes() { return 1536 * 1024; }
+    void end() {}
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
@@ -0,0 +1,57 @@
+// Host-udgave af PubSubClient: en lille MQTT 3.1.1-klient med samme API som biblioteket
+#pragma once
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Client.h"
+
+#define MQTT_CONNECTION_TIMEOUT (-4)
+#define MQTT_CONNECTION_LOST (-3)
+#define MQTT_CONNECT_FAILED (-2)
+#define MQTT_DISCONNECTED (-1)
+#define MQTT_CONNECTED 0
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 256
+#endif
+
+class PubSubClient {
+public:
+    explicit PubSubClient(Client &client) : client_(&client) {}
+
+    PubSubClient &setServer(const char *domain, uint16_t port);
+    PubSubClient &setKeepAlive(uint16_t keepAliveSec) { keepAliveSec_ = keepAliveSec; return *this; }
+    PubSubClient &setSocketTimeout(uint16_t timeoutSec) { socketTimeoutSec_ = timeoutSec; return *this; }
+    bool setBufferSize(uint16_t size) { bufferSize_ = size; return true; }
+    uint16_t getBufferSize() const { return bufferSize_; }
+
+    bool connect(const char *id);
+    void disconnect();
+    bool connected();
+    int state() const { return state_; }
+
+    bool publish(const char *topic, const char *payload, bool retained = false);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false);
+    // Beskeder større end bufferen: header og emne, så beskeden i bidder, uden kopi
+    bool beginPublish(const char *topic, unsigned int length, bool retained);
+    size_t write(const uint8_t *buffer, size_t size);
+    int endPublish() { return 1; }
+    bool loop();
+
+private:
+    // following: bytes der skrives bagefter med write() (se beginPublish)
+    bool writePacket(uint8_t header, const uint8_t *body, size_t length, size_t following = 0);
+    bool readPacket(uint8_t &header, uint8_t *body, size_t capacity, size_t &length);
+
+    Client *client_;
+    const char *domain_ = nullptr;
+    uint16_t port_ = 1883;
+    uint16_t keepAliveSec_ = 15;
+    uint16_t socketTimeoutSec_ = 15;
+    uint16_t bufferSize_ = MQTT_MAX_PACKET_SIZE;
+    int state_ = MQTT_DISCONNECTED;
+    unsigned long lastOutActivity_ = 0;
+    std::vector<uint8_t> packet_;
+    std::vector<uint8_t> body_;
+};
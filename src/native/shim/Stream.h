@@ -0,0 +1,124 @@
+// Host-udgave af Arduinos Print/Stream-hierarki
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+#include "WString.h"
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() = default;
+    virtual size_t printTo(Print &out) const = 0;
+};
+
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+    size_t write(const char *str) { return str ? write(reinterpret_cast<const uint8_t *>(str), strlen(str)) : 0; }
+    virtual void flush() {}
+
+    size_t print(const char *str) { return write(str); }
+    size_t print(const String &str) { return write(reinterpret_cast<const uint8_t *>(str.c_str()), str.length()); }
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(long long value) { return printf("%lld", value); }
+    size_t print(unsigned long long value) { return printf("%llu", value); }
+    size_t print(double value) { return printf("%.2f", value); }
+    size_t print(const Printable &value) { return value.printTo(*this); }
+    size_t print(const struct tm *timeinfo, const char *format = nullptr) {
+        char buf[64];
+        size_t len = strftime(buf, sizeof(buf), format ? format : "%c", timeinfo);
+        return write(reinterpret_cast<const uint8_t *>(buf), len);
+    }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+    size_t println(const struct tm *timeinfo, const char *format = nullptr) { return print(timeinfo, format) + println(); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if (len < 0) {
+            return 0;
+        }
+        if (static_cast<size_t>(len) < sizeof(buf)) {
+            return write(reinterpret_cast<const uint8_t *>(buf), len);
+        }
+        std::string big(len, '\0');
+        va_start(args, format);
+        vsnprintf(&big[0], len + 1, format, args);
+        va_end(args);
+        return write(reinterpret_cast<const uint8_t *>(big.data()), len);
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeoutMs) { timeout_ = timeoutMs; }
+    unsigned long getTimeout() const { return timeout_; }
+
+    virtual size_t readBytes(uint8_t *buffer, size_t length) {
+        size_t n = 0;
+        while (n < length) {
+            int c = timedRead();
+            if (c < 0) {
+                break;
+            }
+            buffer[n++] = static_cast<uint8_t>(c);
+        }
+        return n;
+    }
+    size_t readBytes(char *buffer, size_t length) { return readBytes(reinterpret_cast<uint8_t *>(buffer), length); }
+
+    String readStringUntil(char terminator) {
+        std::string out;
+        int c = timedRead();
+        while (c >= 0 && c != terminator) {
+            out += static_cast<char>(c);
+            c = timedRead();
+        }
+        return String(out);
+    }
+
+    String readString() {
+        std::string out;
+        int c = timedRead();
+        while (c >= 0) {
+            out += static_cast<char>(c);
+            c = timedRead();
+        }
+        return String(out);
+    }
+
+protected:
+    // Filer og sockets på host blokerer selv, så der er ingen grund til at polle
+    virtual int timedRead() { return read(); }
+
+    unsigned long timeout_ = 1000;
+};
@@ -0,0 +1,105 @@
+// Host-udgave af Arduinos String-klasse (kun den del firmwaren bruger)
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+class String {
+public:
+    String() = default;
+    String(const char *cstr) : s_(cstr ? cstr : "") {}
+    String(const char *cstr, unsigned int length) : s_(cstr, length) {}
+    String(const std::string &str) : s_(str) {}
+    explicit String(char c) : s_(1, c) {}
+    explicit String(int value) : s_(std::to_string(value)) {}
+    explicit String(unsigned int value) : s_(std::to_string(value)) {}
+    explicit String(long value) : s_(std::to_string(value)) {}
+    explicit String(unsigned long value) : s_(std::to_string(value)) {}
+    explicit String(long long value) : s_(std::to_string(value)) {}
+    explicit String(unsigned long long value) : s_(std::to_string(value)) {}
+    explicit String(double value) : s_(std::to_string(value)) {}
+
+    const char *c_str() const { return s_.c_str(); }
+    unsigned int length() const { return s_.length(); }
+    bool isEmpty() const { return s_.empty(); }
+    bool reserve(unsigned int size) { s_.reserve(size); return true; }
+
+    String &operator+=(const String &rhs) { s_ += rhs.s_; return *this; }
+    String &operator+=(const char *rhs) { s_ += rhs ? rhs : ""; return *this; }
+    String &operator+=(char rhs) { s_ += rhs; return *this; }
+    bool concat(const String &rhs) { s_ += rhs.s_; return true; }
+    bool concat(const char *rhs) { s_ += rhs ? rhs : ""; return true; }
+    bool concat(char rhs) { s_ += rhs; return true; }
+
+    friend String operator+(const String &lhs, const String &rhs) { return String(lhs.s_ + rhs.s_); }
+    friend String operator+(const String &lhs, const char *rhs) { return String(lhs.s_ + (rhs ? rhs : "")); }
+    friend String operator+(const char *lhs, const String &rhs) { return String((lhs ? lhs : "") + rhs.s_); }
+    friend String operator+(const String &lhs, char rhs) { return String(lhs.s_ + rhs); }
+
+    bool equals(const String &rhs) const { return s_ == rhs.s_; }
+    bool equals(const char *rhs) const { return s_ == (rhs ? rhs : ""); }
+    bool operator==(const String &rhs) const { return equals(rhs); }
+    bool operator==(const char *rhs) const { return equals(rhs); }
+    bool operator!=(const String &rhs) const { return !equals(rhs); }
+    bool operator!=(const char *rhs) const { return !equals(rhs); }
+    bool operator<(const String &rhs) const { return s_ < rhs.s_; }
+
+    char charAt(unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    bool startsWith(const String &prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+    bool endsWith(const String &suffix) const {
+        return s_.size() >= suffix.s_.size() &&
+               s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return toIndex(s_.find(c, from)); }
+    int indexOf(const char *str, unsigned int from = 0) const { return toIndex(s_.find(str, from)); }
+    int indexOf(const String &str, unsigned int from = 0) const { return toIndex(s_.find(str.s_, from)); }
+    int lastIndexOf(char c) const { return toIndex(s_.rfind(c)); }
+
+    String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            unsigned int tmp = from;
+            from = to;
+            to = tmp;
+        }
+        if (from >= s_.size()) {
+            return String();
+        }
+        return String(s_.substr(from, to - from));
+    }
+
+    void trim() {
+        const char *ws = " \t\r\n\f\v";
+        size_t begin = s_.find_first_not_of(ws);
+        if (begin == std::string::npos) {
+            s_.clear();
+            return;
+        }
+        size_t end = s_.find_last_not_of(ws);
+        s_ = s_.substr(begin, end - begin + 1);
+    }
+
+    void remove(unsigned int index) { if (index < s_.size()) s_.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s_.size()) s_.erase(index, count); }
+    void replace(const String &find, const String &with) {
+        if (find.s_.empty()) {
+            return;
+        }
+        size_t pos = 0;
+        while ((pos = s_.find(find.s_, pos)) != std::string::npos) {
+            s_.replace(pos, find.s_.size(), with.s_);
+            pos += with.s_.size();
+        }
+    }
+
+    long toInt() const { return std::strtol(s_.c_str(), nullptr, 10); }
+    float toFloat() const { return std::strtof(s_.c_str(), nullptr); }
+
+private:
+    static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+
+    std::string s_;
+};
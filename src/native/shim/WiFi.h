@@ -0,0 +1,68 @@
+// Host-udgave af WiFi-klassen; forbindelsen er altid "oppe" når nativeshim siger det
+#pragma once
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+class WiFiClass {
+public:
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t *bssid = nullptr, bool connect = true);
+    bool disconnect(bool wifiOff = false, bool eraseAp = false);
+    wl_status_t status();
+    bool mode(wifi_mode_t mode) { mode_ = mode; return true; }
+
+    // Statisk IP; 0.0.0.0 som lokal adresse slår DHCP til igen
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress()) {
+        (void)gateway;
+        (void)subnet;
+        (void)dns1;
+        staticIp_ = static_cast<uint32_t>(local) != 0;
+        return true;
+    }
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+    IPAddress gatewayIP() { return IPAddress(127, 0, 0, 1); }
+    IPAddress subnetMask() { return IPAddress(255, 0, 0, 0); }
+    IPAddress dnsIP(uint8_t index = 0) { (void)index; return IPAddress(127, 0, 0, 1); }
+    uint8_t *BSSID() { return bssid_; }
+    int32_t channel() { return status_ == WL_CONNECTED ? 6 : 0; }
+    int8_t RSSI() { return status_ == WL_CONNECTED ? -60 : 0; }
+
+    bool softAP(const char *ssid, const char *passphrase = nullptr) {
+        (void)ssid;
+        (void)passphrase;
+        mode_ = WIFI_AP;
+        return true;
+    }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+
+    // Modem sleep mellem beacons; på host ændrer det kun hvad getSleep() svarer
+    bool setSleep(bool enabled) {
+        sleep_ = enabled;
+        return true;
+    }
+    bool getSleep() { return sleep_; }
+
+private:
+    wl_status_t status_ = WL_IDLE_STATUS;
+    wifi_mode_t mode_ = WIFI_OFF;
+    bool staticIp_ = false;
+    bool sleep_ = true; // Standard i Arduino-ESP32 (WIFI_PS_MIN_MODEM)
+    bool connecting_ = false;
+    unsigned long connectedAt_ = 0; // millis() hvor den igangværende forbindelse er oppe
+    uint8_t bssid_[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,45 @@
+// Host-udgave af WiFiClient oven på almindelige POSIX-sockets
+#pragma once
+
+#include <memory>
+
+#include "Arduino.h"
+#include "Client.h"
+
+class WiFiClient : public Client {
+public:
+    using Client::read;
+    using Print::write;
+
+    WiFiClient() = default;
+    ~WiFiClient() override = default;
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char *host, uint16_t port) override;
+    int connect(const char *host, uint16_t port, int32_t timeoutMs);
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t *buffer, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    explicit operator bool() override { return connected(); }
+
+    // Som på arduino-esp32 2.x: sekunder, og gælder både connect og læsning
+    int setTimeout(uint32_t seconds) {
+        connectTimeoutMs_ = seconds * 1000;
+        Stream::setTimeout(seconds * 1000);
+        return 0;
+    }
+    int setNoDelay(bool noDelay);
+    int fd() const;
+
+private:
+    struct Socket;
+    std::shared_ptr<Socket> socket_;
+    int32_t connectTimeoutMs_ = 3000;
+};
@@ -0,0 +1,280 @@
+// Host-implementering af Arduino-kernen: tid, pins, Serial og sleep
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "Arduino.h"
+#include "driver/gpio.h"
+#include "esp_sntp.h"
+#include "esp_timer.h"
+#include "native_shim.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace {
+
+const auto bootTime = std::chrono::steady_clock::now();
+
+bool serialQuiet = false;
+std::function<void()> deepSleepHandler;
+esp_sleep_wakeup_cause_t wakeupCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+uint64_t ext1WakeupStatus = 0;
+std::function<void()> restartHandler;
+
+struct PinState {
+    int level = LOW;
+    void (*handler)() = nullptr;
+    void (*argHandler)(void *) = nullptr;
+    void *arg = nullptr;
+    int mode = 0;
+    bool wakeHigh = false; // gpio_wakeup_enable(GPIO_INTR_HIGH_LEVEL)
+};
+
+PinState pins[40];
+
+// Light sleep venter på timeren eller en vækkepin; setPin vækker
+std::mutex sleepMutex;
+std::condition_variable sleepWake;
+uint64_t timerWakeupUs = 0; // 0 = timeren vækker ikke
+bool gpioWakeup = false;
+
+uint32_t ntpDelayMs = 0;
+std::atomic<int64_t> ntpCompleteUs{-1}; // esp_timer-tid hvor en igangværende synkronisering er færdig
+
+}  // namespace
+
+namespace nativeshim {
+
+void setNtpDelay(uint32_t ms) { ntpDelayMs = ms; }
+
+}  // namespace nativeshim
+
+unsigned long millis() {
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          std::chrono::steady_clock::now() - bootTime).count());
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now() - bootTime).count());
+}
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - bootTime).count();
+}
+
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+void delayMicroseconds(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+long random(long howbig) { return howbig > 0 ? static_cast<long>(std::rand() % howbig) : 0; }
+
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+
+void randomSeed(unsigned long seed) { std::srand(static_cast<unsigned>(seed)); }
+
+uint32_t esp_random() { return static_cast<uint32_t>(std::rand()) ^ static_cast<uint32_t>(micros()); }
+
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < 40) {
+        pins[pin].level = value ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint8_t pin) { return pin < 40 ? pins[pin].level : LOW; }
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    if (pin < 40) {
+        pins[pin].handler = handler;
+        pins[pin].argHandler = nullptr;
+        pins[pin].mode = mode;
+    }
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode) {
+    if (pin < 40) {
+        pins[pin].handler = nullptr;
+        pins[pin].argHandler = handler;
+        pins[pin].arg = arg;
+        pins[pin].mode = mode;
+    }
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin < 40) {
+        pins[pin].handler = nullptr;
+        pins[pin].argHandler = nullptr;
+    }
+}
+
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char *server1, const char *server2,
+                const char *server3) {
+    // Host-uret er allerede synkroniseret; "synkroniseringen" tager kun den simulerede svartid
+    (void)gmtOffsetSec;
+    (void)daylightOffsetSec;
+    (void)server1;
+    (void)server2;
+    (void)server3;
+    ntpCompleteUs = esp_timer_get_time() + static_cast<int64_t>(ntpDelayMs) * 1000;
+}
+
+sntp_sync_status_t sntp_get_sync_status() {
+    int64_t complete = ntpCompleteUs;
+    if (complete < 0) {
+        return SNTP_SYNC_STATUS_RESET;
+    }
+    if (esp_timer_get_time() < complete) {
+        return SNTP_SYNC_STATUS_IN_PROGRESS;
+    }
+    return ntpCompleteUs.compare_exchange_strong(complete, -1) ? SNTP_SYNC_STATUS_COMPLETED
+                                                                : SNTP_SYNC_STATUS_RESET;
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms) {
+    (void)ms;
+    time_t now = time(nullptr);
+    return localtime_r(&now, info) != nullptr;
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    if (!serialQuiet) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
+
+void EspClass::restart() {
+    if (restartHandler) {
+        restartHandler();
+    }
+    std::exit(0);
+}
+
+uint32_t EspClass::getFreeHeap() { return 320 * 1024; }
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t gpio, int level) {
+    (void)gpio;
+    (void)level;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) {
+    (void)mask;
+    (void)mode;
+    return ESP_OK;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status() { return wakeupCause == ESP_SLEEP_WAKEUP_EXT1 ? ext1WakeupStatus : 0; }
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs) {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    timerWakeupUs = timeUs;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    gpioWakeup = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_wakeup_cause_t source) {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    if (source == ESP_SLEEP_WAKEUP_TIMER || source == ESP_SLEEP_WAKEUP_ALL) {
+        timerWakeupUs = 0;
+    }
+    if (source == ESP_SLEEP_WAKEUP_GPIO || source == ESP_SLEEP_WAKEUP_ALL) {
+        gpioWakeup = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio, gpio_int_type_t type) {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    if (gpio < 40) {
+        pins[gpio].wakeHigh = type == GPIO_INTR_HIGH_LEVEL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio) {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    if (gpio < 40) {
+        pins[gpio].wakeHigh = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    auto pinAwake = [] {
+        if (!gpioWakeup) {
+            return false;
+        }
+        for (const PinState &pin : pins) {
+            if (pin.wakeHigh && pin.level == HIGH) {
+                return true;
+            }
+        }
+        return false;
+    };
+    bool byPin = timerWakeupUs == 0 ? (sleepWake.wait(lock, pinAwake), true)
+                                    : sleepWake.wait_for(lock, std::chrono::microseconds(timerWakeupUs), pinAwake);
+    // Som på ESP32 giver esp_sleep_get_wakeup_cause nu årsagen til den seneste opvågning
+    wakeupCause = byPin ? ESP_SLEEP_WAKEUP_GPIO : ESP_SLEEP_WAKEUP_TIMER;
+    return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return wakeupCause; }
+
+void esp_deep_sleep_start() {
+    if (deepSleepHandler) {
+        deepSleepHandler();
+    }
+    std::exit(0);
+}
+
+namespace nativeshim {
+
+void setPin(uint8_t pin, int level) {
+    if (pin >= 40) {
+        return;
+    }
+    int previous = pins[pin].level;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pins[pin].level = level ? HIGH : LOW;
+    }
+    sleepWake.notify_all();
+    bool rising = previous == LOW && pins[pin].level == HIGH;
+    bool falling = previous == HIGH && pins[pin].level == LOW;
+    int mode = pins[pin].mode;
+    if ((rising && (mode == RISING || mode == CHANGE)) || (falling && (mode == FALLING || mode == CHANGE))) {
+        if (pins[pin].handler) {
+            pins[pin].handler();
+        } else if (pins[pin].argHandler) {
+            pins[pin].argHandler(pins[pin].arg);
+        }
+    }
+}
+
+void setSerialQuiet(bool quiet) { serialQuiet = quiet; }
+
+void setDeepSleepHandler(std::function<void()> handler) { deepSleepHandler = std::move(handler); }
+
+void setRestartHandler(std::function<void()> handler) { restartHandler = std::move(handler); }
+
+void setWakeupCause(esp_sleep_wakeup_cause_t cause, uint64_t ext1Status) {
+    wakeupCause = cause;
+    ext1WakeupStatus = ext1Status;
+}
+
+}  // namespace nativeshim
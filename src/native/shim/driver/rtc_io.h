@@ -0,0 +1,4 @@
+// Host-udgave af driver/rtc_io.h
+#pragma once
+
+#include "esp_sleep.h"
@@ -0,0 +1,11 @@
+// Host-udgave af esp_sntp.h: kun synkroniseringsstatus
+#pragma once
+
+typedef enum {
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+// Som i ESP-IDF: COMPLETED returneres én gang efter en synkronisering, derefter RESET
+sntp_sync_status_t sntp_get_sync_status();
@@ -0,0 +1,6 @@
+// Host-udgave af esp_timer: mikrosekunder siden opstart
+#pragma once
+
+#include <cstdint>
+
+int64_t esp_timer_get_time();
@@ -0,0 +1,20 @@
+// Host-udgave af FreeRTOS: opgaver er tråde, 1 tick = 1 ms
+#pragma once
+
+#include <cstdint>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+#include "freertos/task.h"
@@ -0,0 +1,200 @@
+// Host-implementering af den del af FreeRTOS firmwaren bruger, oven på std::thread
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "native_shim.h"
+
+namespace {
+
+std::mutex holdMutex;
+std::condition_variable holdReleased;
+bool tasksHeld = false;
+
+const auto tickEpoch = std::chrono::steady_clock::now();
+
+// Vent på cv indtil pred er sand eller ticks er gået (portMAX_DELAY = uendeligt)
+template <typename Pred>
+bool waitTicks(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, Pred pred) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, pred);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), pred);
+}
+
+}  // namespace
+
+struct NativeTask {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+};
+
+// Den kaldende tråds egen notifikationsstruktur findes via thread_local
+static thread_local NativeTask *currentTask = nullptr;
+
+struct NativeQueue {
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::vector<uint8_t> storage;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+};
+
+struct NativeSemaphore {
+    std::timed_mutex mutex;
+};
+
+namespace nativeshim {
+
+void holdTasks(bool hold) {
+    std::lock_guard<std::mutex> lock(holdMutex);
+    tasksHeld = hold;
+    if (!hold) {
+        holdReleased.notify_all();
+    }
+}
+
+}  // namespace nativeshim
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core) {
+    (void)name;
+    (void)stackDepth;
+    (void)priority;
+    (void)core;
+    NativeTask *task = new NativeTask();
+    if (created) {
+        *created = task;
+    }
+    std::thread([function, parameter, task] {
+        currentTask = task;
+        {
+            std::unique_lock<std::mutex> lock(holdMutex);
+            holdReleased.wait(lock, [] { return !tasksHeld; });
+        }
+        function(parameter);
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // Opgaverne i firmwaren stopper aldrig; en tråd kan ikke slås ihjel udefra
+    (void)task;
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tickEpoch).count());
+}
+
+// Tråde der ikke er oprettet som opgave (fx main, som Arduinos loopTask) får deres
+// notifikationsstruktur første gang de spørger
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    static thread_local NativeTask ownTask;
+    if (!currentTask) {
+        currentTask = &ownTask;
+    }
+    return currentTask;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+    NativeTask *task = currentTask;
+    if (!task) {
+        vTaskDelay(ticksToWait == portMAX_DELAY ? 1 : ticksToWait);
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(task->mutex);
+    waitTicks(task->notified, lock, ticksToWait, [task] { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (task) {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+        task->notified.notify_one();
+    }
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken) {
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    NativeQueue *queue = new NativeQueue();
+    queue->storage.resize(static_cast<size_t>(length) * itemSize);
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitTicks(queue->notFull, lock, ticksToWait, [queue] { return queue->count < queue->length; })) {
+        return pdFAIL;
+    }
+    UBaseType_t slot = (queue->head + queue->count) % queue->length;
+    memcpy(&queue->storage[slot * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    queue->notEmpty.notify_one();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitTicks(queue->notEmpty, lock, ticksToWait, [queue] { return queue->count > 0; })) {
+        return pdFAIL;
+    }
+    memcpy(buffer, &queue->storage[queue->head * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->notFull.notify_one();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new NativeSemaphore(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    if (ticksToWait == portMAX_DELAY) {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
@@ -0,0 +1,140 @@
+// Host-implementering af FS/LittleFS oven på stdio
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+#include "LittleFS.h"
+#include "native_shim.h"
+
+fs::LittleFSFS LittleFS;
+
+namespace {
+
+std::string fsRootPath = [] {
+    const char *env = getenv("NATIVE_FS_ROOT");
+    return std::string(env ? env : "/tmp/esp32_littlefs");
+}();
+
+void makeDirs(const std::string &path) {
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos == path.size() || path[pos] == '/') {
+            ::mkdir(path.substr(0, pos).c_str(), 0755);
+        }
+    }
+}
+
+}  // namespace
+
+namespace nativeshim {
+
+void setFsRoot(const char *path) { fsRootPath = path; }
+
+const char *fsRoot() { return fsRootPath.c_str(); }
+
+}  // namespace nativeshim
+
+namespace fs {
+
+File::File(std::FILE *handle, const char *name) : handle_(handle, [](std::FILE *f) { std::fclose(f); }), name_(name) {}
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+    return handle_ ? std::fwrite(buffer, 1, size, handle_.get()) : 0;
+}
+
+int File::available() {
+    if (!handle_) {
+        return 0;
+    }
+    return static_cast<int>(size() - position());
+}
+
+int File::read() {
+    return handle_ ? std::fgetc(handle_.get()) : -1;
+}
+
+int File::peek() {
+    if (!handle_) {
+        return -1;
+    }
+    int c = std::fgetc(handle_.get());
+    if (c != EOF) {
+        std::ungetc(c, handle_.get());
+    }
+    return c;
+}
+
+void File::flush() {
+    if (handle_) {
+        std::fflush(handle_.get());
+    }
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+    return handle_ ? std::fread(buffer, 1, size, handle_.get()) : 0;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+    return handle_ && std::fseek(handle_.get(), pos, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+    return handle_ ? static_cast<size_t>(std::ftell(handle_.get())) : 0;
+}
+
+size_t File::size() const {
+    if (!handle_) {
+        return 0;
+    }
+    std::fflush(handle_.get());
+    struct stat st;
+    return fstat(fileno(handle_.get()), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+void File::close() { handle_.reset(); }
+
+std::string FS::hostPath(const char *path) const {
+    return (root_.empty() ? nativeshim::fsRoot() : root_) + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char *path, const char *mode, bool create) {
+    std::string host = hostPath(path);
+    if (create || mode[0] != 'r') {
+        makeDirs(host.substr(0, host.rfind('/')));
+    }
+    // "rb" og venner, så bytes ikke oversættes
+    std::string stdioMode = std::string(1, mode[0]) + "b" + (strchr(mode, '+') ? "+" : "");
+    std::FILE *handle = std::fopen(host.c_str(), stdioMode.c_str());
+    return handle ? File(handle, path) : File();
+}
+
+bool FS::exists(const char *path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path) { return ::unlink(hostPath(path).c_str()) == 0; }
+
+bool FS::rename(const char *from, const char *to) {
+    return std::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+    makeDirs(hostPath(path));
+    return true;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char *basePath, uint8_t maxOpenFiles, const char *partitionLabel) {
+    (void)formatOnFail;
+    (void)basePath;
+    (void)maxOpenFiles;
+    (void)partitionLabel;
+    makeDirs(root_.empty() ? nativeshim::fsRoot() : root_);
+    return true;
+}
+
+}  // namespace fs
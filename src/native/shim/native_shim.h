@@ -0,0 +1,43 @@
+// Styring af host-shimmen: pins, netværksomdirigering og filsystemrod
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "esp_sleep.h"
+
+namespace nativeshim {
+
+// Sæt niveauet på en simuleret pin; en stigende flanke kalder den tilknyttede interrupt-handler
+void setPin(uint8_t pin, int level);
+
+// Omdiriger forbindelser til host:port (fx "broker.hivemq.com":1883) til en lokal stand-in
+void redirect(const char *host, uint16_t port, const char *toHost, uint16_t toPort);
+
+// Mappe på host der spiller rollen som LittleFS-partitionen
+void setFsRoot(const char *path);
+const char *fsRoot();
+
+// Slå Serial-output fra under målinger (formatering udføres stadig)
+void setSerialQuiet(bool quiet);
+
+// Hvad der skal ske ved esp_deep_sleep_start og ESP.restart (standard: afslut processen)
+void setDeepSleepHandler(std::function<void()> handler);
+void setRestartHandler(std::function<void()> handler);
+
+// Hvad esp_sleep_get_wakeup_cause returnerer (standard: ESP_SLEEP_WAKEUP_UNDEFINED som ved strøm på)
+// og, ved ext1, esp_sleep_get_ext1_wakeup_status (bit n = GPIO n)
+void setWakeupCause(esp_sleep_wakeup_cause_t cause, uint64_t ext1Status = 0);
+
+// Hold nyoprettede FreeRTOS-opgaver tilbage indtil holdTasks(false), så setup() kan
+// køres og måles uden at opgaverne går i gang
+void holdTasks(bool hold);
+
+// Om WiFi.begin skal lykkes
+void setWiFiAvailable(bool available);
+
+// Simulerede radioomkostninger (standard 0): kanalscanning når WiFi.begin ikke får
+// kanal og BSSID, DHCP når der ikke er sat statisk IP, og svartid for NTP
+void setRadioTiming(uint32_t scanMs, uint32_t dhcpMs, uint32_t ntpMs);
+
+}  // namespace nativeshim
@@ -0,0 +1,193 @@
+// Host-implementering af PubSubClient (CONNECT, PUBLISH QoS 0, PINGREQ)
+#include <cstring>
+#include <vector>
+
+#include "PubSubClient.h"
+
+namespace {
+
+const uint8_t MQTTCONNECT = 1 << 4;
+const uint8_t MQTTCONNACK = 2 << 4;
+const uint8_t MQTTPUBLISH = 3 << 4;
+const uint8_t MQTTPINGREQ = 12 << 4;
+const uint8_t MQTTDISCONNECT = 14 << 4;
+
+size_t putString(std::vector<uint8_t> &out, const char *str, size_t length) {
+    out.push_back(static_cast<uint8_t>(length >> 8));
+    out.push_back(static_cast<uint8_t>(length & 0xFF));
+    out.insert(out.end(), str, str + length);
+    return length + 2;
+}
+
+}  // namespace
+
+PubSubClient &PubSubClient::setServer(const char *domain, uint16_t port) {
+    domain_ = domain;
+    port_ = port;
+    return *this;
+}
+
+bool PubSubClient::writePacket(uint8_t header, const uint8_t *body, size_t length, size_t following) {
+    uint8_t fixed[5];
+    size_t fixedLength = 0;
+    fixed[fixedLength++] = header;
+    size_t remaining = length + following;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        if (remaining > 0) {
+            digit |= 0x80;
+        }
+        fixed[fixedLength++] = digit;
+    } while (remaining > 0);
+
+    // Én write pr. pakke fra en genbrugt buffer, ligesom biblioteket gør
+    packet_.assign(fixed, fixed + fixedLength);
+    packet_.insert(packet_.end(), body, body + length);
+    bool ok = client_->write(packet_.data(), packet_.size()) == packet_.size();
+    lastOutActivity_ = millis();
+    return ok;
+}
+
+bool PubSubClient::readPacket(uint8_t &header, uint8_t *body, size_t capacity, size_t &length) {
+    client_->setTimeout(static_cast<unsigned long>(socketTimeoutSec_) * 1000UL);
+    int c = client_->read();
+    if (c < 0) {
+        return false;
+    }
+    header = static_cast<uint8_t>(c);
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    do {
+        c = client_->read();
+        if (c < 0) {
+            return false;
+        }
+        remaining += (c & 0x7F) * multiplier;
+        multiplier *= 128;
+    } while (c & 0x80);
+
+    length = 0;
+    while (length < remaining) {
+        c = client_->read();
+        if (c < 0) {
+            return false;
+        }
+        if (length < capacity) {
+            body[length] = static_cast<uint8_t>(c);
+        }
+        length++;
+    }
+    return true;
+}
+
+bool PubSubClient::connect(const char *id) {
+    if (connected()) {
+        return true;
+    }
+    if (!domain_ || !client_->connect(domain_, port_)) {
+        state_ = MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    std::vector<uint8_t> body;
+    putString(body, "MQTT", 4);
+    body.push_back(4);     // Protokolniveau 3.1.1
+    body.push_back(0x02);  // Clean session
+    body.push_back(static_cast<uint8_t>(keepAliveSec_ >> 8));
+    body.push_back(static_cast<uint8_t>(keepAliveSec_ & 0xFF));
+    putString(body, id, strlen(id));
+
+    if (!writePacket(MQTTCONNECT, body.data(), body.size())) {
+        state_ = MQTT_CONNECTION_LOST;
+        return false;
+    }
+
+    uint8_t header = 0;
+    uint8_t ack[4];
+    size_t length = 0;
+    if (!readPacket(header, ack, sizeof(ack), length) || (header & 0xF0) != MQTTCONNACK || length < 2) {
+        client_->stop();
+        state_ = MQTT_CONNECTION_TIMEOUT;
+        return false;
+    }
+    if (ack[1] != 0) {
+        client_->stop();
+        state_ = ack[1];
+        return false;
+    }
+    state_ = MQTT_CONNECTED;
+    return true;
+}
+
+void PubSubClient::disconnect() {
+    if (client_->connected()) {
+        writePacket(MQTTDISCONNECT, nullptr, 0);
+    }
+    client_->stop();
+    state_ = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() {
+    if (!client_->connected()) {
+        if (state_ == MQTT_CONNECTED) {
+            state_ = MQTT_CONNECTION_LOST;
+        }
+        return false;
+    }
+    return state_ == MQTT_CONNECTED;
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload, bool retained) {
+    return publish(topic, reinterpret_cast<const uint8_t *>(payload), payload ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained) {
+    if (!connected()) {
+        return false;
+    }
+    size_t topicLength = strlen(topic);
+    // Biblioteket afviser beskeder der ikke kan være i dets buffer
+    if (5 + 2 + topicLength + length > bufferSize_) {
+        return false;
+    }
+    body_.clear();
+    putString(body_, topic, topicLength);
+    body_.insert(body_.end(), payload, payload + length);
+    return writePacket(MQTTPUBLISH | (retained ? 1 : 0), body_.data(), body_.size());
+}
+
+bool PubSubClient::beginPublish(const char *topic, unsigned int length, bool retained) {
+    if (!connected()) {
+        return false;
+    }
+    body_.clear();
+    putString(body_, topic, strlen(topic));
+    return writePacket(MQTTPUBLISH | (retained ? 1 : 0), body_.data(), body_.size(), length);
+}
+
+size_t PubSubClient::write(const uint8_t *buffer, size_t size) {
+    lastOutActivity_ = millis();
+    return client_->write(buffer, size);
+}
+
+bool PubSubClient::loop() {
+    if (!connected()) {
+        return false;
+    }
+    if (keepAliveSec_ > 0 && millis() - lastOutActivity_ > keepAliveSec_ * 1000UL) {
+        writePacket(MQTTPINGREQ, nullptr, 0);
+    }
+    while (client_->available() > 0) {
+        uint8_t header = 0;
+        uint8_t body[64];
+        size_t length = 0;
+        if (!readPacket(header, body, sizeof(body), length)) {
+            client_->stop();
+            state_ = MQTT_CONNECTION_LOST;
+            return false;
+        }
+        // PINGRESP og indkommende beskeder bruges ikke af firmwaren
+    }
+    return true;
+}
@@ -0,0 +1,245 @@
+// Host-implementering af WiFi og WiFiClient med POSIX-sockets
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "WiFi.h"
+#include "native_shim.h"
+
+WiFiClass WiFi;
+
+namespace {
+
+bool wifiAvailable = true;
+uint32_t scanMs = 0;
+uint32_t dhcpMs = 0;
+
+std::mutex redirectMutex;
+std::map<std::pair<std::string, uint16_t>, std::pair<std::string, uint16_t>> redirects;
+
+int openSocket(const char *host, uint16_t port, int32_t timeoutMs) {
+    std::string targetHost = host;
+    uint16_t targetPort = port;
+    {
+        std::lock_guard<std::mutex> lock(redirectMutex);
+        auto it = redirects.find({targetHost, port});
+        if (it != redirects.end()) {
+            targetHost = it->second.first;
+            targetPort = it->second.second;
+        }
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    std::string portStr = std::to_string(targetPort);
+    if (getaddrinfo(targetHost.c_str(), portStr.c_str(), &hints, &result) != 0 || !result) {
+        return -1;
+    }
+
+    int fd = ::socket(result->ai_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        freeaddrinfo(result);
+        return -1;
+    }
+
+    // Ikke-blokerende connect, så timeouten overholdes som på ESP32
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int rc = ::connect(fd, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    if (rc < 0 && errno == EINPROGRESS) {
+        pollfd pfd = {fd, POLLOUT, 0};
+        rc = poll(&pfd, 1, timeoutMs) == 1 ? 0 : -1;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (rc == 0 && (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)) {
+            rc = -1;
+        }
+    }
+    if (rc < 0) {
+        ::close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, flags);
+    return fd;
+}
+
+}  // namespace
+
+namespace nativeshim {
+
+void redirect(const char *host, uint16_t port, const char *toHost, uint16_t toPort) {
+    std::lock_guard<std::mutex> lock(redirectMutex);
+    redirects[{host, port}] = {toHost, toPort};
+}
+
+void setWiFiAvailable(bool available) { wifiAvailable = available; }
+
+void setNtpDelay(uint32_t ms);  // arduino_shim.cpp
+
+void setRadioTiming(uint32_t scan, uint32_t dhcp, uint32_t ntp) {
+    scanMs = scan;
+    dhcpMs = dhcp;
+    setNtpDelay(ntp);
+}
+
+}  // namespace nativeshim
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase, int32_t channel, const uint8_t *bssid,
+                             bool connect) {
+    (void)passphrase;
+    (void)connect;
+    mode_ = WIFI_STA;
+    if (!wifiAvailable || !ssid || !ssid[0]) {
+        status_ = WL_NO_SSID_AVAIL;
+        return status_;
+    }
+    // Forbindelsen er oppe når den simulerede scanning og DHCP er overstået
+    bool knownAp = channel > 0 && bssid;
+    connectedAt_ = millis() + (knownAp ? 0 : scanMs) + (staticIp_ ? 0 : dhcpMs);
+    connecting_ = true;
+    status_ = WL_DISCONNECTED;
+    return status();
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+    (void)eraseAp;
+    status_ = WL_DISCONNECTED;
+    connecting_ = false;
+    if (wifiOff) {
+        mode_ = WIFI_OFF;
+    }
+    return true;
+}
+
+wl_status_t WiFiClass::status() {
+    if (connecting_ && millis() >= connectedAt_) {
+        status_ = WL_CONNECTED;
+        connecting_ = false;
+    }
+    if (status_ == WL_CONNECTED && !wifiAvailable) {
+        status_ = WL_CONNECTION_LOST;
+    }
+    return status_;
+}
+
+struct WiFiClient::Socket {
+    explicit Socket(int fd) : fd(fd) {}
+    ~Socket() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    int fd;
+};
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) { return connect(ip.toString().c_str(), port); }
+
+int WiFiClient::connect(const char *host, uint16_t port) { return connect(host, port, connectTimeoutMs_); }
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeoutMs) {
+    stop();
+    int fd = openSocket(host, port, timeoutMs);
+    if (fd < 0) {
+        return 0;
+    }
+    socket_ = std::make_shared<Socket>(fd);
+    setNoDelay(true);
+    return 1;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+    if (!socket_) {
+        return 0;
+    }
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = ::send(socket_->fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            stop();
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return sent;
+}
+
+int WiFiClient::available() {
+    if (!socket_) {
+        return 0;
+    }
+    int count = 0;
+    if (ioctl(socket_->fd, FIONREAD, &count) < 0) {
+        return 0;
+    }
+    return count;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+    if (!socket_) {
+        return -1;
+    }
+    // Som på ESP32: vent højst timeout_ på data
+    pollfd pfd = {socket_->fd, POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(timeout_)) != 1) {
+        return -1;
+    }
+    ssize_t n = ::recv(socket_->fd, buffer, size, 0);
+    if (n <= 0) {
+        stop();
+        return -1;
+    }
+    return static_cast<int>(n);
+}
+
+int WiFiClient::peek() {
+    if (!socket_) {
+        return -1;
+    }
+    uint8_t c;
+    return ::recv(socket_->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+void WiFiClient::stop() { socket_.reset(); }
+
+uint8_t WiFiClient::connected() {
+    if (!socket_) {
+        return 0;
+    }
+    uint8_t c;
+    ssize_t n = ::recv(socket_->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+int WiFiClient::setNoDelay(bool noDelay) {
+    if (!socket_) {
+        return -1;
+    }
+    int flag = noDelay ? 1 : 0;
+    return setsockopt(socket_->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+int WiFiClient::fd() const { return socket_ ? socket_->fd : -1; }
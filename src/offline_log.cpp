@@ -0,0 +1,249 @@
+#include "offline_log.h"
+
+#include "checksum.h"
+
+// Læsemarkøren gemmes som {seq, crc} i to skiftende slots
+struct CursorSlot {
+    uint32_t seq;
+    uint32_t crc;
+};
+
+bool OfflineLog::begin(fs::FS &fs, const char *dir, uint16_t segments, uint16_t segmentRecords) {
+    end();
+    filesystem = &fs;
+    snprintf(this->dir, sizeof(this->dir), "%s", dir);
+    segmentCount = segments;
+    recordsPerSegment = segmentRecords;
+    fs.mkdir(dir);
+    recover();
+    Serial.printf("Offline-log: %u poster i kø.\n", (unsigned)size());
+    return true;
+}
+
+void OfflineLog::end() {
+    if (!filesystem) {
+        return;
+    }
+    commit();
+    writeFile.close();
+    readFile.close();
+    writeSegment = 0xFFFF;
+    readSegment = 0xFFFF;
+    filesystem = nullptr;
+}
+
+void OfflineLog::segmentPath(uint16_t segment, char *path, size_t size) const {
+    snprintf(path, size, "%s/seg%u.bin", dir, segment);
+}
+
+uint32_t OfflineLog::recordCrc(const Record &record) {
+    uint32_t crc = crc32(&record.seq, sizeof(record.seq));
+    crc = crc32(&record.length, sizeof(record.length), crc);
+    return crc32(record.payload, record.length, crc);
+}
+
+bool OfflineLog::readRecord(File &file, uint32_t seq, Record &record) {
+    if (!file.seek(offsetOf(seq)) || file.read((uint8_t *)&record, RECORD_SIZE) != RECORD_SIZE) {
+        return false;
+    }
+    return record.seq == seq && record.length <= PAYLOAD_SIZE && recordCrc(record) == record.crc;
+}
+
+File *OfflineLog::fileFor(uint32_t seq) {
+    uint16_t segment = segmentOf(seq);
+    if (segment == writeSegment && writeFile) {
+        return &writeFile;
+    }
+    if (segment != readSegment || !readFile) {
+        char path[32];
+        segmentPath(segment, path, sizeof(path));
+        readFile = filesystem->open(path, FILE_READ);
+        readSegment = segment;
+    }
+    return readFile ? &readFile : nullptr;
+}
+
+// Find læsemarkøren og den sidste gyldige post efter opstart eller strømsvigt
+void OfflineLog::recover() {
+    char path[32];
+    snprintf(path, sizeof(path), "%s/cursor.bin", dir);
+    tail = 0;
+    commits = 0;
+    File cursor = filesystem->open(path, FILE_READ);
+    if (cursor) {
+        for (uint32_t i = 0; i < 2; i++) {
+            CursorSlot slot;
+            if (cursor.read((uint8_t *)&slot, sizeof(slot)) == sizeof(slot) &&
+                crc32(&slot.seq, sizeof(slot.seq)) == slot.crc && slot.seq >= tail) {
+                tail = slot.seq;
+                commits = i + 1;
+            }
+        }
+        cursor.close();
+    }
+
+    // Hovedsegmentet er det hvis første post har det højeste sekvensnummer
+    bool found = false;
+    uint32_t base = 0;
+    uint16_t headSegment = 0;
+    Record record;
+    for (uint16_t segment = 0; segment < segmentCount; segment++) {
+        segmentPath(segment, path, sizeof(path));
+        File file = filesystem->open(path, FILE_READ);
+        if (!file) {
+            continue;
+        }
+        if (file.read((uint8_t *)&record, RECORD_SIZE) == RECORD_SIZE && record.length <= PAYLOAD_SIZE &&
+            recordCrc(record) == record.crc && record.seq % recordsPerSegment == 0 &&
+            segmentOf(record.seq) == segment && (!found || record.seq > base)) {
+            base = record.seq;
+            headSegment = segment;
+            found = true;
+        }
+        file.close();
+    }
+
+    if (found) {
+        segmentPath(headSegment, path, sizeof(path));
+        File file = filesystem->open(path, FILE_READ);
+        head = base;
+        while (head - base < recordsPerSegment && readRecord(file, head, record)) {
+            head++;
+        }
+        file.close();
+    } else {
+        // Ingen data: start i et nyt segment så gendannelsen kan finde det igen
+        head = (tail + recordsPerSegment - 1) / recordsPerSegment * recordsPerSegment;
+        tail = head;
+    }
+
+    if (tail > head) {
+        tail = head;
+    }
+    committedTail = tail;
+    dropUnavailable();
+}
+
+// Flyt læsemarkøren frem hvis de ældste poster er blevet overskrevet
+void OfflineLog::dropUnavailable() {
+    uint32_t segmentEnd = (head + recordsPerSegment - 1) / recordsPerSegment * recordsPerSegment;
+    uint32_t span = capacity();
+    uint32_t oldest = segmentEnd > span ? segmentEnd - span : 0;
+    if (tail < oldest) {
+        droppedRecords += oldest - tail;
+        tail = oldest;
+    }
+}
+
+bool OfflineLog::append(const uint8_t *data, size_t length) {
+    if (!filesystem || length > PAYLOAD_SIZE) {
+        return false;
+    }
+
+    uint16_t segment = segmentOf(head);
+    bool newSegment = head % recordsPerSegment == 0;
+    if (newSegment || segment != writeSegment || !writeFile) {
+        writeFile.close();
+        if (segment == readSegment) {
+            readFile.close();
+            readSegment = 0xFFFF;
+        }
+        char path[32];
+        segmentPath(segment, path, sizeof(path));
+        // Et nyt segment nulstilles; ellers fortsættes efter den sidste gyldige post
+        writeFile = filesystem->open(path, newSegment || !filesystem->exists(path) ? "w+" : "r+");
+        if (!writeFile) {
+            Serial.println("Kunne ikke åbne offline-segment.");
+            writeSegment = 0xFFFF;
+            return false;
+        }
+        writeSegment = segment;
+    }
+
+    Record record;
+    record.seq = head;
+    record.length = length;
+    memcpy(record.payload, data, length);
+    memset(record.payload + length, 0, PAYLOAD_SIZE - length);
+    record.crc = recordCrc(record);
+
+    if (!writeFile.seek(offsetOf(head)) || writeFile.write((const uint8_t *)&record, RECORD_SIZE) != RECORD_SIZE) {
+        Serial.println("Kunne ikke skrive til offline-log.");
+        return false;
+    }
+    writeFile.flush();
+    head++;
+    dropUnavailable();
+    return true;
+}
+
+bool OfflineLog::peek(uint8_t *buffer, size_t capacity, size_t &length) {
+    Record record;
+    while (filesystem && tail < head) {
+        File *file = fileFor(tail);
+        if (file && readRecord(*file, tail, record) && record.length <= capacity) {
+            memcpy(buffer, record.payload, record.length);
+            length = record.length;
+            return true;
+        }
+        // Ødelagt post (fx afbrudt skrivning): spring den over i stedet for at gå i stå
+        tail++;
+        droppedRecords++;
+    }
+    return false;
+}
+
+bool OfflineLog::read(uint32_t seq, uint8_t *buffer, size_t capacity, size_t &length) {
+    if (!filesystem || seq < tail || seq >= head) {
+        return false;
+    }
+    Record record;
+    File *file = fileFor(seq);
+    if (!file || !readRecord(*file, seq, record) || record.length > capacity) {
+        return false;
+    }
+    memcpy(buffer, record.payload, record.length);
+    length = record.length;
+    return true;
+}
+
+void OfflineLog::pop() {
+    if (tail < head) {
+        popUntil(tail + 1);
+    }
+}
+
+void OfflineLog::popUntil(uint32_t seq) {
+    if (seq > head) {
+        seq = head;
+    }
+    if (seq <= tail) {
+        return; // Allerede fjernet, fx overskrevet da ringen løb fuld
+    }
+    tail = seq;
+    if (tail - committedTail >= COMMIT_INTERVAL) {
+        commit();
+    }
+}
+
+bool OfflineLog::commit() {
+    if (!filesystem || tail == committedTail) {
+        return true;
+    }
+    char path[32];
+    snprintf(path, sizeof(path), "%s/cursor.bin", dir);
+    File cursor = filesystem->open(path, filesystem->exists(path) ? "r+" : "w+");
+    if (!cursor) {
+        Serial.println("Kunne ikke gemme offline-markør.");
+        return false;
+    }
+    CursorSlot slot = {tail, crc32(&tail, sizeof(tail))};
+    bool ok = cursor.seek((commits % 2) * sizeof(slot)) &&
+              cursor.write((const uint8_t *)&slot, sizeof(slot)) == sizeof(slot);
+    cursor.close();
+    if (ok) {
+        committedTail = tail;
+        commits++;
+    }
+    return ok;
+}
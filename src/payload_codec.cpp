@@ -0,0 +1,291 @@
+#include "payload_codec.h"
+
+// Dage siden 1970-01-01 for en dato i den proleptiske gregorianske kalender
+static int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = (unsigned)(year - era * 400);
+    unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (int64_t)dayOfEra - 719468;
+}
+
+static void civilFromDays(int64_t days, int &year, unsigned &month, unsigned &day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned dayOfEra = (unsigned)(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned mp = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = (int)(yearOfEra + era * 400 + (month <= 2));
+}
+
+static bool parseDigits(const char *&p, int count, unsigned &value) {
+    value = 0;
+    for (int i = 0; i < count; i++, p++) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        value = value * 10 + (*p - '0');
+    }
+    return true;
+}
+
+// "YYYY-MM-DDTHH:MM:SS[.ffffff]" til mikrosekunder; alt andet sendes som tekst
+static bool parseIsoTime(const char *text, int64_t &us, bool &fraction) {
+    const char *p = text;
+    unsigned year, month, day, hour, minute, second;
+    if (!parseDigits(p, 4, year) || *p++ != '-' || !parseDigits(p, 2, month) || *p++ != '-' ||
+        !parseDigits(p, 2, day) || *p++ != 'T' || !parseDigits(p, 2, hour) || *p++ != ':' ||
+        !parseDigits(p, 2, minute) || *p++ != ':' || !parseDigits(p, 2, second)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+
+    unsigned micros = 0;
+    fraction = *p == '.';
+    if (fraction) {
+        p++;
+        int digits = 0;
+        while (*p >= '0' && *p <= '9' && digits < 6) {
+            micros = micros * 10 + (*p++ - '0');
+            digits++;
+        }
+        if (digits == 0) {
+            return false;
+        }
+        for (; digits < 6; digits++) {
+            micros *= 10;
+        }
+    }
+    if (*p != '\0') {
+        return false; // Fx tidszone eller flere end 6 decimaler: bevar teksten uændret
+    }
+
+    int64_t seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    us = seconds * 1000000LL + micros;
+    return true;
+}
+
+// Kopier tekst til JSON med escaping af " \ og kontroltegn
+static bool appendJsonString(char *buffer, size_t size, size_t &pos, const char *text) {
+    static const char hex[] = "0123456789abcdef";
+    for (const char *p = text; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            if (pos + 2 >= size) {
+                return false;
+            }
+            buffer[pos++] = '\\';
+            buffer[pos++] = c;
+        } else if (c < 0x20) {
+            if (pos + 6 >= size) {
+                return false;
+            }
+            memcpy(buffer + pos, "\\u00", 4);
+            buffer[pos + 4] = hex[c >> 4];
+            buffer[pos + 5] = hex[c & 0x0F];
+            pos += 6;
+        } else {
+            if (pos + 1 >= size) {
+                return false;
+            }
+            buffer[pos++] = c;
+        }
+    }
+    return true;
+}
+
+static bool appendRaw(char *buffer, size_t size, size_t &pos, const char *text, size_t length) {
+    if (pos + length >= size) {
+        return false;
+    }
+    memcpy(buffer + pos, text, length);
+    pos += length;
+    return true;
+}
+
+size_t encodeJson(const PlateReading &reading, char *buffer, size_t size) {
+    size_t pos = 0;
+    char lane[4];
+    int laneDigits = snprintf(lane, sizeof(lane), "%u", (unsigned)reading.lane);
+    if (!appendRaw(buffer, size, pos, "{\"plate\":\"", 10) || !appendJsonString(buffer, size, pos, reading.plate) ||
+        !appendRaw(buffer, size, pos, "\",\"timestamp\":\"", 15) ||
+        !appendJsonString(buffer, size, pos, reading.timestamp) || !appendRaw(buffer, size, pos, "\",\"lane\":", 9) ||
+        !appendRaw(buffer, size, pos, lane, laneDigits) || !appendRaw(buffer, size, pos, "}", 1)) {
+        return 0;
+    }
+    buffer[pos] = '\0';
+    return pos;
+}
+
+size_t encodePresenceJson(const PlateReading &reading, uint16_t count, char *buffer, size_t size) {
+    size_t pos = 0;
+    char number[8];
+    int digits = snprintf(number, sizeof(number), "%u", (unsigned)count);
+    if (!appendRaw(buffer, size, pos, "{\"plate\":\"", 10) || !appendJsonString(buffer, size, pos, reading.plate) ||
+        !appendRaw(buffer, size, pos, "\",\"count\":", 10) || !appendRaw(buffer, size, pos, number, digits) ||
+        !appendRaw(buffer, size, pos, "}", 1)) {
+        return 0;
+    }
+    buffer[pos] = '\0';
+    return pos;
+}
+
+size_t encodeBinary(const PlateReading &reading, uint8_t *buffer, size_t size) {
+    size_t plateLength = strnlen(reading.plate, sizeof(reading.plate));
+    int64_t us = 0;
+    bool fraction = false;
+    bool numericTime = parseIsoTime(reading.timestamp, us, fraction);
+    size_t timeLength = numericTime ? 8 : 1 + strnlen(reading.timestamp, sizeof(reading.timestamp));
+    size_t length = 3 + timeLength + 1 + plateLength;
+    if (length > size) {
+        return 0;
+    }
+
+    uint8_t *p = buffer;
+    *p++ = PAYLOAD_BINARY_MARKER | PAYLOAD_BINARY_VERSION;
+    *p++ = numericTime ? (fraction ? PAYLOAD_FLAG_FRACTION : 0) : PAYLOAD_FLAG_TEXT_TIME;
+    *p++ = reading.lane;
+    if (numericTime) {
+        for (int i = 0; i < 8; i++) {
+            *p++ = (uint8_t)((uint64_t)us >> (8 * i));
+        }
+    } else {
+        *p++ = (uint8_t)(timeLength - 1);
+        memcpy(p, reading.timestamp, timeLength - 1);
+        p += timeLength - 1;
+    }
+    *p++ = (uint8_t)plateLength;
+    memcpy(p, reading.plate, plateLength);
+    return length;
+}
+
+size_t encodePayload(PayloadFormat format, const PlateReading &reading, uint8_t *buffer, size_t size) {
+    if (format == PAYLOAD_BINARY) {
+        return encodeBinary(reading, buffer, size);
+    }
+    return encodeJson(reading, (char *)buffer, size);
+}
+
+bool decodeBinary(const uint8_t *data, size_t length, PlateReading &reading) {
+    // Version 1 havde ingen bane; den læses stadig, fx fra en ældre offline-log
+    bool hasLane = length > 0 && data[0] == (PAYLOAD_BINARY_MARKER | PAYLOAD_BINARY_VERSION);
+    if (length < (hasLane ? 4u : 3u) || (!hasLane && data[0] != (PAYLOAD_BINARY_MARKER | 1))) {
+        return false;
+    }
+    uint8_t flags = data[1];
+    reading.lane = hasLane ? data[2] : 0;
+    const uint8_t *p = data + (hasLane ? 3 : 2);
+    const uint8_t *end = data + length;
+
+    if (flags & PAYLOAD_FLAG_TEXT_TIME) {
+        size_t timeLength = *p++;
+        if (timeLength >= sizeof(reading.timestamp) || p + timeLength > end) {
+            return false;
+        }
+        memcpy(reading.timestamp, p, timeLength);
+        reading.timestamp[timeLength] = '\0';
+        p += timeLength;
+    } else {
+        if (p + 8 > end) {
+            return false;
+        }
+        uint64_t raw = 0;
+        for (int i = 0; i < 8; i++) {
+            raw |= (uint64_t)*p++ << (8 * i);
+        }
+        int64_t us = (int64_t)raw;
+        int64_t seconds = us >= 0 ? us / 1000000LL : (us - 999999) / 1000000LL;
+        int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+        int64_t secondOfDay = seconds - days * 86400;
+        int year;
+        unsigned month, day;
+        civilFromDays(days, year, month, day);
+        int written = snprintf(reading.timestamp, sizeof(reading.timestamp), "%04d-%02u-%02uT%02u:%02u:%02u", year,
+                               month, day, (unsigned)(secondOfDay / 3600), (unsigned)(secondOfDay / 60 % 60),
+                               (unsigned)(secondOfDay % 60));
+        if (flags & PAYLOAD_FLAG_FRACTION) {
+            snprintf(reading.timestamp + written, sizeof(reading.timestamp) - written, ".%06u",
+                     (unsigned)(us - seconds * 1000000LL));
+        }
+    }
+
+    if (p >= end) {
+        return false;
+    }
+    size_t plateLength = *p++;
+    if (plateLength >= sizeof(reading.plate) || p + plateLength != end) {
+        return false;
+    }
+    memcpy(reading.plate, p, plateLength);
+    reading.plate[plateLength] = '\0';
+    return true;
+}
+
+bool PayloadBatch::add(const uint8_t *record, size_t recordLength) {
+    if (recordLength == 0 || recordLength > 0xFF || full()) {
+        return false;
+    }
+    bool recordJson = record[0] == '{';
+    if (records == 0) {
+        // Første besked lægges forskudt, så hovedet kan skrives foran den i finish()
+        json = recordJson;
+        size_t header = json ? 1 : 3;
+        if (header + recordLength + 1 > size) {
+            return false;
+        }
+        memcpy(buffer + header, record, recordLength);
+        length = header + recordLength;
+        firstLength = recordLength;
+        records = 1;
+        return true;
+    }
+    if (recordJson != json) {
+        return false;
+    }
+    // Plads til separator/længde og det afsluttende ']'
+    if (length + 1 + recordLength + (json ? 1 : 0) > size) {
+        return false;
+    }
+    if (json) {
+        buffer[length++] = ',';
+    } else {
+        buffer[length++] = (uint8_t)recordLength;
+    }
+    memcpy(buffer + length, record, recordLength);
+    length += recordLength;
+    records++;
+    return true;
+}
+
+size_t PayloadBatch::finish() {
+    if (records == 0) {
+        return 0;
+    }
+    size_t header = json ? 1 : 3;
+    if (records == 1) {
+        // Én besked sendes uden ramme
+        memmove(buffer, buffer + header, firstLength);
+        length = firstLength;
+        return length;
+    }
+    if (json) {
+        buffer[0] = '[';
+        buffer[length++] = ']';
+    } else {
+        buffer[0] = PAYLOAD_BATCH_MARKER | PAYLOAD_BATCH_VERSION;
+        buffer[1] = (uint8_t)records;
+        buffer[2] = (uint8_t)firstLength;
+    }
+    return length;
+}
+
+void PayloadBatch::clear() {
+    records = 0;
+    length = 0;
+}
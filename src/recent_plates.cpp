@@ -0,0 +1,37 @@
+#include "recent_plates.h"
+
+// FNV-1a; 0 er forbeholdt tomme pladser
+uint32_t RecentPlates::hash(const char *plate) {
+    uint32_t h = 2166136261u;
+    for (const char *p = plate; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    return h == 0 ? 1 : h;
+}
+
+uint16_t RecentPlates::seen(const char *plate, int64_t nowUs, int64_t ttlUs) {
+    uint32_t h = hash(plate);
+    Entry *oldest = &entries[0];
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        Entry &entry = entries[i];
+        if (entry.hash == h) {
+            // Et ur der er sat tilbage (fx ved NTP) tæller som inden for ttl
+            if (nowUs - entry.lastSeenUs < ttlUs) {
+                entry.lastSeenUs = nowUs > entry.lastSeenUs ? nowUs : entry.lastSeenUs;
+                if (entry.repeats < 0xFFFF) {
+                    entry.repeats++;
+                }
+                return entry.repeats;
+            }
+            oldest = &entry; // Udløbet: genbrug pladsen
+            break;
+        }
+        if (entry.hash == 0 || (oldest->hash != 0 && entry.lastSeenUs < oldest->lastSeenUs)) {
+            oldest = &entry;
+        }
+    }
+    oldest->hash = h;
+    oldest->repeats = 0;
+    oldest->lastSeenUs = nowUs;
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "rtc_event_buffer.h"
+
+bool RtcEventBuffer::valid() const {
+    return head < CAPACITY && count <= CAPACITY && RtcSealed::valid();
+}
+
+bool RtcEventBuffer::push(int64_t us, uint8_t eventLane, uint8_t eventAttempts) {
+    if (full() || spilled > 0) {
+        return false;
+    }
+    captureUs[(head + count) % CAPACITY] = us;
+    lane[(head + count) % CAPACITY] = eventLane;
+    attempts[(head + count) % CAPACITY] = eventAttempts;
+    count++;
+    if (oldestUs == 0) {
+        oldestUs = us;
+    }
+    return true;
+}
+
+bool RtcEventBuffer::peek(uint8_t index, int64_t &us, uint8_t &eventLane, uint8_t &eventAttempts) const {
+    if (index >= count) {
+        return false;
+    }
+    us = captureUs[(head + index) % CAPACITY];
+    eventLane = lane[(head + index) % CAPACITY];
+    eventAttempts = attempts[(head + index) % CAPACITY];
+    return true;
+}
+
+void RtcEventBuffer::drop(uint8_t n) {
+    if (n > count) {
+        n = count;
+    }
+    head = (head + n) % CAPACITY;
+    count -= n;
+    // Den næste ældste ligger i ringen eller, når den er tom, på LittleFS (tid ukendt her)
+    oldestUs = count > 0 ? captureUs[head] : 0;
+}
+
+void RtcEventBuffer::spill(int64_t us) {
+    spilled++;
+    if (oldestUs == 0) {
+        oldestUs = us;
+    }
+}
+
+int64_t RtcEventBuffer::uploadInUs(int64_t nowUs, uint32_t minCount, int64_t maxAgeUs, uint8_t fillPercent,
+                                   int64_t retryUs) const {
+    if (pending() == 0) {
+        return -1;
+    }
+    int64_t waitUs = 0;
+    if (pending() < minCount && count * 100 < (uint32_t)CAPACITY * fillPercent && spilled == 0) {
+        waitUs = oldestUs != 0 ? oldestUs + maxAgeUs - nowUs : maxAgeUs; // Kun alderen kan udløse den
+    }
+    // Et ur der er sat tilbage må ikke forlænge ventetiden ud over retryUs
+    if (lastUploadUs != 0 && nowUs >= lastUploadUs && lastUploadUs + retryUs - nowUs > waitUs) {
+        waitUs = lastUploadUs + retryUs - nowUs;
+    }
+    return waitUs > 0 ? waitUs : 0;
+}
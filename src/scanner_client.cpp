@@ -0,0 +1,226 @@
+#include "scanner_client.h"
+
+#include <strings.h>
+#include <sys/select.h>
+
+bool ScannerClient::fetch(PlateReading &reading, uint8_t lane) {
+    char path[32];
+    snprintf(path, sizeof(path), lane == 0 ? "/get_plate" : "/get_plate?lane=%u", (unsigned)lane);
+    size_t count = 0;
+    int code = request(path, &reading, 1, count);
+    status = code;
+    if (code < 0) {
+        Serial.println("Kunne ikke hente data fra scanneren.");
+        return false;
+    }
+    if (code != 200) {
+        Serial.printf("HTTP GET fejlede med fejl: %d\n", code);
+        return false;
+    }
+    if (count == 0) {
+        Serial.println("Modtaget format er ugyldigt.");
+        return false;
+    }
+    return true;
+}
+
+size_t ScannerClient::fetchBatch(PlateReading *readings, size_t max, uint8_t lane) {
+    if (!batchEnabled) {
+        size_t count = 0;
+        while (count < max && fetch(readings[count], lane)) {
+            count++;
+        }
+        return count;
+    }
+
+    char path[40];
+    if (lane == 0) {
+        snprintf(path, sizeof(path), "/get_plates?max=%u", (unsigned)max);
+    } else {
+        snprintf(path, sizeof(path), "/get_plates?max=%u&lane=%u", (unsigned)max, (unsigned)lane);
+    }
+    size_t count = 0;
+    int code = request(path, readings, max, count);
+    status = code;
+    if (code == 404) {
+        Serial.println("Scanneren kender ikke /get_plates. Henter én plade ad gangen.");
+        batchEnabled = false;
+        return fetchBatch(readings, max, lane);
+    }
+    if (code < 0) {
+        Serial.println("Kunne ikke hente data fra scanneren.");
+        return 0;
+    }
+    if (code != 200) {
+        Serial.printf("HTTP GET fejlede med fejl: %d\n", code);
+        return 0;
+    }
+    return count;
+}
+
+int ScannerClient::request(const char *path, PlateReading *readings, size_t max, size_t &count) {
+    // En genbrugt forbindelse kan være lukket af scanneren siden sidst; prøv da én gang med en ny
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = client.connected();
+        if (!reused) {
+            if (!client.connect(host, port, timeoutMs)) {
+                return -1;
+            }
+            client.setNoDelay(true);
+            connectCount++;
+        }
+        bool responded = false;
+        int code = exchange(path, readings, max, count, responded);
+        if (code >= 0 || responded || !reused) {
+            return code;
+        }
+    }
+    return -1;
+}
+
+int ScannerClient::exchange(const char *path, PlateReading *readings, size_t max, size_t &count, bool &responded) {
+    count = 0;
+    bufferPos = 0;
+    bufferLen = 0;
+
+    char line[LINE_SIZE + 32];
+    int length = snprintf(line, sizeof(line), "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n", path, host);
+    if (length <= 0 || length >= (int)sizeof(line) || client.write((const uint8_t *)line, length) != (size_t)length) {
+        client.stop();
+        return -1;
+    }
+
+    // Statuslinje, fx "HTTP/1.1 200 OK". HTTP/1.1 holder forbindelsen åben som standard
+    if (!readLine(line, sizeof(line))) {
+        client.stop();
+        return -1;
+    }
+    responded = true;
+    if (strncmp(line, "HTTP/1.", 7) != 0) {
+        client.stop();
+        return -1;
+    }
+    bool keepAlive = line[7] == '1';
+    const char *space = strchr(line, ' ');
+    int code = space ? atoi(space + 1) : -1;
+
+    long contentLength = -1;
+    for (;;) {
+        if (!readLine(line, sizeof(line))) {
+            client.stop();
+            return -1;
+        }
+        if (line[0] == '\0') {
+            break;
+        }
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            contentLength = atol(line + 15);
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            const char *value = line + 11;
+            while (*value == ' ') {
+                value++;
+            }
+            keepAlive = strncasecmp(value, "close", 5) != 0;
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            Serial.println("Scanneren bruger chunked-svar, som ikke understøttes.");
+            client.stop();
+            return -1;
+        }
+    }
+
+    // Krop: "plade,tidsstempel" pr. linje, skrevet direkte ind i readings. Fejlsvar og
+    // linjer ud over max læses også, så forbindelsen kan genbruges bagefter
+    size_t plateLength = 0;
+    size_t stampLength = 0;
+    bool inStamp = false;
+    long remaining = contentLength;
+    uint8_t c;
+    while (remaining != 0) {
+        if (!readByte(c)) {
+            if (contentLength >= 0) {
+                client.stop(); // Afkortet svar
+                return -1;
+            }
+            break; // Uden Content-Length slutter kroppen når forbindelsen lukkes
+        }
+        if (remaining > 0) {
+            remaining--;
+        }
+        if (code != 200 || count >= max) {
+            continue;
+        }
+        PlateReading &reading = readings[count];
+        if (c == '\n' || c == '\r') {
+            if (inStamp && plateLength > 0) {
+                reading.plate[plateLength] = '\0';
+                reading.timestamp[stampLength] = '\0';
+                count++;
+            }
+            plateLength = 0;
+            stampLength = 0;
+            inStamp = false;
+        } else if (!inStamp) {
+            if (c == ',') {
+                inStamp = true;
+            } else if (plateLength < sizeof(reading.plate) - 1) {
+                reading.plate[plateLength++] = c;
+            }
+        } else if (stampLength < sizeof(reading.timestamp) - 1) {
+            reading.timestamp[stampLength++] = c;
+        }
+    }
+    // Enkeltsvaret fra /get_plate har ingen afsluttende linjeskift
+    if (code == 200 && count < max && inStamp && plateLength > 0) {
+        readings[count].plate[plateLength] = '\0';
+        readings[count].timestamp[stampLength] = '\0';
+        count++;
+    }
+
+    if (!keepAlive || contentLength < 0) {
+        client.stop();
+    }
+    return code;
+}
+
+bool ScannerClient::readByte(uint8_t &c) {
+    if (bufferPos == bufferLen) {
+        // Vent på data med select() i stedet for at spinne; lwIP understøtter det på klientens socket
+        if (client.available() <= 0) {
+            int fd = client.fd();
+            if (fd < 0) {
+                return false;
+            }
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(fd, &readable);
+            struct timeval timeout = {(time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000)};
+            if (select(fd + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+                return false;
+            }
+        }
+        int n = client.read(buffer, sizeof(buffer));
+        if (n <= 0) {
+            return false;
+        }
+        bufferPos = 0;
+        bufferLen = n;
+    }
+    c = buffer[bufferPos++];
+    return true;
+}
+
+// Læs en linje uden CR/LF; for lange linjer afkortes, men læses til ende
+bool ScannerClient::readLine(char *line, size_t size) {
+    size_t length = 0;
+    uint8_t c;
+    while (readByte(c)) {
+        if (c == '\n') {
+            line[length] = '\0';
+            return true;
+        }
+        if (c != '\r' && length < size - 1) {
+            line[length++] = c;
+        }
+    }
+    return false;
+}
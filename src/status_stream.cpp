@@ -0,0 +1,99 @@
+#include "status_stream.h"
+
+#include "payload_codec.h"
+
+void RecentEvents::add(const PlateReading &reading) {
+    readings[total % CAPACITY] = reading;
+    total++;
+}
+
+uint8_t RecentEvents::copy(PlateReading *out) const {
+    uint8_t count = total < CAPACITY ? total : CAPACITY;
+    for (uint8_t i = 0; i < count; i++) {
+        out[i] = readings[(total - 1 - i) % CAPACITY];
+    }
+    return count;
+}
+
+// snprintf svarer med den længde der var brug for; alt over bufferen er skåret af
+static size_t printed(int length, size_t size) {
+    if (length < 0) {
+        return 0;
+    }
+    return (size_t)length < size ? length : size - 1;
+}
+
+size_t StatusStream::writePart(uint32_t part, char *out, size_t size) const {
+    const StatusSnapshot &s = snapshot;
+    if (part == 0) {
+        return printed(snprintf(out, size,
+                                "{\"uptime_s\":%u,\"power\":\"%s\",\"wifi\":{\"connected\":%s,\"rssi\":%d,"
+                                "\"ip\":\"%u.%u.%u.%u\"},",
+                                (unsigned)s.uptimeS, s.powerState, s.wifiConnected ? "true" : "false", (int)s.rssi,
+                                (unsigned)(s.ip & 0xFF), (unsigned)((s.ip >> 8) & 0xFF),
+                                (unsigned)((s.ip >> 16) & 0xFF), (unsigned)(s.ip >> 24)),
+                       size);
+    }
+    if (part == 1) {
+        char records[12] = "null";
+        if (s.backlogKnown) {
+            snprintf(records, sizeof(records), "%u", (unsigned)s.backlogRecords);
+        }
+        return printed(snprintf(out, size,
+                                "\"mqtt\":{\"connected\":%s,\"attempts\":%u,\"in_flight\":%u},"
+                                "\"backlog\":{\"records\":%s,\"dropped\":%u},",
+                                s.mqttConnected ? "true" : "false", (unsigned)s.mqttAttempts,
+                                (unsigned)s.mqttInFlight, records, (unsigned)s.backlogDropped),
+                       size);
+    }
+    if (part == 2) {
+        return printed(snprintf(out, size,
+                                "\"pipeline\":{\"in_flight\":%u,\"plates\":%u,\"repeated\":%u,"
+                                "\"idle_timeout_ms\":%u},\"recent\":[",
+                                (unsigned)s.eventsInFlight, (unsigned)s.plates, (unsigned)s.repeatedPlates,
+                                (unsigned)s.idleTimeoutMs),
+                       size);
+    }
+
+    uint32_t event = part - 3;
+    if (event < s.eventCount) {
+        size_t pos = 0;
+        if (event > 0) {
+            out[pos++] = ',';
+        }
+        size_t length = encodeJson(s.events[event], out + pos, size - pos);
+        if (length == 0) {
+            return pos + printed(snprintf(out + pos, size - pos, "null"), size - pos);
+        }
+        return pos + length;
+    }
+    if (event == s.eventCount) {
+        return printed(snprintf(out, size, "]}"), size);
+    }
+    return 0;
+}
+
+size_t StatusStream::fill(uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (pendingOffset == pendingLength) {
+            if (done) {
+                break;
+            }
+            pendingLength = writePart(part++, pending, sizeof(pending));
+            pendingOffset = 0;
+            if (pendingLength == 0) {
+                done = true;
+                break;
+            }
+        }
+        size_t count = pendingLength - pendingOffset;
+        if (count > maxLen - written) {
+            count = maxLen - written;
+        }
+        memcpy(buffer + written, pending + pendingOffset, count);
+        pendingOffset += count;
+        written += count;
+    }
+    return written;
+}
@@ -0,0 +1,139 @@
+#include "telemetry.h"
+
+#include <stdarg.h>
+
+void LatencyHistogram::record(uint32_t us) {
+    uint8_t bucket = us == 0 ? 0 : 31 - __builtin_clz(us);
+    if (bucket >= BUCKETS) {
+        bucket = BUCKETS - 1;
+    }
+    if (buckets[bucket] < 0xFFFF) {
+        buckets[bucket]++;
+    }
+    count++;
+    if (us > maxUs) {
+        maxUs = us;
+    }
+}
+
+uint32_t LatencyHistogram::percentileUs(uint8_t pct) const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint32_t target = (total * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            uint32_t upper = i + 1 >= 32 ? UINT32_MAX : (1UL << (i + 1)) - 1;
+            return upper < maxUs ? upper : maxUs;
+        }
+    }
+    return maxUs;
+}
+
+void Telemetry::reset(int64_t nowUs) {
+    memset(this, 0, sizeof(*this));
+    periodStartUs = nowUs;
+    seal();
+}
+
+void Telemetry::record(TelemetryStage stage, int64_t us) {
+    if (stage >= STAGE_COUNT || us < 0) {
+        return;
+    }
+    stages[stage].record(us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+}
+
+void Telemetry::backlog(uint32_t depth) {
+    backlogDepth = depth;
+    if (depth > backlogMax) {
+        backlogMax = depth;
+    }
+}
+
+void Telemetry::power(PowerState state, int64_t us) {
+    if (state < POWER_STATE_COUNT && us > 0) {
+        powerUs[state] += us;
+    }
+}
+
+const char *Telemetry::powerStateName(PowerState state) {
+    static const char *const names[POWER_STATE_COUNT] = {"active", "modem_sleep", "light_sleep", "deep_sleep"};
+    return state < POWER_STATE_COUNT ? names[state] : "?";
+}
+
+const char *Telemetry::stageName(TelemetryStage stage) {
+    static const char *const names[STAGE_COUNT] = {"wake", "wifi", "ntp", "scanner", "publish", "drain", "boot"};
+    return stage < STAGE_COUNT ? names[stage] : "?";
+}
+
+// snprintf der lægger til i bufferen og husker om den løb fuld
+static bool appendf(char *buffer, size_t size, size_t &pos, const char *format, ...) {
+    if (pos >= size) {
+        return false;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + pos, size - pos, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= size - pos) {
+        pos = size;
+        return false;
+    }
+    pos += written;
+    return true;
+}
+
+size_t Telemetry::encodeJson(const char *deviceId, int64_t nowUs, uint32_t wakeToPublishMs, char *buffer,
+                             size_t size) const {
+    size_t pos = 0;
+    uint32_t periodS = periodStartUs > 0 && nowUs > periodStartUs ? (uint32_t)((nowUs - periodStartUs) / 1000000LL) : 0;
+    appendf(buffer, size, pos,
+            "{\"device\":\"%.*s\",\"period_s\":%u,\"wakes\":%u,\"short_wakes\":%u,\"dropped\":%u,\"debounced\":%u,"
+            "\"mqtt_attempts\":%u,\"plates\":%u,\"repeated_plates\":%u,\"backlog\":%u,\"backlog_max\":%u,"
+            "\"backlog_dropped\":%u,\"wake_to_publish_ms\":%u,\"idle_timeout_ms\":%u,\"power_ms\":{",
+            (int)DEVICE_ID_MAX, deviceId, (unsigned)periodS, (unsigned)wakes, (unsigned)shortWakes, (unsigned)droppedEvents,
+            (unsigned)debouncedEvents, (unsigned)mqttAttempts, (unsigned)plates, (unsigned)repeatedPlates,
+            (unsigned)backlogDepth, (unsigned)backlogMax, (unsigned)backlogDropped, (unsigned)wakeToPublishMs,
+            (unsigned)idleTimeoutMs);
+    for (uint8_t p = 0; p < POWER_STATE_COUNT; p++) {
+        appendf(buffer, size, pos, "%s\"%s\":%lu", p == 0 ? "" : ",", powerStateName((PowerState)p),
+                (unsigned long)(powerUs[p] / 1000));
+    }
+    appendf(buffer, size, pos, "},\"stages\":{");
+
+    // Kun spandene mellem første og sidste brugte sendes; "lo" er indekset for den første
+    bool first = true;
+    for (uint8_t s = 0; s < STAGE_COUNT; s++) {
+        const LatencyHistogram &histogram = stages[s];
+        if (histogram.count == 0) {
+            continue;
+        }
+        uint8_t lo = 0;
+        uint8_t hi = LatencyHistogram::BUCKETS - 1;
+        while (lo < hi && histogram.buckets[lo] == 0) {
+            lo++;
+        }
+        while (hi > lo && histogram.buckets[hi] == 0) {
+            hi--;
+        }
+        appendf(buffer, size, pos, "%s\"%s\":{\"n\":%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u,\"lo\":%u,\"b\":[",
+                first ? "" : ",", stageName((TelemetryStage)s), (unsigned)histogram.count,
+                (unsigned)histogram.percentileUs(50), (unsigned)histogram.percentileUs(90),
+                (unsigned)histogram.percentileUs(99), (unsigned)histogram.maxUs, (unsigned)lo);
+        for (uint8_t i = lo; i <= hi; i++) {
+            appendf(buffer, size, pos, i == lo ? "%u" : ",%u", (unsigned)histogram.buckets[i]);
+        }
+        appendf(buffer, size, pos, "]}");
+        first = false;
+    }
+    if (!appendf(buffer, size, pos, "}}")) {
+        return 0;
+    }
+    return pos;
+}
@@ -0,0 +1,35 @@
+#include "wake_cache.h"
+
+// Drift måles kun over intervaller lange nok til at NTP's egen usikkerhed (ms) ikke dominerer
+static const int64_t MIN_DRIFT_INTERVAL_US = 600LL * 1000000LL;
+// ESP32's RTC-ur (150 kHz RC) holder sig inden for nogle procent; mere end det er en fejlmåling
+static const int32_t MAX_DRIFT_PPB = 100000000;
+
+void WakeCache::reset() {
+    memset(this, 0, sizeof(*this));
+    backlogRecords = BACKLOG_UNKNOWN;
+    seal();
+}
+
+int64_t WakeCache::driftCorrectionUs(int64_t nowUs) const {
+    if (!clockSynced() || nowUs <= correctedUs) {
+        return 0;
+    }
+    // Regnes i ms, så produktet ikke løber over ved lange søvnperioder
+    return (nowUs - correctedUs) / 1000 * driftPpb / 1000000LL;
+}
+
+void WakeCache::recordSync(int64_t localUs, int64_t ntpUs) {
+    int64_t elapsedUs = localUs - ntpSyncUs;
+    if (clockSynced() && elapsedUs >= MIN_DRIFT_INTERVAL_US) {
+        int64_t drift = driftPpb + (ntpUs - localUs) * 1000000000LL / elapsedUs;
+        if (drift > MAX_DRIFT_PPB) {
+            drift = MAX_DRIFT_PPB;
+        } else if (drift < -MAX_DRIFT_PPB) {
+            drift = -MAX_DRIFT_PPB;
+        }
+        driftPpb = (int32_t)drift;
+    }
+    ntpSyncUs = ntpUs;
+    correctedUs = ntpUs;
+}
@@ -0,0 +1,43 @@
+#include "web_asset.h"
+
+#include "checksum.h"
+
+const char *WebAsset::etag(fs::FS &fs) {
+    if (tag[0] != '\0') {
+        return tag;
+    }
+    char gzPath[48];
+    snprintf(gzPath, sizeof(gzPath), "%s.gz", path);
+    const char *file = fs.exists(gzPath) ? gzPath : path;
+    if (!fs.exists(file)) {
+        return tag;
+    }
+    File asset = fs.open(file, FILE_READ);
+    uint8_t buffer[256];
+    uint32_t crc = 0;
+    size_t length;
+    while ((length = asset.read(buffer, sizeof(buffer))) > 0) {
+        crc = crc32(buffer, length, crc);
+    }
+    asset.close();
+    snprintf(tag, sizeof(tag), "\"%08x\"", (unsigned)crc);
+    return tag;
+}
+
+void WebAsset::serve(fs::FS &fs, AsyncWebServerRequest *request) {
+    const char *current = etag(fs);
+    if (current[0] == '\0') {
+        request->send(404, "text/plain", "Filen findes ikke.");
+        return;
+    }
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == current) {
+        response = request->beginResponse(304);
+    } else {
+        // Uden den ukomprimerede fil vælger biblioteket selv .gz og sætter Content-Encoding
+        response = request->beginResponse(fs, path, contentType);
+    }
+    response->addHeader("ETag", current);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
@@ -1,8 +1,10 @@
 import sqlite3
+import json
+from datetime import datetime
 from flask import Flask, render_template, jsonify, request
 from flask_sqlalchemy import SQLAlchemy
 import paho.mqtt.client as mqtt
-import json
+from payload_codec import decode_records
 
 # Flask setup
 app = Flask(__name__)
@@ -15,47 +17,109 @@ class Plate(db.Model):
     id = db.Column(db.Integer, primary_key=True)
     plate = db.Column(db.String(20), nullable=False)
     timestamp = db.Column(db.String(50), nullable=False)
+    lane = db.Column(db.Integer, nullable=False, default=0)  # Bane på enheder med flere sensorer
+
+class Telemetry(db.Model):
+    id = db.Column(db.Integer, primary_key=True)
+    device = db.Column(db.String(40), nullable=False)
+    received = db.Column(db.String(50), nullable=False)
+    data = db.Column(db.Text, nullable=False)  # Beskeden som JSON (histogrammer og tællere)
+
+class Presence(db.Model):
+    # Gentagne observationer af en plade der holder ved porten (ikke nye rækker i Plate)
+    plate = db.Column(db.String(20), primary_key=True)
+    count = db.Column(db.Integer, nullable=False)
+    last_seen = db.Column(db.String(50), nullable=False)
 
 # MQTT Configuration
 MQTT_BROKER = "broker.hivemq.com"
 MQTT_PORT = 1883
 MQTT_TOPIC = "plates/detected"
+MQTT_TELEMETRY_TOPIC = "plates/telemetry"
+MQTT_PRESENCE_TOPIC = "plates/present"
 
 # MQTT Callbacks
 def on_connect(client, userdata, flags, rc):
     if rc == 0:
         print("Connected to MQTT broker!")
         client.subscribe(MQTT_TOPIC)
+        client.subscribe(MQTT_TELEMETRY_TOPIC)
+        client.subscribe(MQTT_PRESENCE_TOPIC)
     else:
         print(f"Failed to connect, return code {rc}")
 
 def on_message(client, userdata, msg):
+    if msg.topic == MQTT_TELEMETRY_TOPIC:
+        on_telemetry(msg)
+        return
+    if msg.topic == MQTT_PRESENCE_TOPIC:
+        on_presence(msg)
+        return
     try:
-        data = msg.payload.decode('utf-8')
-        print(f"Raw MQTT message: {data}")  # Log beskeden
-        plate, timestamp = parse_message(data)
-        save_to_database(plate, timestamp)
-        print(f"Data saved: Plate={plate}, Timestamp={timestamp}")
+        payload = msg.payload
+        if payload[:1] == b'{':
+            print(f"Raw MQTT message: {payload.decode('utf-8', 'replace')}")  # Log beskeden
+        else:
+            print(f"Raw MQTT message: {payload.hex()}")  # Binær besked logges som hex
+        records = parse_message(payload)
+        save_to_database(records)
+        for plate, timestamp, lane in records:
+            print(f"Data saved: Plate={plate}, Timestamp={timestamp}, Lane={lane}")
     except Exception as e:
         print(f"Error processing message: {e}")
 
 
+def on_telemetry(msg):
+    try:
+        data = json.loads(msg.payload.decode('utf-8'))
+        with app.app_context():
+            db.session.add(Telemetry(device=data.get('device', '?'),
+                                     received=datetime.now().isoformat(timespec='seconds'),
+                                     data=json.dumps(data)))
+            db.session.commit()
+        print(f"Telemetry saved from {data.get('device', '?')}")
+    except Exception as e:
+        print(f"Error processing telemetry: {e}")
+
+
+def on_presence(msg):
+    # Tællingen er antal gentagelser siden pladen blev sendt som hændelse
+    try:
+        data = json.loads(msg.payload.decode('utf-8'))
+        with app.app_context():
+            presence = db.session.get(Presence, data['plate'])
+            if presence is None:
+                presence = Presence(plate=data['plate'], count=0)
+                db.session.add(presence)
+            presence.count = data['count']
+            presence.last_seen = datetime.now().isoformat(timespec='seconds')
+            db.session.commit()
+        print(f"Plate {data['plate']} still present ({data['count']} repeats)")
+    except Exception as e:
+        print(f"Error processing presence: {e}")
+
+
 # Helper Functions
 def parse_message(message):
-    try:
-        data = json.loads(message)  # Parse JSON
-        plate = data['plate']       # Hent nummerpladen
-        timestamp = data['timestamp']  # Hent tidsstempel
-        return plate, timestamp
-    except (json.JSONDecodeError, KeyError) as e:
-        raise ValueError(f"Invalid message format: {message}") from e
-
-def save_to_database(plate, timestamp):
+    # JSON eller det binære format fra ESP32'en, enkelt eller samlet (se payload_codec.py)
+    if isinstance(message, str):
+        message = message.encode('utf-8')
+    return decode_records(message)
+
+def save_to_database(records):
+    # En samlet besked gemmes i én transaktion
     with app.app_context():
-        new_entry = Plate(plate=plate, timestamp=timestamp)
-        db.session.add(new_entry)
+        for plate, timestamp, lane in records:
+            db.session.add(Plate(plate=plate, timestamp=timestamp, lane=lane))
         db.session.commit()
 
+def migrate_database():
+    # plates.db fra før banerne: create_all tilføjer ikke kolonner til en eksisterende tabel
+    columns = [column['name'] for column in db.inspect(db.engine).get_columns('plate')]
+    if 'lane' not in columns:
+        with db.engine.begin() as connection:
+            connection.execute(db.text('ALTER TABLE plate ADD COLUMN lane INTEGER NOT NULL DEFAULT 0'))
+
 # Flask Routes
 @app.route('/')
 def index():
@@ -66,7 +130,21 @@ def index():
 def api_get_plates():
     limit = request.args.get('limit', default=10, type=int)
     plates = Plate.query.order_by(Plate.timestamp.desc()).limit(limit).all()
-    return jsonify([{"id": p.id, "plate": p.plate, "timestamp": p.timestamp} for p in plates])
+    return jsonify([{"id": p.id, "plate": p.plate, "timestamp": p.timestamp, "lane": p.lane} for p in plates])
+
+@app.route('/api/presence', methods=['GET'])
+def api_get_presence():
+    entries = Presence.query.order_by(Presence.last_seen.desc()).all()
+    return jsonify([{"plate": p.plate, "count": p.count, "last_seen": p.last_seen} for p in entries])
+
+@app.route('/api/telemetry', methods=['GET'])
+def api_get_telemetry():
+    # Seneste telemetri pr. enhed, så langsomme steder kan sammenlignes
+    latest = {}
+    for t in Telemetry.query.order_by(Telemetry.id.desc()).all():
+        if t.device not in latest:
+            latest[t.device] = {"received": t.received, **json.loads(t.data)}
+    return jsonify(list(latest.values()))
 
 # MQTT Setup
 mqtt_client = mqtt.Client()
@@ -78,6 +156,7 @@ if __name__ == '__main__':
     # Initialize Database
     with app.app_context():
         db.create_all()
+        migrate_database()
 
     # Start MQTT Client
     mqtt_client.connect(MQTT_BROKER, MQTT_PORT, 60)
@@ -0,0 +1,110 @@
+import datetime
+import json
+import struct
+
+# Afkodning af beskeder fra ESP32'en; skal følge include/payload_codec.h
+#
+# JSON:   {"plate":"...","timestamp":"...","lane":0}  (lane mangler fra ældre enheder)
+# Binær:  [0xA0 | version][flag][bane][tid][plade]  (version 1 har ingen bane)
+#         flag bit 0: tid er uint8 længde + tekst, ellers int64 (little endian)
+#                     mikrosekunder siden 1970-01-01T00:00:00 i lokal tid
+#         flag bit 1: tidsstemplet har brøkdel (skrives med 6 decimaler)
+#         plade: uint8 længde + tegn
+#
+# Samlede beskeder (backloggen sendes med flere poster pr. besked):
+# JSON:   [{...},{...}]
+# Binær:  [0xB0 | version][antal] og så antal gange uint8 længde + binær besked
+
+BINARY_MARKER = 0xA0
+BINARY_VERSION = 2
+FLAG_TEXT_TIME = 0x01
+FLAG_FRACTION = 0x02
+
+BATCH_MARKER = 0xB0
+BATCH_VERSION = 1
+
+EPOCH = datetime.datetime(1970, 1, 1)
+
+
+def decode_records(payload):
+    """Returnerer en liste af (plate, timestamp, lane) for en enkelt eller samlet besked."""
+    if not payload:
+        raise ValueError("Tom besked")
+    if payload[0] == ord('['):
+        try:
+            items = json.loads(payload.decode('utf-8'))
+            return [(item['plate'], item['timestamp'], item.get('lane', 0)) for item in items]
+        except (UnicodeDecodeError, json.JSONDecodeError, KeyError, TypeError) as e:
+            raise ValueError(f"Invalid message format: {payload!r}") from e
+    if payload[0] & 0xF0 == BATCH_MARKER:
+        return decode_binary_batch(payload)
+    return [decode_payload(payload)]
+
+
+def decode_payload(payload):
+    """Returnerer (plate, timestamp, lane) for en JSON- eller binær besked."""
+    if not payload:
+        raise ValueError("Tom besked")
+    if payload[0] == ord('{'):
+        return decode_json(payload)
+    if payload[0] & 0xF0 == BINARY_MARKER:
+        return decode_binary(payload)
+    raise ValueError(f"Ukendt beskedformat: {payload[:8]!r}")
+
+
+def decode_json(payload):
+    try:
+        data = json.loads(payload.decode('utf-8'))
+        return data['plate'], data['timestamp'], data.get('lane', 0)
+    except (UnicodeDecodeError, json.JSONDecodeError, KeyError) as e:
+        raise ValueError(f"Invalid message format: {payload!r}") from e
+
+
+def decode_binary(payload):
+    version = payload[0] & 0x0F
+    if version not in (1, BINARY_VERSION):
+        raise ValueError(f"Ukendt version af binært format: {version}")
+    pos = 2 if version == 1 else 3
+    if len(payload) < pos + 1:
+        raise ValueError("Afkortet binær besked")
+    flags = payload[1]
+    lane = 0 if version == 1 else payload[2]
+
+    if flags & FLAG_TEXT_TIME:
+        length = payload[pos]
+        timestamp = payload[pos + 1:pos + 1 + length].decode('utf-8')
+        pos += 1 + length
+    else:
+        (micros,) = struct.unpack_from('<q', payload, pos)
+        pos += 8
+        moment = EPOCH + datetime.timedelta(microseconds=micros)
+        timespec = 'microseconds' if flags & FLAG_FRACTION else 'seconds'
+        timestamp = moment.isoformat(timespec=timespec)
+
+    if pos >= len(payload):
+        raise ValueError("Afkortet binær besked")
+    length = payload[pos]
+    plate = payload[pos + 1:pos + 1 + length].decode('utf-8')
+    if pos + 1 + length != len(payload):
+        raise ValueError("Binær besked har forkert længde")
+    return plate, timestamp, lane
+
+
+def decode_binary_batch(payload):
+    version = payload[0] & 0x0F
+    if version != BATCH_VERSION:
+        raise ValueError(f"Ukendt version af samlet besked: {version}")
+    if len(payload) < 2:
+        raise ValueError("Afkortet samlet besked")
+    count = payload[1]
+    pos = 2
+    records = []
+    for _ in range(count):
+        if pos >= len(payload):
+            raise ValueError("Afkortet samlet besked")
+        length = payload[pos]
+        records.append(decode_binary(payload[pos + 1:pos + 1 + length]))
+        pos += 1 + length
+    if pos != len(payload):
+        raise ValueError("Samlet besked har forkert længde")
+    return records
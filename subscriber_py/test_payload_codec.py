@@ -0,0 +1,56 @@
+import pytest
+
+from payload_codec import decode_payload, decode_records
+
+# Afkodning af faste beskeder som firmwarens kodere skriver dem: `pytest subscriber_py`
+#
+# Bytene står også i test/test_payload_codec, der kontrollerer at firmwaren stadig
+# skriver præcis disse. Ændres formatet, skal begge filer følge med.
+
+FRACTION_V2 = bytes([0xA2, 0x02, 0x02, 0x00, 0x48, 0xFD, 0xC6, 0x0F, 0x29, 0x06, 0x00, 0x08]) + b'A000AA78'
+SECONDS_V2 = bytes([0xA2, 0x00, 0x00, 0x40, 0x93, 0x49, 0xC7, 0x0F, 0x29, 0x06, 0x00, 0x07]) + b'XY12345'
+TEXT_TIME_V2 = bytes([0xA2, 0x01, 0x01, 0x10]) + b'12/12/2024 10:00' + bytes([0x03]) + b'AB1'
+# Version 1 fra ældre enheder: uden banebyte
+FRACTION_V1 = bytes([0xA1, 0x02, 0x00, 0x48, 0xFD, 0xC6, 0x0F, 0x29, 0x06, 0x00, 0x08]) + b'A000AA78'
+BINARY_BATCH = (bytes([0xB1, 0x02, len(FRACTION_V2)]) + FRACTION_V2 + bytes([len(SECONDS_V2)]) + SECONDS_V2)
+JSON_ARRAY = (b'[{"plate":"A000AA78","timestamp":"2024-12-12T10:00:00.000000","lane":2},'
+              b'{"plate":"XY12345","timestamp":"2024-12-12T10:00:05","lane":0}]')
+
+FRACTION = ('A000AA78', '2024-12-12T10:00:00.000000', 2)
+SECONDS = ('XY12345', '2024-12-12T10:00:05', 0)
+
+
+def test_binary_v2():
+    assert decode_payload(FRACTION_V2) == FRACTION
+    assert decode_payload(SECONDS_V2) == SECONDS
+    assert decode_payload(TEXT_TIME_V2) == ('AB1', '12/12/2024 10:00', 1)
+
+
+def test_binary_batch():
+    assert decode_records(BINARY_BATCH) == [FRACTION, SECONDS]
+
+
+def test_json_array():
+    assert decode_records(JSON_ARRAY) == [FRACTION, SECONDS]
+
+
+def test_single_messages_are_not_batches():
+    assert decode_records(FRACTION_V2) == [FRACTION]
+    assert decode_records(b'{"plate":"XY12345","timestamp":"2024-12-12T10:00:05"}') == [SECONDS]
+
+
+def test_binary_v1_has_lane_zero():
+    assert decode_payload(FRACTION_V1) == ('A000AA78', '2024-12-12T10:00:00.000000', 0)
+
+
+@pytest.mark.parametrize('payload', [
+    bytes([0xA3]) + FRACTION_V2[1:],
+    FRACTION_V2[:-1],
+    BINARY_BATCH[:-1],
+    bytes([0xB2]) + BINARY_BATCH[1:],
+    JSON_ARRAY[:-1],
+    b'',
+])
+def test_rejects_broken_messages(payload):
+    with pytest.raises(ValueError):
+        decode_records(payload)
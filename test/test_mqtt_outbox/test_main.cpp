@@ -0,0 +1,222 @@
+// Enhedstest af MqttOutbox på host: `pio test -e native -f test_mqtt_outbox`
+//
+// Vinduet, kvitteringerne og genudsendelsen køres mod LocalBroker fra måleprogrammet.
+// Svar der kommer i bidder og skrivninger der kun delvis lykkes styres med en
+// forbindelse hvor testen selv bestemmer hvad der kan læses og skrives.
+#include <unity.h>
+
+#include <deque>
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+#include "local_services.h"
+#include "mqtt_outbox.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+namespace {
+
+const uint8_t payload[] = {'{', '}'};
+
+// Forbindelse uden netværk: incoming er det brokeren har sendt, writeLimit hvor mange
+// bytes der kan skrives i alt, før skrivningerne bliver korte
+class ScriptedClient : public Client {
+public:
+    using Print::write;
+
+    int connect(IPAddress, uint16_t) override { return 1; }
+    int connect(const char *, uint16_t) override { return 1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override {
+        size_t n = size < writeLimit ? size : writeLimit;
+        writeLimit -= n;
+        written.insert(written.end(), buffer, buffer + n);
+        return n;
+    }
+    int available() override { return static_cast<int>(incoming.size()); }
+    int read() override {
+        if (incoming.empty()) {
+            return -1;
+        }
+        int c = incoming.front();
+        incoming.pop_front();
+        return c;
+    }
+    int read(uint8_t *buffer, size_t size) override {
+        size_t n = 0;
+        for (; n < size && !incoming.empty(); n++) {
+            buffer[n] = static_cast<uint8_t>(read());
+        }
+        return n > 0 ? static_cast<int>(n) : -1;
+    }
+    int peek() override { return incoming.empty() ? -1 : incoming.front(); }
+    void stop() override { stopped = true; }
+    uint8_t connected() override { return !stopped; }
+    explicit operator bool() override { return !stopped; }
+
+    void feed(std::initializer_list<uint8_t> bytes) { incoming.insert(incoming.end(), bytes); }
+
+    std::deque<uint8_t> incoming;
+    std::vector<uint8_t> written;
+    size_t writeLimit = SIZE_MAX;
+    bool stopped = false;
+};
+
+uint32_t ackCount = 0;
+
+void countAck(uint32_t) { ackCount++; }
+
+// Poll til alt før seq er kvitteret; false ved fejl eller timeout
+bool pollUntilAcked(MqttOutbox &outbox, uint32_t seq, int timeoutMs = 3000) {
+    unsigned long start = millis();
+    while (outbox.ackedSeq() < seq) {
+        if (!outbox.poll() || millis() - start > (unsigned long)timeoutMs) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+}  // namespace
+
+// Højst window beskeder venter på PUBACK; brokerens kvitteringer flytter ackedSeq til
+// slutningen af hver besked og åbner vinduet igen
+void test_window_limits_unacked_messages() {
+    LocalBroker broker;
+    broker.setAckDelay(200);
+    WiFiClient client;
+    TEST_ASSERT_TRUE(client.connect("127.0.0.1", broker.port()));
+    MqttOutbox outbox(client);
+    outbox.setWindow(4);
+    ackCount = 0;
+    outbox.onAck(countAck);
+
+    for (uint32_t i = 1; i <= 4; i++) {
+        TEST_ASSERT_TRUE(outbox.publish("t", payload, sizeof(payload), i * 10));
+    }
+    TEST_ASSERT_FALSE(outbox.canSend());
+    TEST_ASSERT_FALSE(outbox.publish("t", payload, sizeof(payload), 50));
+    TEST_ASSERT_EQUAL_UINT8(4, outbox.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(40, outbox.sentSeq());
+    TEST_ASSERT_TRUE(client.connected()); // Et fuldt vindue er ikke en fejl
+
+    TEST_ASSERT_TRUE(pollUntilAcked(outbox, 40));
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(4, ackCount);
+    TEST_ASSERT_TRUE(outbox.canSend());
+    TEST_ASSERT_TRUE(broker.waitForPublishes(4, 1000));
+}
+
+// En PUBACK kvitterer kun beskeden med samme pakke-id; springer den frem, venter
+// ackedSeq på de ældre, og ukendte id'er ignoreres
+void test_puback_matches_packet_id() {
+    ScriptedClient client;
+    MqttOutbox outbox(client);
+    outbox.setKeepAlive(0);
+    TEST_ASSERT_TRUE(outbox.publish("t", payload, sizeof(payload), 3)); // Pakke-id 1
+    TEST_ASSERT_TRUE(outbox.publish("t", payload, sizeof(payload), 7)); // 2
+    TEST_ASSERT_TRUE(outbox.publish("t", payload, sizeof(payload), 12)); // 3
+
+    client.feed({0x40, 0x02, 0x00, 0x02});
+    TEST_ASSERT_TRUE(outbox.poll());
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.ackedSeq());
+    TEST_ASSERT_EQUAL_UINT8(3, outbox.inFlight());
+
+    client.feed({0x40, 0x02, 0x00, 0x09});
+    TEST_ASSERT_TRUE(outbox.poll());
+    TEST_ASSERT_EQUAL_UINT8(3, outbox.inFlight());
+
+    client.feed({0x40, 0x02, 0x00, 0x01});
+    TEST_ASSERT_TRUE(outbox.poll());
+    TEST_ASSERT_EQUAL_UINT32(7, outbox.ackedSeq());
+    TEST_ASSERT_EQUAL_UINT8(1, outbox.inFlight());
+
+    client.feed({0x40, 0x02, 0x00, 0x03});
+    TEST_ASSERT_TRUE(outbox.poll());
+    TEST_ASSERT_EQUAL_UINT32(12, outbox.ackedSeq());
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.inFlight());
+}
+
+// TCP kan dele et svar over flere segmenter; pakken samles over flere kald af poll()
+void test_split_packets_are_buffered() {
+    ScriptedClient client;
+    MqttOutbox outbox(client);
+    outbox.setKeepAlive(0);
+    TEST_ASSERT_TRUE(outbox.publish("t", payload, sizeof(payload), 1));
+
+    client.feed({0xD0}); // PINGRESP
+    TEST_ASSERT_TRUE(outbox.poll());
+    client.feed({0x00, 0x40});
+    TEST_ASSERT_TRUE(outbox.poll());
+    client.feed({0x02, 0x00});
+    TEST_ASSERT_TRUE(outbox.poll());
+    TEST_ASSERT_EQUAL_UINT8(1, outbox.inFlight());
+    client.feed({0x01});
+    TEST_ASSERT_TRUE(outbox.poll());
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.ackedSeq());
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.inFlight());
+    TEST_ASSERT_FALSE(client.stopped);
+}
+
+// En PUBLISH der kun delvis kunne skrives, hverken i headeren eller i beskeden, lukker
+// forbindelsen og regnes ikke som sendt
+void test_short_write_disconnects() {
+    ScriptedClient header;
+    header.writeLimit = 3;
+    MqttOutbox outbox(header);
+    TEST_ASSERT_FALSE(outbox.publish("t", payload, sizeof(payload), 1));
+    TEST_ASSERT_TRUE(header.stopped);
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.inFlight());
+
+    ScriptedClient body;
+    body.writeLimit = 1 + 1 + 2 + 1 + 2 + 1; // Header, emne og pakke-id, men kun en byte af beskeden
+    MqttOutbox second(body);
+    TEST_ASSERT_FALSE(second.publish("t", payload, sizeof(payload), 1));
+    TEST_ASSERT_TRUE(body.stopped);
+    TEST_ASSERT_EQUAL_UINT8(0, second.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(0, second.sentSeq());
+}
+
+// Efter en tabt forbindelse glemmer reset() det ukvitterede, og det sendes igen fra resendFrom
+void test_reset_resends_unacked() {
+    LocalBroker broker;
+    broker.setAckDelay(1000);
+    WiFiClient client;
+    TEST_ASSERT_TRUE(client.connect("127.0.0.1", broker.port()));
+    MqttOutbox outbox(client);
+    for (uint32_t i = 1; i <= 3; i++) {
+        TEST_ASSERT_TRUE(outbox.publish("t", payload, sizeof(payload), i));
+    }
+    TEST_ASSERT_TRUE(broker.waitForPublishes(3, 1000));
+    broker.setAvailable(false);
+    client.stop();
+
+    outbox.reset(0);
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.ackedSeq());
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.sentSeq());
+    TEST_ASSERT_EQUAL_UINT32(3, outbox.resends());
+
+    broker.setAvailable(true);
+    broker.setAckDelay(0);
+    TEST_ASSERT_TRUE(client.connect("127.0.0.1", broker.port()));
+    for (uint32_t i = 1; i <= 3; i++) {
+        TEST_ASSERT_TRUE(outbox.publish("t", payload, sizeof(payload), i));
+    }
+    TEST_ASSERT_TRUE(pollUntilAcked(outbox, 3));
+    TEST_ASSERT_TRUE(broker.waitForPublishes(6, 1000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_window_limits_unacked_messages);
+    RUN_TEST(test_puback_matches_packet_id);
+    RUN_TEST(test_split_packets_are_buffered);
+    RUN_TEST(test_short_write_disconnects);
+    RUN_TEST(test_reset_resends_unacked);
+    return UNITY_END();
+}
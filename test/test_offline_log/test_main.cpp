@@ -0,0 +1,166 @@
+// Enhedstest af OfflineLog på host: `pio test -e native -f test_offline_log`
+//
+// Hver test får sin egen mappe som LittleFS-rod, så de starter fra en tom flash.
+// Ødelagte poster og markørslots laves ved at skrive direkte i segmentfilerne.
+#include <stdlib.h>
+#include <unity.h>
+
+#include <string>
+
+#include "LittleFS.h"
+#include "native_shim.h"
+#include "offline_log.h"
+
+void setUp() {
+    char root[] = "/tmp/offline_log_test_XXXXXX";
+    nativeshim::setFsRoot(mkdtemp(root));
+}
+
+void tearDown() {}
+
+namespace {
+
+void appendNumbers(OfflineLog &log, uint32_t from, uint32_t to) {
+    for (uint32_t i = from; i < to; i++) {
+        std::string message = std::to_string(i);
+        TEST_ASSERT_TRUE(log.append(message.c_str()));
+    }
+}
+
+// Indholdet af post nr. seq, eller "" hvis den ikke kan læses
+std::string readSeq(OfflineLog &log, uint32_t seq) {
+    uint8_t buffer[OfflineLog::PAYLOAD_SIZE];
+    size_t length = 0;
+    if (!log.read(seq, buffer, sizeof(buffer), length)) {
+        return "";
+    }
+    return std::string(reinterpret_cast<char *>(buffer), length);
+}
+
+// Overskriv length bytes fra offset i path, som en skrivning der blev afbrudt
+void corrupt(const char *path, uint32_t offset, size_t length) {
+    File file = LittleFS.open(path, "r+");
+    TEST_ASSERT_TRUE(file);
+    TEST_ASSERT_TRUE(file.seek(offset));
+    for (size_t i = 0; i < length; i++) {
+        file.write(static_cast<uint8_t>(0xA5));
+    }
+    file.close();
+}
+
+}  // namespace
+
+// Strømsvigt midt i en tilføjelse: den halve post regnes ikke med, og den næste
+// tilføjelse skriver oven i den
+void test_recovers_torn_record() {
+    OfflineLog log;
+    log.begin(LittleFS, "/log", 2, 8);
+    appendNumbers(log, 0, 5);
+    log.end();
+    corrupt("/log/seg0.bin", 4 * OfflineLog::RECORD_SIZE + 8, 8); // Længde og starten af indholdet
+
+    log.begin(LittleFS, "/log", 2, 8);
+    TEST_ASSERT_EQUAL_UINT32(0, log.oldestSeq());
+    TEST_ASSERT_EQUAL_UINT32(4, log.nextSeq());
+    TEST_ASSERT_EQUAL_STRING("3", readSeq(log, 3).c_str());
+
+    TEST_ASSERT_TRUE(log.append("ny"));
+    TEST_ASSERT_EQUAL_STRING("ny", readSeq(log, 4).c_str());
+    log.end();
+
+    log.begin(LittleFS, "/log", 2, 8);
+    TEST_ASSERT_EQUAL_UINT32(5, log.nextSeq());
+    TEST_ASSERT_EQUAL_STRING("ny", readSeq(log, 4).c_str());
+    log.end();
+}
+
+// Markøren skrives skiftevis i to slots; er det nyeste ødelagt, bruges det forrige, og
+// næste commit overskriver det ødelagte i stedet for det gyldige
+void test_cursor_falls_back_to_other_slot() {
+    OfflineLog log;
+    log.begin(LittleFS, "/log", 2, 64);
+    appendNumbers(log, 0, 40);
+    log.popUntil(10);
+    TEST_ASSERT_TRUE(log.commit());
+    log.popUntil(20);
+    TEST_ASSERT_TRUE(log.commit());
+    log.end();
+
+    log.begin(LittleFS, "/log", 2, 64);
+    TEST_ASSERT_EQUAL_UINT32(20, log.oldestSeq());
+    log.end();
+
+    corrupt("/log/cursor.bin", 8, 8);
+    log.begin(LittleFS, "/log", 2, 64);
+    TEST_ASSERT_EQUAL_UINT32(10, log.oldestSeq());
+    TEST_ASSERT_EQUAL_UINT32(30, log.size());
+
+    log.popUntil(15);
+    TEST_ASSERT_TRUE(log.commit());
+    log.end();
+    corrupt("/log/cursor.bin", 8, 8);
+    log.begin(LittleFS, "/log", 2, 64);
+    TEST_ASSERT_EQUAL_UINT32(10, log.oldestSeq());
+    log.end();
+}
+
+// En fuld ring genbruger det ældste segment, og de overskrevne poster tælles som tabt
+void test_rotates_segments_at_capacity() {
+    OfflineLog log;
+    log.begin(LittleFS, "/log", 2, 4);
+    TEST_ASSERT_EQUAL_UINT32(8, log.capacity());
+    appendNumbers(log, 0, 10);
+
+    TEST_ASSERT_EQUAL_UINT32(4, log.oldestSeq());
+    TEST_ASSERT_EQUAL_UINT32(6, log.size());
+    TEST_ASSERT_EQUAL_UINT32(4, log.dropped());
+    TEST_ASSERT_EQUAL_STRING("", readSeq(log, 3).c_str());
+    TEST_ASSERT_EQUAL_STRING("4", readSeq(log, 4).c_str());
+    TEST_ASSERT_EQUAL_STRING("9", readSeq(log, 9).c_str());
+    TEST_ASSERT_FALSE(LittleFS.exists("/log/seg2.bin"));
+    log.end();
+
+    log.begin(LittleFS, "/log", 2, 4);
+    TEST_ASSERT_EQUAL_UINT32(4, log.oldestSeq());
+    TEST_ASSERT_EQUAL_UINT32(10, log.nextSeq());
+    TEST_ASSERT_EQUAL_STRING("8", readSeq(log, 8).c_str());
+    log.end();
+}
+
+// popUntil fjerner kun poster før den kvitterede grænse, og aldrig mere end der er
+void test_pop_until_removes_only_acked() {
+    OfflineLog log;
+    log.begin(LittleFS, "/log", 2, 16);
+    appendNumbers(log, 0, 5);
+
+    log.popUntil(3);
+    TEST_ASSERT_EQUAL_UINT32(3, log.oldestSeq());
+    TEST_ASSERT_EQUAL_UINT32(2, log.size());
+    TEST_ASSERT_EQUAL_STRING("", readSeq(log, 2).c_str());
+    TEST_ASSERT_EQUAL_STRING("3", readSeq(log, 3).c_str());
+
+    log.popUntil(1); // Kvittering for noget der allerede er fjernet
+    TEST_ASSERT_EQUAL_UINT32(3, log.oldestSeq());
+
+    log.popUntil(100);
+    TEST_ASSERT_EQUAL_UINT32(0, log.size());
+    TEST_ASSERT_EQUAL_UINT32(5, log.oldestSeq());
+
+    TEST_ASSERT_TRUE(log.append("5"));
+    TEST_ASSERT_EQUAL_STRING("5", readSeq(log, 5).c_str());
+    log.end();
+
+    log.begin(LittleFS, "/log", 2, 16);
+    TEST_ASSERT_EQUAL_UINT32(5, log.oldestSeq());
+    TEST_ASSERT_EQUAL_UINT32(1, log.size());
+    log.end();
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_recovers_torn_record);
+    RUN_TEST(test_cursor_falls_back_to_other_slot);
+    RUN_TEST(test_rotates_segments_at_capacity);
+    RUN_TEST(test_pop_until_removes_only_acked);
+    return UNITY_END();
+}
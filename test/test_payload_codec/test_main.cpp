@@ -0,0 +1,117 @@
+// Enhedstest af payload-kodningen på host: `pio test -e native -f test_payload_codec`
+//
+// Bytes og tekst nedenfor står også i subscriber_py/test_payload_codec.py, som afkoder
+// dem med modtagerens kode. Ændres formatet, skal begge filer følge med.
+#include <unity.h>
+
+#include "payload_codec.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+namespace {
+
+const PlateReading fraction = {"A000AA78", "2024-12-12T10:00:00.000000", 0, 2};
+const PlateReading seconds = {"XY12345", "2024-12-12T10:00:05", 0, 0};
+const PlateReading textTime = {"AB1", "12/12/2024 10:00", 0, 1};
+
+const uint8_t fractionV2[] = {0xA2, 0x02, 0x02, 0x00, 0x48, 0xFD, 0xC6, 0x0F, 0x29, 0x06,
+                              0x00, 0x08, 'A',  '0',  '0',  '0',  'A',  'A',  '7',  '8'};
+const uint8_t secondsV2[] = {0xA2, 0x00, 0x00, 0x40, 0x93, 0x49, 0xC7, 0x0F, 0x29, 0x06,
+                             0x00, 0x07, 'X',  'Y',  '1',  '2',  '3',  '4',  '5'};
+const uint8_t textTimeV2[] = {0xA2, 0x01, 0x01, 0x10, '1', '2', '/', '1', '2', '/', '2', '0',
+                              '2',  '4',  ' ',  '1',  '0', ':', '0', '0', 0x03, 'A', 'B', '1'};
+// Version 1 fra ældre enheder og offline-logs: uden banebyte
+const uint8_t fractionV1[] = {0xA1, 0x02, 0x00, 0x48, 0xFD, 0xC6, 0x0F, 0x29, 0x06, 0x00,
+                              0x08, 'A',  '0',  '0',  '0',  'A',  'A',  '7',  '8'};
+const char jsonArray[] = "[{\"plate\":\"A000AA78\",\"timestamp\":\"2024-12-12T10:00:00.000000\",\"lane\":2},"
+                         "{\"plate\":\"XY12345\",\"timestamp\":\"2024-12-12T10:00:05\",\"lane\":0}]";
+
+void assertReading(const PlateReading &expected, const PlateReading &actual) {
+    TEST_ASSERT_EQUAL_STRING(expected.plate, actual.plate);
+    TEST_ASSERT_EQUAL_STRING(expected.timestamp, actual.timestamp);
+    TEST_ASSERT_EQUAL_UINT8(expected.lane, actual.lane);
+}
+
+void assertBinary(const PlateReading &reading, const uint8_t *expected, size_t length) {
+    uint8_t buffer[64];
+    TEST_ASSERT_EQUAL_size_t(length, encodeBinary(reading, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buffer, length);
+    PlateReading decoded = {};
+    TEST_ASSERT_TRUE(decodeBinary(buffer, length, decoded));
+    assertReading(reading, decoded);
+}
+
+}  // namespace
+
+void test_binary_v2_matches_fixture() {
+    assertBinary(fraction, fractionV2, sizeof(fractionV2));
+    assertBinary(seconds, secondsV2, sizeof(secondsV2));
+    assertBinary(textTime, textTimeV2, sizeof(textTimeV2));
+
+    uint8_t buffer[64];
+    TEST_ASSERT_EQUAL_size_t(0, encodeBinary(fraction, buffer, sizeof(fractionV2) - 1));
+}
+
+void test_binary_batch_matches_fixture() {
+    uint8_t buffer[128];
+    PayloadBatch batch(buffer, sizeof(buffer), 8);
+    TEST_ASSERT_TRUE(batch.add(fractionV2, sizeof(fractionV2)));
+    TEST_ASSERT_TRUE(batch.add(secondsV2, sizeof(secondsV2)));
+    TEST_ASSERT_FALSE(batch.add(reinterpret_cast<const uint8_t *>("{}"), 2)); // Blandes ikke med JSON
+    TEST_ASSERT_EQUAL_size_t(3 + sizeof(fractionV2) + 1 + sizeof(secondsV2), batch.finish());
+    TEST_ASSERT_EQUAL_HEX8(0xB1, buffer[0]);
+    TEST_ASSERT_EQUAL_UINT8(2, buffer[1]);
+    TEST_ASSERT_EQUAL_UINT8(sizeof(fractionV2), buffer[2]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(fractionV2, buffer + 3, sizeof(fractionV2));
+    TEST_ASSERT_EQUAL_UINT8(sizeof(secondsV2), buffer[3 + sizeof(fractionV2)]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(secondsV2, buffer + 4 + sizeof(fractionV2), sizeof(secondsV2));
+
+    // Én besked sendes uden ramme, så modtagere uden batch-understøttelse kan læse den
+    batch.clear();
+    TEST_ASSERT_TRUE(batch.add(fractionV2, sizeof(fractionV2)));
+    TEST_ASSERT_EQUAL_size_t(sizeof(fractionV2), batch.finish());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(fractionV2, buffer, sizeof(fractionV2));
+}
+
+void test_json_array_matches_fixture() {
+    char first[128];
+    char second[128];
+    size_t firstLength = encodeJson(fraction, first, sizeof(first));
+    size_t secondLength = encodeJson(seconds, second, sizeof(second));
+    TEST_ASSERT_EQUAL_STRING("{\"plate\":\"A000AA78\",\"timestamp\":\"2024-12-12T10:00:00.000000\",\"lane\":2}", first);
+
+    uint8_t buffer[256];
+    PayloadBatch batch(buffer, sizeof(buffer), 8);
+    TEST_ASSERT_TRUE(batch.add(reinterpret_cast<uint8_t *>(first), firstLength));
+    TEST_ASSERT_TRUE(batch.add(reinterpret_cast<uint8_t *>(second), secondLength));
+    TEST_ASSERT_FALSE(batch.add(fractionV2, sizeof(fractionV2))); // Blandes ikke med binære
+    size_t length = batch.finish();
+    TEST_ASSERT_EQUAL_size_t(sizeof(jsonArray) - 1, length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(jsonArray, buffer, length);
+}
+
+void test_decodes_binary_v1_without_lane() {
+    PlateReading decoded = {};
+    decoded.lane = 7;
+    TEST_ASSERT_TRUE(decodeBinary(fractionV1, sizeof(fractionV1), decoded));
+    TEST_ASSERT_EQUAL_STRING("A000AA78", decoded.plate);
+    TEST_ASSERT_EQUAL_STRING("2024-12-12T10:00:00.000000", decoded.timestamp);
+    TEST_ASSERT_EQUAL_UINT8(0, decoded.lane);
+
+    uint8_t unknown[sizeof(fractionV2)];
+    memcpy(unknown, fractionV2, sizeof(unknown));
+    unknown[0] = 0xA3;
+    TEST_ASSERT_FALSE(decodeBinary(unknown, sizeof(unknown), decoded));
+    TEST_ASSERT_FALSE(decodeBinary(fractionV2, sizeof(fractionV2) - 1, decoded));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_binary_v2_matches_fixture);
+    RUN_TEST(test_binary_batch_matches_fixture);
+    RUN_TEST(test_json_array_matches_fixture);
+    RUN_TEST(test_decodes_binary_v1_without_lane);
+    return UNITY_END();
+}
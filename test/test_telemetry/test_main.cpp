@@ -0,0 +1,86 @@
+// Enhedstest af telemetribeskeden på host: `pio test -e native -f test_telemetry`
+//
+// Beskeden vokser med antallet af brugte spande, så den største mulige skal stadig kunne
+// være i Telemetry::JSON_MAX bytes, som main.cpp sender fra.
+#include <unity.h>
+
+#include <string.h>
+
+#include "telemetry.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+namespace {
+
+const char longId[] = "device-with-an-id-longer-than-thirty-two-characters";
+
+// Alle tællere ved deres maksimum og en periode så lang som uint32 kan vise
+void fillCounters(Telemetry &telemetry) {
+    memset(&telemetry, 0xFF, sizeof(telemetry));
+    telemetry.periodStartUs = 1;
+}
+
+size_t encodeFull(const Telemetry &telemetry, char *buffer, size_t size) {
+    return telemetry.encodeJson(longId, 1 + (int64_t)UINT32_MAX * 1000000LL, UINT32_MAX, buffer, size);
+}
+
+}  // namespace
+
+// Hver spand i hvert trin er brugt: flest tal i listerne
+void test_every_bucket_fits_json_max() {
+    Telemetry telemetry;
+    fillCounters(telemetry);
+    char buffer[Telemetry::JSON_MAX];
+    size_t length = encodeFull(telemetry, buffer, sizeof(buffer));
+    TEST_ASSERT_GREATER_THAN(0, length);
+    TEST_ASSERT_LESS_THAN(Telemetry::JSON_MAX, length);
+    TEST_ASSERT_EQUAL_CHAR('}', buffer[length - 1]);
+    for (uint8_t s = 0; s < STAGE_COUNT; s++) {
+        TEST_ASSERT_NOT_NULL(strstr(buffer, Telemetry::stageName((TelemetryStage)s)));
+    }
+}
+
+// Alt i den øverste spand: percentilerne får flest cifre
+void test_largest_percentiles_fit_json_max() {
+    Telemetry telemetry;
+    fillCounters(telemetry);
+    for (uint8_t s = 0; s < STAGE_COUNT; s++) {
+        memset(telemetry.stages[s].buckets, 0, sizeof(telemetry.stages[s].buckets));
+        telemetry.stages[s].buckets[0] = 1;
+        telemetry.stages[s].buckets[LatencyHistogram::BUCKETS - 1] = 0xFFFF;
+    }
+    char buffer[Telemetry::JSON_MAX];
+    size_t length = encodeFull(telemetry, buffer, sizeof(buffer));
+    TEST_ASSERT_GREATER_THAN(0, length);
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"p50\":16777215"));
+}
+
+// Et langt enheds-id afkortes, så det ikke kan skubbe beskeden over JSON_MAX
+void test_device_id_is_truncated() {
+    Telemetry telemetry;
+    telemetry.reset(1);
+    char buffer[Telemetry::JSON_MAX];
+    TEST_ASSERT_GREATER_THAN(0, telemetry.encodeJson(longId, 2, 0, buffer, sizeof(buffer)));
+    char expected[64];
+    snprintf(expected, sizeof(expected), "{\"device\":\"%.*s\",", (int)Telemetry::DEVICE_ID_MAX, longId);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(expected, buffer, strlen(expected)));
+}
+
+// En for lille buffer giver 0, ikke en afkortet besked
+void test_small_buffer_returns_zero() {
+    Telemetry telemetry;
+    fillCounters(telemetry);
+    char buffer[1024];
+    TEST_ASSERT_EQUAL_size_t(0, encodeFull(telemetry, buffer, sizeof(buffer)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_bucket_fits_json_max);
+    RUN_TEST(test_largest_percentiles_fit_json_max);
+    RUN_TEST(test_device_id_is_truncated);
+    RUN_TEST(test_small_buffer_returns_zero);
+    return UNITY_END();
+}